@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark measures how long a caller is blocked in Logger::out
+ * while messages are written to a file, in synchronous and asynchronous mode.
+ *
+ * usage : async_benchmark [messages per thread] [threads]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<uint64_t> run(int messages, int threads) {
+    std::vector<std::vector<uint64_t>> latencies(threads);
+    std::vector<std::thread> workers;
+
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            auto &samples = latencies[t];
+            samples.reserve(messages);
+
+            for(int i = 0; i < messages; ++i) {
+                auto begin = Clock::now();
+                util::Logger::getInstance().out(util::LogLevel::Info, "[%s:%d][%s] thread %d message %d payload %f",
+                                                "async_benchmark.cc", __LINE__, __func__, t, i, i * 0.5);
+                auto end = Clock::now();
+                samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+            }
+        });
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+
+    std::vector<uint64_t> all;
+    for(auto &samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    return all;
+}
+
+void report(const char *name, const std::vector<uint64_t> &samples, std::chrono::nanoseconds elapsed) {
+    auto percentile = [&](double p) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+    };
+
+    printf("%-6s p50 %8lu ns  p90 %8lu ns  p99 %8lu ns  p99.9 %8lu ns  max %10lu ns  total %8.2f ms\n",
+           name, percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), samples.back(),
+           elapsed.count() / 1e6);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int messages = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 4;
+
+    util::Logger::getInstance().registerLogger(std::make_shared<util::OutStrmLogger>("async_benchmark.log"));
+
+    printf("%d threads x %d messages, caller-side latency of Logger::out\n", threads, messages);
+
+    auto begin = Clock::now();
+    auto sync = run(messages, threads);
+    report("sync", sync, Clock::now() - begin);
+
+    util::Logger::getInstance().enableAsync(16384);
+
+    begin = Clock::now();
+    auto async = run(messages, threads);
+    util::Logger::getInstance().flush();
+    report("async", async, Clock::now() - begin);
+
+    util::Logger::getInstance().disableAsync();
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "logger.hpp"
+#include "fd_logger.hpp"
+#include "binary_logger.hpp"
+
+/**
+ * This benchmark compares a text log written by FdLogger with the binary log of
+ * BinaryLogger for the same LOG_* calls, by lines per second and file size,
+ * and measures how fast BinaryLogReader decodes the binary log.
+ *
+ * usage : binary_benchmark [lines] [decoding threads]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+size_t fileSize(const std::string &fileName) {
+    struct stat st;
+
+    return stat(fileName.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+template<typename Logger>
+void run(const char *name, const std::string &fileName, int lines) {
+    unlink(fileName.c_str());
+    util::Logger::destroyInstance();
+    util::Logger::getInstance().registerLogger(std::make_shared<Logger>(fileName));
+
+    auto begin = Clock::now();
+    for(int i = 0; i < lines; ++i) {
+        LOG_INFO("Packet capture length: %d, length: %d, source %s port %u", 60 + i % 1400, 1514, "192.168.0.1", 40000 + i % 1000);
+    }
+    util::Logger::getInstance().flush();
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    util::Logger::destroyInstance();
+    printf("%-8s %12.0f lines/s %12zu bytes %8.1f bytes/line\n", name, lines / elapsed, fileSize(fileName),
+           static_cast<double>(fileSize(fileName)) / lines);
+}
+
+void decode(const std::string &fileName, int lines, unsigned threads) {
+    std::FILE *out = std::fopen("/dev/null", "w");
+    util::BinaryLogReader reader(fileName);
+
+    auto begin = Clock::now();
+    reader.decode(out, threads);
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::fclose(out);
+    printf("decode   %12.0f lines/s with %u threads\n", lines / elapsed, threads);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int lines = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    unsigned threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+
+    run<util::FdLogger>("text", "binary_benchmark.log", lines);
+    run<util::BinaryLogger>("binary", "binary_benchmark.bin", lines);
+
+    decode("binary_benchmark.bin", lines, 1);
+    if(threads > 1) {
+        decode("binary_benchmark.bin", lines, threads);
+    }
+
+    unlink("binary_benchmark.log");
+    unlink("binary_benchmark.bin");
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "logger.hpp"
+#include "tsc_clock.hpp"
+
+/**
+ * This benchmark compares the cost of a timestamp from the system clocks and from TscClock,
+ * and the caller-side cost of a LOG_* call in asynchronous mode with either clock.
+ *
+ * usage : clock_benchmark [iterations]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NullLogger : public util::ILogger {
+public:
+    virtual void out(util::LogLevel level, const char* str) override {}
+};
+
+template<typename F>
+double measure(int iterations, F func) {
+    auto begin = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        func(i);
+    }
+    auto elapsed = Clock::now() - begin;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(iterations);
+}
+
+double measureAsync(int iterations, util::LogClock clock) {
+    util::Logger::getInstance().setClock(clock);
+    util::Logger::getInstance().enableAsync(iterations);
+
+    double cost = measure(iterations, [](int i) {
+        LOG_INFO("Packet capture length: %d", i);
+    });
+
+    util::Logger::getInstance().flush();
+    util::Logger::getInstance().disableAsync();
+    return cost;
+}
+
+volatile int64_t sink;
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    util::Logger::getInstance().registerLogger(std::make_shared<NullLogger>());
+    util::TscClock::now();
+
+    double systemCost = measure(iterations, [](int i) {
+        sink = std::chrono::system_clock::now().time_since_epoch().count();
+    });
+
+    double monotonicCost = measure(iterations, [](int i) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        sink = ts.tv_nsec;
+    });
+
+    double ticksCost = measure(iterations, [](int i) {
+        sink = util::TscClock::ticks();
+    });
+
+    double nowCost = measure(iterations, [](int i) {
+        sink = util::TscClock::now().time_since_epoch().count();
+    });
+
+    double asyncSystem = measureAsync(iterations, util::LogClock::System);
+    double asyncTsc = measureAsync(iterations, util::LogClock::Tsc);
+
+    printf("%d iterations, invariant TSC %s, %.3f ticks/ns\n", iterations,
+           util::TscClock::isInvariant() ? "yes" : "no", util::TscClock::ticksPerNanosecond());
+    printf("system_clock::now        : %8.1f ns\n", systemCost);
+    printf("clock_gettime(MONOTONIC) : %8.1f ns\n", monotonicCost);
+    printf("TscClock::ticks          : %8.1f ns\n", ticksCost);
+    printf("TscClock::now            : %8.1f ns\n", nowCost);
+    printf("async LOG_INFO, System   : %8.1f ns\n", asyncSystem);
+    printf("async LOG_INFO, Tsc      : %8.1f ns\n", asyncTsc);
+
+    return 0;
+}
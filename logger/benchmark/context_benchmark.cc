@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark measures what a LogContext adds to a LOG_INFO call in synchronous mode,
+ * next to formatting the same pairs in every call, and the cost of entering and leaving a context.
+ *
+ * usage : context_benchmark [messages]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+double measure(int iterations, F func) {
+    auto begin = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        func(i);
+    }
+    auto elapsed = Clock::now() - begin;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(iterations);
+}
+
+volatile size_t sink;
+
+class NullLogger : public util::ILogger {
+public:
+    virtual void out(util::LogLevel level, const char* str) override {}
+    virtual void out(util::LogLevel level, const char* str, size_t len) override {
+        sink = len;
+    }
+};
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::string iface = "enp0s31f6";
+    unsigned session = 42;
+
+    auto null = std::make_shared<NullLogger>();
+    util::Logger::getInstance().registerLogger(null);
+
+    auto plain = [&](int i) {
+        LOG_INFO("Packet capture length: %d len: %d", i % 1500, i % 1500);
+    };
+
+    //the first run warms up the caches
+    measure(iterations, plain);
+    double plainCost = measure(iterations, plain);
+
+    double formattedCost = measure(iterations, [&](int i) {
+        LOG_INFO("[iface=%s session=%u timer=%s] Packet capture length: %d len: %d", iface, session, "retry", i % 1500, i % 1500);
+    });
+
+    double contextCost;
+    {
+        util::LogContext context("iface", iface, "session", session, "timer", "retry");
+
+        contextCost = measure(iterations, plain);
+    }
+
+    double enterCost = measure(iterations, [&](int i) {
+        util::LogContext context("iface", iface, "session", i);
+        size_t len;
+        sink = reinterpret_cast<uintptr_t>(util::LogContext::current(len)) + len;
+    });
+
+    printf("LOG_INFO                  : %8.1f ns\n", plainCost);
+    printf("LOG_INFO formatting pairs : %8.1f ns\n", formattedCost);
+    printf("LOG_INFO in LogContext    : %8.1f ns\n", contextCost);
+    printf("enter and leave context   : %8.1f ns\n", enterCost);
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark measures the per-call cost on the caller's thread in asynchronous mode,
+ * when the message is formatted by the caller (Logger::out with a printf-style format)
+ * and when only the arguments are captured (LOG_* macros, formatted on the backend thread).
+ *
+ * usage : deferred_benchmark [messages]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NullLogger : public util::ILogger {
+public:
+    virtual void out(util::LogLevel level, const char* str) override {}
+};
+
+constexpr int BATCH = 16384;
+
+template<typename F>
+double measure(int messages, F log) {
+    Clock::duration elapsed {0};
+
+    //log in batches which fit in the ring, so that the caller is never blocked by a full ring
+    for(int done = 0; done < messages; done += BATCH) {
+        auto begin = Clock::now();
+        for(int i = 0; i < BATCH; ++i) {
+            log(done + i);
+        }
+        elapsed += Clock::now() - begin;
+
+        util::Logger::getInstance().flush();
+    }
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(messages);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int messages = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const char *ifName = "enp0s31f6";
+
+    util::Logger::getInstance().registerLogger(std::make_shared<NullLogger>());
+    util::Logger::getInstance().enableAsync(BATCH);
+
+    double eager = measure(messages, [&](int i) {
+        util::Logger::getInstance().out(util::LogLevel::Info, "[%s:%d][%s] Packet capture length: %d, ifName : %s, ratio %f",
+                                        "deferred_benchmark.cc", __LINE__, __func__, i, ifName, i * 0.5);
+    });
+
+    double deferred = measure(messages, [&](int i) {
+        LOG_INFO("Packet capture length: %d, ifName : %s, ratio %f", i, ifName, i * 0.5);
+    });
+
+    printf("%d messages, caller-side cost per message\n", messages);
+    printf("format on caller  : %8.1f ns\n", eager);
+    printf("deferred capture  : %8.1f ns\n", deferred);
+
+    util::Logger::getInstance().disableAsync();
+
+    return 0;
+}
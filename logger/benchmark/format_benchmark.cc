@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark compares vsnprintf with the compile-time checked formatter,
+ * on its own and through the synchronous Logger path with a logger doing nothing.
+ *
+ * usage : format_benchmark [iterations]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NullLogger : public util::ILogger {
+public:
+    virtual void out(util::LogLevel level, const char* str) override {}
+};
+
+template<typename F>
+double measure(int iterations, F func) {
+    auto begin = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        func(i);
+    }
+    auto elapsed = Clock::now() - begin;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(iterations);
+}
+
+volatile size_t sink;
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const char *ifName = "enp0s31f6";
+    char buf[1024];
+
+    util::Logger::getInstance().registerLogger(std::make_shared<NullLogger>());
+
+    static constexpr const char *format = "Packet capture length: %d, ifName : %s, ratio %.3f, flags %#x";
+    static constexpr util::CompiledFormat<util::countFormatOps(format), int, const char*, double, unsigned> compiled {format};
+
+    double printfCost = measure(iterations, [&](int i) {
+        sink = std::snprintf(buf, sizeof(buf), format, i, ifName, i * 0.5, static_cast<unsigned>(i));
+    });
+
+    double compiledCost = measure(iterations, [&](int i) {
+        sink = compiled.format(buf, sizeof(buf), i, ifName, i * 0.5, static_cast<unsigned>(i));
+    });
+
+    double printfLogger = measure(iterations, [&](int i) {
+        util::Logger::getInstance().out(util::LogLevel::Info, "[%s:%d][%s] Packet capture length: %d, ifName : %s, ratio %.3f, flags %#x",
+                                        "format_benchmark.cc", __LINE__, __func__, i, ifName, i * 0.5, static_cast<unsigned>(i));
+    });
+
+    double compiledLogger = measure(iterations, [&](int i) {
+        LOG_INFO("Packet capture length: %d, ifName : %s, ratio %.3f, flags %#x", i, ifName, i * 0.5, static_cast<unsigned>(i));
+    });
+
+    printf("%d iterations, cost per message\n", iterations);
+    printf("snprintf               : %8.1f ns\n", printfCost);
+    printf("CompiledFormat         : %8.1f ns\n", compiledCost);
+    printf("Logger::out (varargs)  : %8.1f ns\n", printfLogger);
+    printf("LOG_INFO (compiled)    : %8.1f ns\n", compiledLogger);
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark compares HexDump::write with a dump formatted by snprintf byte by byte,
+ * and measures LOG_HEXDUMP into a logger which drops the messages, from 64 bytes to a jumbo frame.
+ *
+ * usage : hexdump_benchmark [iterations]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+double measure(int iterations, F func) {
+    auto begin = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        func(i);
+    }
+    auto elapsed = Clock::now() - begin;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(iterations);
+}
+
+volatile size_t sink;
+
+class NullLogger : public util::ILogger {
+public:
+    virtual void out(util::LogLevel level, const char* str) override {}
+    virtual void out(util::LogLevel level, const char* str, size_t len) override {
+        sink = len;
+    }
+};
+
+//the same lines as HexDump, a snprintf per byte
+size_t printfDump(const uint8_t *data, size_t len, char *buf, size_t size) {
+    int n = 0;
+
+    for(size_t offset = 0; offset < len; offset += 16) {
+        n += snprintf(buf + n, size - n, "%s%08zx ", offset > 0 ? "\n" : "", offset);
+        for(size_t i = 0; i < 16; ++i) {
+            n += offset + i < len ? snprintf(buf + n, size - n, "%s %02x", i == 8 ? " " : "", data[offset + i])
+                                  : snprintf(buf + n, size - n, "%s   ", i == 8 ? " " : "");
+        }
+        n += snprintf(buf + n, size - n, "  |");
+        for(size_t i = offset; i < len && i < offset + 16; ++i) {
+            n += snprintf(buf + n, size - n, "%c", data[i] >= 0x20 && data[i] < 0x7f ? data[i] : '.');
+        }
+        n += snprintf(buf + n, size - n, "|");
+    }
+
+    return n;
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+    std::vector<uint8_t> data(9000);
+    std::vector<char> buf(util::HexDump::length(data.size()) + 1);
+
+    for(size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 131 + (i >> 3));
+    }
+
+    auto null = std::make_shared<NullLogger>();
+    util::Logger::getInstance().registerLogger(null);
+
+    printf("%10s %12s %12s %12s %8s\n", "bytes", "snprintf", "HexDump", "LOG_HEXDUMP", "speedup");
+    for(size_t len : {64, 256, 1500, 9000}) {
+        int count = std::max<int>(iterations * 64 / len, 100);
+
+        double printfCost = measure(count, [&](int i) {
+            sink = printfDump(data.data(), len, buf.data(), buf.size());
+        });
+
+        double hexDumpCost = measure(count, [&](int i) {
+            sink = util::HexDump::write(data.data(), len, buf.data(), buf.size());
+        });
+
+        double macroCost = measure(count, [&](int i) {
+            LOG_HEXDUMP(Info, data.data(), len, len);
+        });
+
+        printf("%10zu %9.1f ns %9.1f ns %9.1f ns %7.1fx\n", len, printfCost, hexDumpCost, macroCost, printfCost / hexDumpCost);
+    }
+
+    return 0;
+}
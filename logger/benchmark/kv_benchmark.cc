@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "logger.hpp"
+#include "structured_logger.hpp"
+
+/**
+ * This benchmark measures how fast a LOG_*_KV record is encoded as JSON and logfmt
+ * by LogEncoder, next to its text form and a JSON line built with snprintf.
+ *
+ * usage : kv_benchmark [records]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+double measure(int iterations, F func) {
+    auto begin = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        func(i);
+    }
+    auto elapsed = Clock::now() - begin;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(iterations);
+}
+
+volatile size_t sink;
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    char buf[util::StructuredLogger::LINE_SIZE];
+
+    using Capture = util::LogCapture<unsigned, unsigned, const char*, double, int>;
+    static util::LogSite site {"kv_benchmark.cc", __LINE__, "main", util::LogLevel::Info, true, {util::LogSite::ENABLED}};
+    static const util::KvFormat<unsigned, unsigned, const char*, double, int> format("packet", "caplen", "len", "iface", "ratio", "vlan");
+
+    util::LogRecord record;
+    record.level = site.level;
+    record.sequence = 0;
+    record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    record.site = &site;
+    record.format = &format;
+    record.formatter = &Capture::format<util::KvFormat<unsigned, unsigned, const char*, double, int>>;
+    record.length = Capture::encode(record.payload, 1514u, 1514u, "enp0s31f6", 0.125, 100);
+
+    util::LogEncoder json(util::LogEncoding::Json);
+    util::LogEncoder logfmt(util::LogEncoding::Logfmt);
+    size_t bytes[4] = {};
+
+    double textCost = measure(iterations, [&](int i) {
+        sink = record.formatter(record, buf, sizeof(buf));
+    });
+    bytes[0] = sink;
+
+    double jsonCost = measure(iterations, [&](int i) {
+        ++record.timestamp;
+        sink = json.encode(record, buf, sizeof(buf));
+    });
+    bytes[1] = sink;
+
+    double logfmtCost = measure(iterations, [&](int i) {
+        ++record.timestamp;
+        sink = logfmt.encode(record, buf, sizeof(buf));
+    });
+    bytes[2] = sink;
+
+    double printfCost = measure(iterations, [&](int i) {
+        sink = std::snprintf(buf, sizeof(buf), "{\"ts\":%ld,\"level\":\"%s\",\"src\":\"%s:%d\",\"func\":\"%s\",\"event\":\"%s\","
+                             "\"caplen\":%u,\"len\":%u,\"iface\":\"%s\",\"ratio\":%g,\"vlan\":%d}",
+                             static_cast<long>(record.timestamp + i), "info", site.file, site.line, site.function, "packet",
+                             1514u, 1514u, "enp0s31f6", 0.125, 100);
+    });
+    bytes[3] = sink;
+
+    auto print = [&](const char *name, double cost, size_t size) {
+        printf("%-26s : %8.1f ns %8.1f MB/s %4zu bytes\n", name, cost, size * 1e3 / cost, size);
+    };
+
+    printf("%d records, cost per record\n", iterations);
+    print("text (KvFormat)", textCost, bytes[0]);
+    print("JSON (LogEncoder)", jsonCost, bytes[1]);
+    print("logfmt (LogEncoder)", logfmtCost, bytes[2]);
+    print("JSON (snprintf, unescaped)", printfCost, bytes[3]);
+
+    return 0;
+}
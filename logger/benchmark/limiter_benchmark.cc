@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark measures the cost of a suppressed call of the rate limited LOG_* macros,
+ * which is what a log storm costs once the limit is reached.
+ *
+ * usage : limiter_benchmark [calls]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NullLogger : public util::ILogger {
+public:
+    virtual void out(util::LogLevel level, const char* str) override {}
+};
+
+template<typename F>
+double measure(int calls, F log) {
+    auto begin = Clock::now();
+    for(int i = 0; i < calls; ++i) {
+        log(i);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count() / static_cast<double>(calls);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 10000000;
+
+    util::Logger::getInstance().registerLogger(std::make_shared<NullLogger>());
+
+    printf("%d calls, cost per call on the caller's thread\n", calls);
+
+    printf("%-18s : %8.1f ns\n", "LOG_EVERY_N", measure(calls, [](int i) {
+        LOG_EVERY_N(Warn, 1000000, "Packet queue is full, drop packet %d", i);
+    }));
+    printf("%-18s : %8.1f ns\n", "LOG_FIRST_N", measure(calls, [](int i) {
+        LOG_FIRST_N(Warn, 1, "Packet queue is full, drop packet %d", i);
+    }));
+    printf("%-18s : %8.1f ns\n", "LOG_EVERY_T", measure(calls, [](int i) {
+        LOG_EVERY_T(Warn, std::chrono::seconds(10), "Packet queue is full, drop packet %d", i);
+    }));
+    printf("%-18s : %8.1f ns\n", "LOG_RATE_LIMITED", measure(calls, [](int i) {
+        LOG_RATE_LIMITED(Warn, 1, 10, "Packet queue is full, drop packet %d", i);
+    }));
+
+    return 0;
+}
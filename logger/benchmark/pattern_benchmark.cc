@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark compares the cost of a line prefix with date, time, level and thread id
+ * laid out by LogPattern, with localtime_r and strftime for every line.
+ *
+ * usage : pattern_benchmark [lines]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+double measure(int iterations, F func) {
+    auto begin = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        func(i);
+    }
+    auto elapsed = Clock::now() - begin;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(iterations);
+}
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+volatile size_t sink;
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const char *message = "Packet capture length: 1514, ifName : enp0s31f6";
+    const size_t len = std::strlen(message);
+    char buf[1024];
+
+    util::LogPattern pattern("%D %T.%u [%l] [%t] %v");
+
+    double patternCost = measure(iterations, [&](int i) {
+        sink = pattern.format(util::LogLevel::Info, now(), message, len, buf, sizeof(buf));
+    });
+
+    double strftimeCost = measure(iterations, [&](int i) {
+        int64_t timestamp = now();
+        time_t second = static_cast<time_t>(timestamp / 1000000000);
+        struct tm tm;
+        char date[64];
+
+        localtime_r(&second, &tm);
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+        sink = std::snprintf(buf, sizeof(buf), "%s.%06ld [%s] [%ld] %s", date, static_cast<long>(timestamp % 1000000000 / 1000),
+                             "INFO", 1234L, message);
+    });
+
+    double clockCost = measure(iterations, [&](int i) {
+        sink = now();
+    });
+
+    printf("%d lines, cost per line\n", iterations);
+    printf("LogPattern             : %8.1f ns\n", patternCost);
+    printf("localtime_r + strftime : %8.1f ns\n", strftimeCost);
+    printf("system_clock::now only : %8.1f ns\n", clockCost);
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#include "recent_log.hpp"
+
+/**
+ * This benchmark compares findText with std::string::find and memmem on log-like text,
+ * and measures RecentLog::out and a substring query over a full ring.
+ *
+ * usage : recent_benchmark [iterations]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+double measure(int iterations, F func) {
+    auto begin = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        func(i);
+    }
+    auto elapsed = Clock::now() - begin;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(iterations);
+}
+
+volatile size_t sink;
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 10000;
+    std::string text;
+
+    //1MB of messages, the pattern is in the last one
+    for(int i = 0; text.size() < 1024 * 1024; ++i) {
+        text += "[INFO][pcap.cc:120][pcapHandler_] Packet capture length: " + std::to_string(i % 1500) + " len: " + std::to_string(i % 1500) + "\n";
+    }
+    text += "[WARN][pcap.cc:131][pcapHandler_] queue overflow on eth0\n";
+
+    const char *pattern = "queue overflow";
+    int scans = std::max(iterations / 100, 1);
+
+    //its first byte is rare in the text, and the first byte of the second one is common
+    for(const char *searched : {pattern, "len: 1500"}) {
+        size_t searchedLen = strlen(searched);
+
+        double findTextCost = measure(scans, [&](int i) {
+            const char *found = util::findText(text.data(), text.size(), searched, searchedLen);
+            sink = found ? found - text.data() : 0;
+        });
+
+        double stringFindCost = measure(scans, [&](int i) {
+            sink = text.find(searched);
+        });
+
+        double memmemCost = measure(scans, [&](int i) {
+            const char *found = static_cast<const char*>(memmem(text.data(), text.size(), searched, searchedLen));
+            sink = found ? found - text.data() : 0;
+        });
+
+        printf("%d scans of %.1f MB for \"%s\"\n", scans, text.size() / 1024.0 / 1024.0, searched);
+        printf("findText          : %10.1f us %8.2f GB/s\n", findTextCost / 1000, text.size() / findTextCost);
+        printf("std::string::find : %10.1f us %8.2f GB/s\n", stringFindCost / 1000, text.size() / stringFindCost);
+        printf("memmem            : %10.1f us %8.2f GB/s\n", memmemCost / 1000, text.size() / memmemCost);
+    }
+
+    util::RecentLog recent(4 * 1024 * 1024);
+    char message[128];
+
+    double outCost = measure(iterations * 100, [&](int i) {
+        int len = snprintf(message, sizeof(message), "[pcap.cc:120][pcapHandler_] Packet capture length: %d len: %d", i % 1500, i % 1500);
+        recent.out(util::LogLevel::Info, message, len);
+    });
+    recent.out(util::LogLevel::Warn, "[pcap.cc:131][pcapHandler_] queue overflow on eth0");
+
+    util::RecentLogQuery query;
+    query.text = pattern;
+
+    size_t found = 0;
+    double queryCost = measure(scans, [&](int i) {
+        found = recent.query(query).size();
+    });
+
+    printf("RecentLog::out    : %10.1f ns\n", outCost);
+    printf("RecentLog::query  : %10.1f us for a ring of %zu bytes, %zu found\n", queryCost / 1000, recent.capacity(), found);
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <glob.h>
+#include <unistd.h>
+
+#include "rotating_logger.hpp"
+
+/**
+ * This benchmark measures the caller-side latency of RotatingFileLogger::out,
+ * and compares the calls which rotated the file with all other calls.
+ *
+ * usage : rotation_benchmark [lines] [segment size in bytes]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+void removeFiles(const std::string &pattern) {
+    glob_t found;
+
+    if(glob(pattern.c_str(), 0, nullptr, &found) == 0) {
+        for(size_t i = 0; i < found.gl_pathc; ++i) {
+            unlink(found.gl_pathv[i]);
+        }
+    }
+    globfree(&found);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int lines = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    size_t segment = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 16 * 1024 * 1024;
+    std::string fileName = "rotation_benchmark.log";
+    std::string message(200, 'x');
+
+    std::vector<uint64_t> writes;
+    std::vector<uint64_t> rotations;
+    writes.reserve(lines);
+
+    util::RotationPolicy policy;
+    policy.maxBytes = segment;
+    policy.maxSegments = 4;
+    {
+        util::RotatingFileLogger logger(fileName, policy);
+
+        for(int i = 0; i < lines; ++i) {
+            size_t rotated = logger.rotations();
+
+            auto begin = Clock::now();
+            logger.out(util::LogLevel::Info, message.c_str());
+            uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+
+            (logger.rotations() != rotated ? rotations : writes).push_back(elapsed);
+        }
+        logger.wait();
+    }
+    removeFiles(fileName + "*");
+
+    std::sort(writes.begin(), writes.end());
+    std::sort(rotations.begin(), rotations.end());
+
+    printf("%d lines of %zu bytes, segments of %zu bytes, caller-side latency\n", lines, message.size(), segment);
+    printf("write    p50 %8lu ns  p99 %8lu ns  p99.9 %8lu ns  max %10lu ns\n",
+           percentile(writes, 0.5), percentile(writes, 0.99), percentile(writes, 0.999), writes.back());
+    if(!rotations.empty()) {
+        printf("rotate   p50 %8lu ns  max %10lu ns  (%zu rotations)\n",
+               percentile(rotations, 0.5), rotations.back(), rotations.size());
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark measures how the throughput of LOG_* calls in asynchronous mode
+ * grows with the number of logging threads, with one shared ring and with per-thread rings.
+ *
+ * usage : scaling_benchmark [messages per thread] [max threads]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NullLogger : public util::ILogger {
+public:
+    virtual void out(util::LogLevel level, const char* str) override {}
+};
+
+//messages per second of all callers together, until every caller returned
+double run(int messages, int threads) {
+    std::vector<std::thread> workers;
+
+    auto begin = Clock::now();
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([messages, t] {
+            for(int i = 0; i < messages; ++i) {
+                LOG_INFO("thread %d message %d payload %f", t, i, i * 0.5);
+            }
+        });
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    util::Logger::getInstance().flush();
+
+    return messages * threads / elapsed;
+}
+
+double measure(int messages, int threads, util::AsyncStaging staging) {
+    util::Logger::getInstance().enableAsync(16384, staging);
+    double rate = run(messages, threads);
+    util::Logger::getInstance().disableAsync();
+
+    return rate;
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int messages = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : std::max(2u, std::thread::hardware_concurrency());
+
+    util::Logger::getInstance().registerLogger(std::make_shared<NullLogger>());
+
+    printf("%d messages per thread, %u hardware threads, throughput of LOG_INFO callers\n",
+           messages, std::thread::hardware_concurrency());
+    printf("%8s %16s %16s\n", "threads", "shared msg/s", "per-thread msg/s");
+
+    for(int threads = 1; threads <= maxThreads; threads *= 2) {
+        double shared = measure(messages, threads, util::AsyncStaging::Shared);
+        double perThread = measure(messages, threads, util::AsyncStaging::PerThread);
+
+        printf("%8d %16.0f %16.0f\n", threads, shared, perThread);
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark measures the cost of Singleton::getInstance when many threads call it at once,
+ * which every LOG_* call does, against the previous implementation which locked a mutex per call.
+ *
+ * usage : singleton_benchmark [calls per thread] [threads]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+//previous implementation of util::Singleton
+template<typename T>
+class LockedSingleton {
+public:
+    static T& getInstance() noexcept {
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        if(s_instance == nullptr) {
+            s_instance = new T();
+        }
+        return *s_instance;
+    }
+
+private:
+    static std::mutex s_mutex;
+    static T* s_instance;
+};
+
+template<typename T> T* LockedSingleton<T>::s_instance = nullptr;
+template<typename T> std::mutex LockedSingleton<T>::s_mutex;
+
+struct Locked {
+    int value = 1;
+};
+
+//wall time of all threads divided by the calls of one thread
+template<typename F>
+double measure(int calls, int threads, F getInstance) {
+    std::vector<std::thread> workers;
+    std::vector<uint64_t> sums(threads);
+
+    auto begin = Clock::now();
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            uint64_t sum = 0;
+            for(int i = 0; i < calls; ++i) {
+                sum += reinterpret_cast<uintptr_t>(&getInstance());
+            }
+            sums[t] = sum;
+        });
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+
+    volatile uint64_t sink = 0;
+    for(auto sum : sums) {
+        sink = sink + sum;
+    }
+
+    return elapsed / static_cast<double>(calls);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 16;
+
+    printf("%d threads x %d calls, %u hardware threads, wall time per call per thread\n",
+           threads, calls, std::thread::hardware_concurrency());
+
+    double locked = measure(calls, threads, [] () -> Locked& { return LockedSingleton<Locked>::getInstance(); });
+    printf("%-10s %8.2f ns\n", "mutex", locked);
+
+    double fast = measure(calls, threads, [] () -> util::Logger& { return util::Logger::getInstance(); });
+    printf("%-10s %8.2f ns\n", "acquire", fast);
+
+    return 0;
+}
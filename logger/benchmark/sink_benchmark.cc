@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "logger.hpp"
+#include "fd_logger.hpp"
+#include "mmap_logger.hpp"
+#include "flight_recorder.hpp"
+#include "shm_logger.hpp"
+
+/**
+ * This benchmark measures how many lines per second a logger writes to a file,
+ * or to shared memory for FlightRecorder and ShmLogger, for several message sizes.
+ * ShmLogger is read by a ShmCollector thread meanwhile, the lines it drops are shown in parentheses.
+ *
+ * usage : sink_benchmark [lines]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double measure(util::ILogger &logger, int lines, size_t size) {
+    std::string message(size, 'x');
+
+    auto begin = Clock::now();
+    for(int i = 0; i < lines; ++i) {
+        logger.out(util::LogLevel::Info, message.c_str());
+    }
+    logger.flush();
+
+    return lines / std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+template<typename Logger>
+void run(const char *name, int lines, const std::vector<size_t> &sizes) {
+    printf("%-12s", name);
+    for(auto size : sizes) {
+        std::string fileName = std::string("sink_benchmark_") + name + ".log";
+        double rate;
+        {
+            Logger logger(fileName);
+            rate = measure(logger, lines, size);
+        }
+        unlink(fileName.c_str());
+        printf(" %12.0f", rate);
+    }
+    printf("\n");
+}
+
+void runShm(int lines, const std::vector<size_t> &sizes) {
+    printf("%-12s", "shm");
+    for(auto size : sizes) {
+        std::atomic<bool> running {true};
+        std::atomic<bool> scanned {false};
+        util::ShmCollector collector("sink_benchmark_shm");
+        double rate;
+        uint64_t dropped;
+        {
+            util::ShmLogger logger("sink_benchmark_shm");
+            std::thread reader([&] {
+                collector.scan();
+                scanned.store(true);
+                while(running.load(std::memory_order_relaxed)) {
+                    collector.poll([](const util::ShmRecord&) {}, true);
+                }
+            });
+
+            while(!scanned.load()) {
+                std::this_thread::yield();
+            }
+            rate = measure(logger, lines, size);
+            dropped = logger.dropped();
+            running.store(false);
+            reader.join();
+        }
+        collector.poll([](const util::ShmRecord&) {}, true);
+        printf(" %12.0f (%lu)", rate, dropped);
+    }
+    printf("\n");
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int lines = argc > 1 ? std::atoi(argv[1]) : 500000;
+    std::vector<size_t> sizes {64, 256, 1024};
+
+    printf("%d lines, lines per second by message size\n", lines);
+    printf("%-12s", "logger");
+    for(auto size : sizes) {
+        printf(" %10zu B", size);
+    }
+    printf("\n");
+
+    run<util::OutStrmLogger>("ostream", lines, sizes);
+    run<util::FdLogger>("fd", lines, sizes);
+    run<util::MmapLogger>("mmap", lines, sizes);
+    run<util::FlightRecorder>("flight", lines, sizes);
+    runShm(lines, sizes);
+
+    return 0;
+}
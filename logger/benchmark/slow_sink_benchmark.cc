@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "logger.hpp"
+
+/**
+ * This benchmark measures the caller-side latency of Logger::out with a fast logger
+ * and a deliberately slow one, e.g. a file on a busy disk, when the slow logger is
+ * written inline, on a worker of its own, and on a worker which only takes Warn+.
+ *
+ * usage : slow_sink_benchmark [messages] [delay of the slow logger in us]
+ */
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class CountingLogger : public util::ILogger {
+public:
+    explicit CountingLogger(std::chrono::microseconds delay = std::chrono::microseconds(0)) : delay_(delay), lines_(0) {}
+
+    virtual void out(util::LogLevel level, const char* str) override {
+        if(delay_.count() > 0) {
+            std::this_thread::sleep_for(delay_);
+        }
+        lines_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t lines() const noexcept {
+        return lines_.load(std::memory_order_relaxed);
+    }
+
+private:
+    const std::chrono::microseconds delay_;
+    std::atomic<size_t> lines_;
+};
+
+void run(const char *name, int messages, std::chrono::microseconds delay, const util::SinkOptions *options) {
+    auto fast = std::make_shared<CountingLogger>();
+    auto slow = std::make_shared<CountingLogger>(delay);
+    std::vector<uint64_t> samples;
+
+    util::Logger::getInstance().registerLogger(fast);
+    if(options) {
+        util::Logger::getInstance().registerLogger(slow, *options);
+    } else {
+        util::Logger::getInstance().registerLogger(slow);
+    }
+
+    samples.reserve(messages);
+    auto begin = Clock::now();
+    for(int i = 0; i < messages; ++i) {
+        //one message in a hundred is a warning
+        util::LogLevel level = i % 100 == 0 ? util::LogLevel::Warn : util::LogLevel::Info;
+        auto start = Clock::now();
+
+        util::Logger::getInstance().out(level, "message %d payload %f", i, i * 0.5);
+        samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+    auto callers = Clock::now() - begin;
+    util::Logger::getInstance().flush();
+    auto total = Clock::now() - begin;
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+    };
+    util::LogCounters counters = util::Logger::getInstance().counters();
+    uint64_t dropped = 0;
+    for(auto count : counters.dropped) {
+        dropped += count;
+    }
+
+    printf("%-16s p50 %8lu ns  p99 %10lu ns  callers %8.2f ms  drained %8.2f ms  fast %7zu  slow %7zu  dropped %7lu\n",
+           name, percentile(0.5), percentile(0.99),
+           std::chrono::duration<double, std::milli>(callers).count(),
+           std::chrono::duration<double, std::milli>(total).count(),
+           fast->lines(), slow->lines(), dropped);
+
+    //every run starts with a logger without loggers and counters
+    util::Logger::destroyInstance();
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    int messages = argc > 1 ? std::atoi(argv[1]) : 20000;
+    std::chrono::microseconds delay(argc > 2 ? std::atoi(argv[2]) : 20);
+    util::SinkOptions worker;
+    util::SinkOptions dropping;
+    util::SinkOptions filtered;
+
+    worker.worker = true;
+    worker.capacity = 1024;
+    dropping = worker;
+    dropping.backpressure = util::Backpressure::DropNewest;
+    filtered = worker;
+    filtered.level = util::LogLevel::Warn;
+
+    printf("%d messages, slow logger takes %ld us per message\n", messages, static_cast<long>(delay.count()));
+
+    run("inline", messages, delay, nullptr);
+    run("worker", messages, delay, &worker);
+    run("worker drop", messages, delay, &dropping);
+    run("worker warn+", messages, delay, &filtered);
+
+    return 0;
+}
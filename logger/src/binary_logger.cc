@@ -0,0 +1,778 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "binary_logger.hpp"
+
+namespace util {
+
+namespace {
+void writeAll(int fd, const char *data, size_t len) noexcept {
+    while(len > 0) {
+        ssize_t written = write(fd, data, len);
+
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+//bytes of a packed integer of `size` bytes at most, a varint carries 7 bits per byte
+constexpr size_t packedSize(size_t size) noexcept {
+    return (size * 8 + 6) / 7;
+}
+
+//a packed argument takes at most twice its captured bytes: a 1 byte integer becomes a 2 byte varint,
+//a string swaps its 2 byte length and its null for a varint length of 3 bytes at most
+constexpr size_t PACKED_GROWTH = 2;
+
+static_assert(packedSize(1) <= PACKED_GROWTH * 1 && packedSize(2) <= PACKED_GROWTH * 2 &&
+              packedSize(4) <= PACKED_GROWTH * 4 && packedSize(8) <= PACKED_GROWTH * 8,
+              "packed arguments don't fit in PACKED_GROWTH times the payload");
+
+int64_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t readSigned(const char *src, size_t size) noexcept {
+    switch(size) {
+        case 1: { int8_t value; std::memcpy(&value, src, 1); return value; }
+        case 2: { int16_t value; std::memcpy(&value, src, 2); return value; }
+        case 4: { int32_t value; std::memcpy(&value, src, 4); return value; }
+        default: { int64_t value; std::memcpy(&value, src, 8); return value; }
+    }
+}
+
+uint64_t readUnsigned(const char *src, size_t size) noexcept {
+    switch(size) {
+        case 1: { uint8_t value; std::memcpy(&value, src, 1); return value; }
+        case 2: { uint16_t value; std::memcpy(&value, src, 2); return value; }
+        case 4: { uint32_t value; std::memcpy(&value, src, 4); return value; }
+        default: { uint64_t value; std::memcpy(&value, src, 8); return value; }
+    }
+}
+
+char* putString(char *dst, const char *str) noexcept {
+    size_t len = strnlen(str, BinaryLog::MAX_STRING);
+
+    dst = BinaryLog::putVarint(dst, len);
+    std::memcpy(dst, str, len);
+    return dst + len;
+}
+
+/**
+ * Format which prints a LOG_*_KV record like its text form, "event key=%d key=%s"
+ */
+void kvFormat(const FormatString &format, char *buf, size_t size) noexcept {
+    FormatWriter out(buf, size);
+    auto appendEscaped = [&](const char *str) {
+        for(const char *c = str; *c; ++c) {
+            out.append(*c, *c == '%' ? 2 : 1);
+        }
+    };
+
+    appendEscaped(format.str());
+    for(size_t i = 0; i < format.arguments(); ++i) {
+        char conversion[] = {'%', 'd'};
+
+        switch(format.types()[i].kind) {
+            case 'u': conversion[1] = 'u'; break;
+            case 'f': conversion[1] = 'g'; break;
+            case 'p': conversion[1] = 'p'; break;
+            case 's': conversion[1] = 's'; break;
+        }
+        out.append(' ');
+        appendEscaped(format.keys()[i]);
+        out.append('=');
+        out.append(conversion, sizeof(conversion));
+    }
+    out.finish();
+}
+
+bool getBytes(const char *&src, const char *end, const char *&bytes, size_t &len) noexcept {
+    uint64_t value;
+
+    if(!BinaryLog::getVarint(src, end, value) || value > static_cast<uint64_t>(end - src)) {
+        return false;
+    }
+    bytes = src;
+    len = value;
+    src += value;
+    return true;
+}
+
+/**
+ * Write an argument packed by BinaryLogger the way writeArg() writes the original value
+ */
+bool writePacked(FormatWriter &out, const FormatSpec &spec, const ArgType &type, const char *&src, const char *end) noexcept {
+    uint64_t value;
+    const char *bytes;
+    size_t len;
+
+    switch(type.kind) {
+        case 's':
+            if(!getBytes(src, end, bytes, len)) {
+                return false;
+            }
+            writeString(out, spec, bytes, len);
+            return true;
+        case 'i':
+            if(!BinaryLog::getVarint(src, end, value)) {
+                return false;
+            }
+            switch(type.size) {
+                case 1: writeInteger(out, spec, static_cast<int8_t>(BinaryLog::unzigzag(value))); break;
+                case 2: writeInteger(out, spec, static_cast<int16_t>(BinaryLog::unzigzag(value))); break;
+                case 4: writeInteger(out, spec, static_cast<int32_t>(BinaryLog::unzigzag(value))); break;
+                default: writeInteger(out, spec, BinaryLog::unzigzag(value)); break;
+            }
+            return true;
+        case 'u':
+            if(!BinaryLog::getVarint(src, end, value)) {
+                return false;
+            }
+            switch(type.size) {
+                case 1: writeInteger(out, spec, static_cast<uint8_t>(value)); break;
+                case 2: writeInteger(out, spec, static_cast<uint16_t>(value)); break;
+                case 4: writeInteger(out, spec, static_cast<uint32_t>(value)); break;
+                default: writeInteger(out, spec, value); break;
+            }
+            return true;
+        default:
+            break;
+    }
+
+    if(static_cast<size_t>(end - src) < type.size) {
+        return false;
+    }
+
+    if(type.kind == 'f' && type.size == sizeof(float)) {
+        float number;
+        std::memcpy(&number, src, sizeof(number));
+        writeFloat(out, spec, static_cast<double>(number));
+    } else if(type.kind == 'f' && type.size == sizeof(double)) {
+        double number;
+        std::memcpy(&number, src, sizeof(number));
+        writeFloat(out, spec, number);
+    } else if(type.kind == 'f' && type.size == sizeof(long double)) {
+        long double number;
+        std::memcpy(&number, src, sizeof(number));
+        writeFloat(out, spec, number);
+    } else if(type.kind == 'p' && type.size == sizeof(void*)) {
+        const void *ptr;
+        std::memcpy(&ptr, src, sizeof(ptr));
+        writePointer(out, spec, ptr);
+    } else {
+        return false;
+    }
+
+    src += type.size;
+    return true;
+}
+
+/**
+ * Run f(begin, end, index) on `threads` threads over consecutive parts of [0, count)
+ */
+template<typename F>
+void parallelFor(unsigned threads, size_t count, F &&f) {
+    std::vector<std::thread> workers;
+    size_t part = (count + threads - 1) / threads;
+
+    for(unsigned t = 1; t < threads && t * part < count; ++t) {
+        workers.emplace_back([&f, t, part, count] { f(t * part, std::min(count, (t + 1) * part), t); });
+    }
+    f(0, std::min(count, part), 0);
+
+    for(auto &worker : workers) {
+        worker.join();
+    }
+}
+}
+
+BinaryLogger::BinaryLogger(const std::string &fileName, const FlushPolicy &policy) : fd_(-1),
+                                                                                      policy_(policy),
+                                                                                      buffer_(new char[sizeof(BinaryLog::BlockHeader) + policy.bytes + MAX_ENTRIES]),
+                                                                                      used_(sizeof(BinaryLog::BlockHeader)),
+                                                                                      timestamp_(0),
+                                                                                      bytes_(0),
+                                                                                      flushed_(Clock::now()) {
+    fd_ = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd_ < 0) {
+        std::cerr << "Fail to open " << fileName << " : " << strerror(errno) << std::endl;
+        return;
+    }
+
+    //site ids of a previous run don't apply to this one
+    struct {
+        BinaryLog::BlockHeader header;
+        uint32_t version;
+    } session {{BinaryLog::SESSION, sizeof(uint32_t)}, BinaryLog::VERSION};
+
+    writeAll(fd_, reinterpret_cast<const char*>(&session), sizeof(session));
+}
+
+BinaryLogger::~BinaryLogger() {
+    if(fd_ < 0) {
+        return;
+    }
+
+    flush();
+    close(fd_);
+}
+
+void BinaryLogger::out(LogLevel level, const char* str) {
+    out(level, str, strnlen(str, LogRecord::PAYLOAD_SIZE));
+}
+
+void BinaryLogger::out(LogLevel level, const char* str, size_t len) {
+    if(fd_ < 0) {
+        return;
+    }
+
+    //an entry holds the payload of a record at most
+    putText_(level, now(), str, std::min(len, LogRecord::PAYLOAD_SIZE));
+}
+
+void BinaryLogger::out(const LogRecord &record) {
+    if(fd_ < 0) {
+        return;
+    }
+
+    if(!record.formatter) {
+        putText_(record.level, record.timestamp, record.payload, record.length);
+        return;
+    }
+
+    //integers are packed as varints, strings lose their null
+    const FormatString &format = *record.format;
+    const char *src = record.payload;
+    char args[LogRecord::PAYLOAD_SIZE * PACKED_GROWTH];
+    char *end = args;
+
+    for(size_t i = 0; i < format.arguments(); ++i) {
+        const ArgType &type = format.types()[i];
+        uint16_t len;
+
+        switch(type.kind) {
+            case 's':
+                std::memcpy(&len, src, sizeof(len));
+                end = BinaryLog::putVarint(end, len);
+                std::memcpy(end, src + sizeof(len), len);
+                end += len;
+                src += sizeof(len) + len + 1;
+                break;
+            case 'i':
+                end = BinaryLog::putVarint(end, BinaryLog::zigzag(readSigned(src, type.size)));
+                src += type.size;
+                break;
+            case 'u':
+                end = BinaryLog::putVarint(end, readUnsigned(src, type.size));
+                src += type.size;
+                break;
+            default:
+                std::memcpy(end, src, type.size);
+                end += type.size;
+                src += type.size;
+                break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    char *dst = buffer_.get() + used_;
+    uint64_t id;
+
+    dst = putSite_(dst, record, id);
+    *dst++ = BinaryLog::RECORD;
+    dst = BinaryLog::putVarint(dst, id);
+    dst = putTimestamp_(dst, record.timestamp);
+    dst = BinaryLog::putVarint(dst, end - args);
+    std::memcpy(dst, args, end - args);
+    dst += end - args;
+
+    commit_(dst, record.level);
+}
+
+void BinaryLogger::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if(fd_ >= 0) {
+        write_();
+    }
+}
+
+void BinaryLogger::putText_(LogLevel level, int64_t timestamp, const char *str, size_t len) noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    char *dst = buffer_.get() + used_;
+
+    *dst++ = BinaryLog::TEXT;
+    *dst++ = static_cast<char>(level);
+    dst = putTimestamp_(dst, timestamp);
+    dst = BinaryLog::putVarint(dst, len);
+    std::memcpy(dst, str, len);
+    dst += len;
+
+    commit_(dst, level);
+}
+
+char* BinaryLogger::putSite_(char *dst, const LogRecord &record, uint64_t &id) noexcept {
+    SiteKey key {record.site, record.format};
+    auto found = sites_.find(key);
+
+    if(found != sites_.end()) {
+        id = found->second;
+        return dst;
+    }
+
+    const LogSite &site = *record.site;
+    const FormatString &format = *record.format;
+
+    id = sites_.size() + 1;
+    sites_.emplace(key, id);
+
+    *dst++ = BinaryLog::SITE;
+    dst = BinaryLog::putVarint(dst, id);
+    *dst++ = static_cast<char>(site.level);
+    *dst++ = site.prefix;
+    dst = BinaryLog::putVarint(dst, site.line);
+    *dst++ = static_cast<char>(format.arguments());
+    for(size_t i = 0; i < format.arguments(); ++i) {
+        *dst++ = format.types()[i].kind;
+        *dst++ = static_cast<char>(format.types()[i].size);
+    }
+    dst = putString(dst, site.file);
+    dst = putString(dst, site.function);
+
+    if(format.keys()) {
+        char str[BinaryLog::MAX_STRING + 1];
+
+        kvFormat(format, str, sizeof(str));
+        return putString(dst, str);
+    }
+    return putString(dst, format.str());
+}
+
+char* BinaryLogger::putTimestamp_(char *dst, int64_t timestamp) noexcept {
+    dst = BinaryLog::putVarint(dst, BinaryLog::zigzag(timestamp - timestamp_));
+    timestamp_ = timestamp;
+    return dst;
+}
+
+void BinaryLogger::commit_(char *end, LogLevel level) noexcept {
+    size_t len = end - (buffer_.get() + used_);
+
+    used_ += len;
+    bytes_.fetch_add(len, std::memory_order_relaxed);
+
+    auto now = Clock::now();
+    if(used_ - sizeof(BinaryLog::BlockHeader) >= policy_.bytes || level >= policy_.level || now - flushed_ >= policy_.interval) {
+        write_();
+    }
+}
+
+void BinaryLogger::write_() noexcept {
+    if(used_ == sizeof(BinaryLog::BlockHeader)) {
+        return;
+    }
+
+    BinaryLog::BlockHeader header {BinaryLog::DATA, static_cast<uint32_t>(used_ - sizeof(BinaryLog::BlockHeader))};
+
+    std::memcpy(buffer_.get(), &header, sizeof(header));
+    writeAll(fd_, buffer_.get(), used_);
+    if(policy_.sync) {
+        fdatasync(fd_);
+    }
+
+    used_ = sizeof(BinaryLog::BlockHeader);
+    timestamp_ = 0;
+    flushed_ = Clock::now();
+}
+
+/**
+ * Call site as read from a SITE entry, with its format parsed for formatting
+ */
+struct BinaryLogReader::Site {
+    std::string file;
+    std::string function;
+    std::string format;
+    std::vector<ArgType> types;
+    std::vector<FormatOp> ops;
+    LogSite site;
+
+    /**
+     * @brief Read a SITE entry after its type
+     * @return return nullptr if the entry is broken
+     */
+    static std::unique_ptr<Site> read(const char *&src, const char *end, uint64_t &id) {
+        std::unique_ptr<Site> entry(new Site);
+        uint64_t line;
+        const char *bytes;
+        size_t len;
+
+        if(!BinaryLog::getVarint(src, end, id) || end - src < 2) {
+            return nullptr;
+        }
+
+        uint8_t level = *src++;
+        bool prefix = *src++;
+
+        if(level > static_cast<uint8_t>(LogLevel::Fatal) || !BinaryLog::getVarint(src, end, line) || src == end) {
+            return nullptr;
+        }
+
+        size_t count = static_cast<uint8_t>(*src++);
+
+        if(static_cast<size_t>(end - src) < 2 * count) {
+            return nullptr;
+        }
+        for(size_t i = 0; i < count; ++i, src += 2) {
+            entry->types.push_back({src[0], static_cast<uint8_t>(src[1])});
+        }
+
+        if(!getBytes(src, end, bytes, len)) {
+            return nullptr;
+        }
+        entry->file.assign(bytes, len);
+        if(!getBytes(src, end, bytes, len)) {
+            return nullptr;
+        }
+        entry->function.assign(bytes, len);
+        if(!getBytes(src, end, bytes, len)) {
+            return nullptr;
+        }
+        entry->format.assign(bytes, len);
+
+        struct Collector {
+            std::vector<FormatOp> &ops;
+
+            void literal(const char *str, size_t len) {
+                FormatOp op;
+                op.literal = str;
+                op.length = len;
+                ops.push_back(op);
+            }
+
+            void argument(const FormatSpec &spec) {
+                FormatOp op;
+                op.spec = spec;
+                ops.push_back(op);
+            }
+        } collector {entry->ops};
+
+        parseFormat(entry->format.c_str(), collector);
+
+        entry->site.file = entry->file.c_str();
+        entry->site.line = static_cast<int>(line);
+        entry->site.function = entry->function.c_str();
+        entry->site.level = static_cast<LogLevel>(level);
+        entry->site.prefix = prefix;
+
+        return entry;
+    }
+};
+
+BinaryLogReader::BinaryLogReader(const std::string &fileName) : fd_(-1), map_(nullptr), size_(0) {
+    struct stat st;
+
+    fd_ = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd_ < 0 || fstat(fd_, &st) != 0) {
+        std::cerr << "Fail to open " << fileName << " : " << strerror(errno) << std::endl;
+        if(fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        return;
+    }
+
+    size_ = st.st_size;
+    if(size_ == 0) {
+        return;
+    }
+
+    void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+
+    if(map == MAP_FAILED) {
+        std::cerr << "Fail to map " << fileName << " : " << strerror(errno) << std::endl;
+        close(fd_);
+        fd_ = -1;
+        size_ = 0;
+        return;
+    }
+    madvise(map, size_, MADV_SEQUENTIAL);
+    map_ = static_cast<const char*>(map);
+}
+
+BinaryLogReader::~BinaryLogReader() {
+    if(map_) {
+        munmap(const_cast<char*>(map_), size_);
+    }
+    if(fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool BinaryLogReader::decode(std::FILE *out, unsigned threads, bool timestamps) {
+    if(fd_ < 0) {
+        return false;
+    }
+
+    std::vector<Block> blocks;
+    bool complete = scan_(blocks);
+
+    threads = std::max(1u, threads);
+
+    //the sites of a session may be defined in any block of it, collect them all first
+    std::vector<Sites> found(threads);
+    std::vector<char> broken(threads, false);
+    Sites sites;
+
+    parallelFor(threads, blocks.size(), [&](size_t begin, size_t end, unsigned index) {
+        broken[index] = !readSites_(blocks.data() + begin, blocks.data() + end, found[index]);
+    });
+    for(unsigned t = 0; t < threads; ++t) {
+        complete = complete && !broken[t];
+        for(auto &site : found[t]) {
+            sites.emplace(site.first, std::move(site.second));
+        }
+    }
+
+    //decode a batch of blocks in parallel and write the text in order
+    static constexpr size_t BATCH_BYTES = 4 * 1024 * 1024;
+    std::vector<std::string> texts(threads);
+
+    for(size_t first = 0; first < blocks.size();) {
+        size_t last = first;
+        size_t bytes = 0;
+
+        while(last < blocks.size() && bytes < threads * BATCH_BYTES) {
+            bytes += blocks[last++].length;
+        }
+
+        for(unsigned t = 0; t < threads; ++t) {
+            texts[t].clear();
+            broken[t] = false;
+        }
+        parallelFor(threads, last - first, [&](size_t begin, size_t end, unsigned index) {
+            for(size_t i = first + begin; i < first + end; ++i) {
+                broken[index] = !decodeBlock_(blocks[i], sites, timestamps, texts[index]) || broken[index];
+            }
+        });
+        for(unsigned t = 0; t < threads; ++t) {
+            complete = complete && !broken[t];
+            std::fwrite(texts[t].data(), 1, texts[t].size(), out);
+        }
+
+        first = last;
+    }
+
+    return complete;
+}
+
+bool BinaryLogReader::scan_(std::vector<Block> &blocks) const noexcept {
+    size_t offset = 0;
+    size_t session = 0;
+
+    while(offset < size_) {
+        BinaryLog::BlockHeader header;
+
+        if(size_ - offset < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, map_ + offset, sizeof(header));
+        offset += sizeof(header);
+
+        if(header.length > size_ - offset) {
+            return false;
+        }
+
+        if(header.magic == BinaryLog::SESSION) {
+            uint32_t version;
+
+            if(header.length < sizeof(version)) {
+                return false;
+            }
+            std::memcpy(&version, map_ + offset, sizeof(version));
+            if(version != BinaryLog::VERSION) {
+                return false;
+            }
+            ++session;
+        } else if(header.magic == BinaryLog::DATA && session > 0) {
+            blocks.push_back({map_ + offset, header.length, session});
+        } else {
+            return false;
+        }
+
+        offset += header.length;
+    }
+    return true;
+}
+
+bool BinaryLogReader::readSites_(const Block *begin, const Block *end, Sites &sites) const {
+    for(const Block *block = begin; block != end; ++block) {
+        const char *src = block->data;
+        const char *stop = src + block->length;
+        uint64_t value;
+        const char *bytes;
+        size_t len;
+
+        while(src < stop) {
+            switch(*src++) {
+                case BinaryLog::SITE: {
+                    uint64_t id;
+                    auto site = Site::read(src, stop, id);
+
+                    if(!site) {
+                        return false;
+                    }
+                    sites.emplace(block->session << 32 | id, std::move(site));
+                    break;
+                }
+                case BinaryLog::RECORD:
+                    //site id, then the same as a text entry
+                    if(!BinaryLog::getVarint(src, stop, value) ||
+                       !BinaryLog::getVarint(src, stop, value) || !getBytes(src, stop, bytes, len)) {
+                        return false;
+                    }
+                    break;
+                case BinaryLog::TEXT:
+                    //level, timestamp, message
+                    if(src == stop || !BinaryLog::getVarint(++src, stop, value) || !getBytes(src, stop, bytes, len)) {
+                        return false;
+                    }
+                    break;
+                default:
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool BinaryLogReader::decodeBlock_(const Block &block, const Sites &sites, bool timestamps, std::string &text) const {
+    const char *src = block.data;
+    const char *stop = src + block.length;
+    int64_t timestamp = 0;
+    time_t second = -1;
+    char date[32] = "";
+    char buf[LogRecord::PAYLOAD_SIZE];
+
+    auto append = [&](LogLevel level, const char *str, size_t len) {
+        if(timestamps) {
+            time_t now = timestamp / 1000000000;
+
+            //the date changes once per second
+            if(now != second) {
+                struct tm tm;
+
+                second = now;
+                localtime_r(&now, &tm);
+                strftime(date, sizeof(date), "%F %T", &tm);
+            }
+
+            char micros[16];
+            int n = snprintf(micros, sizeof(micros), ".%06ld ", static_cast<long>(timestamp % 1000000000 / 1000));
+
+            text.append(date);
+            text.append(micros, n);
+        }
+
+        const LogLevelTag &tag = LOG_LEVEL_TAGS[static_cast<int>(level)];
+
+        text.append(tag.str, tag.len);
+        text.append(str, len);
+        text.push_back('\n');
+    };
+
+    while(src < stop) {
+        uint8_t type = *src++;
+        uint64_t id;
+        uint64_t delta;
+        const char *bytes;
+        size_t len;
+
+        if(type == BinaryLog::SITE) {
+            if(!Site::read(src, stop, id)) {
+                return false;
+            }
+            continue;
+        }
+
+        if(type == BinaryLog::TEXT) {
+            if(src == stop) {
+                return false;
+            }
+
+            uint8_t level = *src++;
+
+            if(level > static_cast<uint8_t>(LogLevel::Fatal) || !BinaryLog::getVarint(src, stop, delta) || !getBytes(src, stop, bytes, len)) {
+                return false;
+            }
+            timestamp += BinaryLog::unzigzag(delta);
+            append(static_cast<LogLevel>(level), bytes, len);
+            continue;
+        }
+
+        if(type != BinaryLog::RECORD ||
+           !BinaryLog::getVarint(src, stop, id) || !BinaryLog::getVarint(src, stop, delta) || !getBytes(src, stop, bytes, len)) {
+            return false;
+        }
+        timestamp += BinaryLog::unzigzag(delta);
+
+        auto found = sites.find(block.session << 32 | id);
+
+        if(found == sites.end()) {
+            return false;
+        }
+
+        //the same steps as LogCapture::format
+        const Site &site = *found->second;
+        const char *args = bytes;
+        size_t length = formatPrefix(site.site, buf, sizeof(buf));
+        FormatWriter writer(buf + length, sizeof(buf) - length);
+        size_t arg = 0;
+
+        for(auto &op : site.ops) {
+            if(op.literal) {
+                writer.append(op.literal, op.length);
+            } else if(arg < site.types.size() && !writePacked(writer, op.spec, site.types[arg++], args, bytes + len)) {
+                return false;
+            }
+        }
+        length += writer.finish();
+
+        append(site.site.level, buf, length);
+    }
+    return true;
+}
+
+} //namespace util
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#ifndef BINARY_LOGGER_HPP__
+#define BINARY_LOGGER_HPP__
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdio>
+
+#include "logger.hpp"
+#include "fd_logger.hpp"
+
+namespace util {
+
+/**
+ * Layout of the files written by BinaryLogger, in host byte order.
+ *
+ * A file is a sequence of blocks, each starting with a BlockHeader. A session block
+ * starts the output of one BinaryLogger and is followed by data blocks holding entries:
+ *   SITE   id, level, prefix, line, argument count, ArgType of each argument, file, function, format
+ *   RECORD site id, timestamp, length of the arguments, arguments
+ *   TEXT   level, timestamp, length of the message, message
+ * Numbers are varints and timestamps are zigzag deltas to the previous entry of the block.
+ * Integer arguments are zigzag varints, strings are a varint length and the bytes.
+ * A call site is written once per session before its first record, so a data block
+ * can be decoded on its own once the sites of its session are known.
+ */
+struct BinaryLog {
+    static constexpr uint32_t SESSION = 0x53474c55; //"ULGS"
+    static constexpr uint32_t DATA = 0x44474c55; //"ULGD"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t MAX_STRING = 4096; //file, function and format are cut to this length
+
+    enum Entry : uint8_t {
+        SITE = 1,
+        RECORD,
+        TEXT
+    };
+
+    struct BlockHeader {
+        uint32_t magic;
+        uint32_t length; //bytes after the header
+    };
+
+    static char* putVarint(char *dst, uint64_t value) noexcept {
+        while(value >= 0x80) {
+            *dst++ = static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        *dst++ = static_cast<char>(value);
+        return dst;
+    }
+
+    /**
+     * @brief Read a varint from [src, end) and advance src
+     * @return return false if the varint runs past end
+     */
+    static bool getVarint(const char *&src, const char *end, uint64_t &value) noexcept {
+        value = 0;
+        for(int shift = 0; src < end && shift < 64; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*src++);
+
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if(!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static uint64_t zigzag(int64_t value) noexcept {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    static int64_t unzigzag(uint64_t value) noexcept {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+};
+
+/**
+ * Logger which writes records in the compact binary format of BinaryLog.
+ *
+ * The file, function and format of a call site are written once, after that a line
+ * costs its site id, timestamp and packed arguments. Entries are collected in a buffer
+ * which is written as one block according to the FlushPolicy.
+ * BinaryLogReader and the log_decode tool turn the file back into text.
+ */
+class BinaryLogger : public RecordLogger {
+public:
+    /**
+     * @brief Append to a file, which is created if it doesn't exist
+     */
+    explicit BinaryLogger(const std::string &fileName, const FlushPolicy &policy = FlushPolicy());
+    virtual ~BinaryLogger();
+
+    BinaryLogger(const BinaryLogger&) = delete;
+    BinaryLogger& operator = (const BinaryLogger&) = delete;
+
+    virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+    virtual void out(const LogRecord &record) override;
+    virtual void flush() override;
+
+    bool isOpen() const noexcept {
+        return fd_ >= 0;
+    }
+
+    /**
+     * @brief Bytes logged so far, including the buffered ones
+     */
+    size_t bytes() const noexcept {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    //room for the site and the record of one call
+    static constexpr size_t MAX_ENTRIES = 4 * BinaryLog::MAX_STRING + 2 * LogRecord::PAYLOAD_SIZE;
+
+    //a call site which logs with several formats, e.g. a rate limited one, gets an id for each
+    using SiteKey = std::pair<const LogSite*, const FormatString*>;
+
+    struct SiteKeyHash {
+        size_t operator()(const SiteKey &key) const noexcept {
+            return std::hash<const void*>()(key.first) ^ (std::hash<const void*>()(key.second) << 1);
+        }
+    };
+
+    void putText_(LogLevel level, int64_t timestamp, const char *str, size_t len) noexcept;
+    char* putSite_(char *dst, const LogRecord &record, uint64_t &id) noexcept;
+    char* putTimestamp_(char *dst, int64_t timestamp) noexcept;
+    void commit_(char *end, LogLevel level) noexcept;
+    void write_() noexcept;
+
+    int fd_;
+    const FlushPolicy policy_;
+    std::mutex mutex_;
+    std::unique_ptr<char[]> buffer_;
+    size_t used_;                           //bytes of the block in the buffer, including its header
+    int64_t timestamp_;                     //timestamp of the previous entry of the block
+    std::unordered_map<SiteKey, uint64_t, SiteKeyHash> sites_;
+    std::atomic<size_t> bytes_;
+    Clock::time_point flushed_;
+};
+
+/**
+ * Reads a file written by BinaryLogger and writes it as text, the way the text loggers print it.
+ * Blocks are decoded in parallel and written in order.
+ */
+class BinaryLogReader {
+public:
+    explicit BinaryLogReader(const std::string &fileName);
+    ~BinaryLogReader();
+
+    BinaryLogReader(const BinaryLogReader&) = delete;
+    BinaryLogReader& operator = (const BinaryLogReader&) = delete;
+
+    bool isOpen() const noexcept {
+        return fd_ >= 0;
+    }
+
+    /**
+     * @brief Decode the file into `out`
+     * @param threads number of threads decoding blocks
+     * @param timestamps print the local time of a line before it
+     * @return return false if the file is broken, the lines before the broken part are written
+     */
+    bool decode(std::FILE *out, unsigned threads = 1, bool timestamps = false);
+
+private:
+    struct Block {
+        const char *data;
+        size_t length;
+        size_t session;
+    };
+
+    struct Site;
+    using Sites = std::unordered_map<uint64_t, std::unique_ptr<Site>>; //by session << 32 | id
+
+    bool scan_(std::vector<Block> &blocks) const noexcept;
+    bool readSites_(const Block *begin, const Block *end, Sites &sites) const;
+    bool decodeBlock_(const Block &block, const Sites &sites, bool timestamps, std::string &text) const;
+
+    int fd_;
+    const char *map_;
+    size_t size_;
+};
+
+} //namespace util
+
+#endif //BINARY_LOGGER_HPP__
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fd_logger.hpp"
+
+namespace util {
+
+FdLogger::FdLogger(int fd, const FlushPolicy &policy) : fd_(fd),
+                                                        owned_(false),
+                                                        policy_(policy),
+                                                        buffer_(new char[policy.bytes]),
+                                                        used_(0),
+                                                        bytes_(0),
+                                                        flushed_(Clock::now()),
+                                                        stopped_(false) {
+    if(policy_.interval.count() > 0) {
+        flusher_ = std::thread([this] { flushLoop_(); });
+    }
+}
+
+FdLogger::FdLogger(const std::string &fileName, const FlushPolicy &policy) : FdLogger(-1, policy) {
+    fd_ = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd_ < 0) {
+        std::cerr << "Fail to open " << fileName << " : " << strerror(errno) << std::endl;
+        return;
+    }
+    owned_ = true;
+}
+
+FdLogger::~FdLogger() {
+    if(flusher_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        buffered_.notify_one();
+        flusher_.join();
+    }
+    flush();
+
+    if(owned_) {
+        close(fd_);
+    }
+}
+
+void FdLogger::out(LogLevel level, const char* str) {
+    out(level, str, strlen(str));
+}
+
+void FdLogger::out(LogLevel level, const char* str, size_t len) {
+    if(fd_ < 0) {
+        return;
+    }
+
+    append_(level, LOG_LEVEL_TAGS[static_cast<int>(level)], str, len);
+}
+
+void FdLogger::writeLine(LogLevel level, const char *line, size_t len) noexcept {
+    if(fd_ < 0) {
+        return;
+    }
+
+    append_(level, LogLevelTag {"", 0}, line, len);
+}
+
+void FdLogger::append_(LogLevel level, const LogLevelTag &tag, const char *str, size_t len) noexcept {
+    size_t lineLen = tag.len + len + 1;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    bytes_.fetch_add(lineLen, std::memory_order_relaxed);
+
+    if(used_ + lineLen > policy_.bytes) {
+        //write the buffer and this line together, the line is not copied
+        struct iovec iov[] = {
+            {buffer_.get(), used_},
+            {const_cast<char*>(tag.str), tag.len},
+            {const_cast<char*>(str), len},
+            {const_cast<char*>("\n"), 1}
+        };
+
+        write_(iov, 4);
+        used_ = 0;
+        flushed_ = Clock::now();
+        return;
+    }
+
+    char *dst = buffer_.get() + used_;
+    std::memcpy(dst, tag.str, tag.len);
+    std::memcpy(dst + tag.len, str, len);
+    dst[lineLen - 1] = '\n';
+    used_ += lineLen;
+
+    auto now = Clock::now();
+    if(level >= policy_.level || now - flushed_ >= policy_.interval) {
+        struct iovec iov = {buffer_.get(), used_};
+
+        write_(&iov, 1);
+        used_ = 0;
+        flushed_ = now;
+    } else if(used_ == lineLen) {
+        //the first line in the buffer, it is written at the latest when the interval has passed
+        buffered_.notify_one();
+    }
+}
+
+void FdLogger::flushLoop_() noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while(!stopped_) {
+        if(used_ == 0) {
+            buffered_.wait(lock);
+            continue;
+        }
+
+        auto deadline = flushed_ + policy_.interval;
+        if(Clock::now() < deadline) {
+            buffered_.wait_until(lock, deadline);
+            continue;
+        }
+
+        struct iovec iov = {buffer_.get(), used_};
+
+        write_(&iov, 1);
+        used_ = 0;
+        flushed_ = Clock::now();
+    }
+}
+
+void FdLogger::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if(fd_ < 0 || used_ == 0) {
+        return;
+    }
+
+    struct iovec iov = {buffer_.get(), used_};
+
+    write_(&iov, 1);
+    used_ = 0;
+    flushed_ = Clock::now();
+}
+
+void FdLogger::write_(const struct iovec *iov, int count) noexcept {
+    struct iovec pending[4];
+
+    std::copy(iov, iov + count, pending);
+
+    //writev may write only a part, continue from where it stopped
+    for(int i = 0; i < count;) {
+        ssize_t written = writev(fd_, pending + i, count - i);
+
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        while(i < count && static_cast<size_t>(written) >= pending[i].iov_len) {
+            written -= pending[i].iov_len;
+            ++i;
+        }
+        if(i < count) {
+            pending[i].iov_base = static_cast<char*>(pending[i].iov_base) + written;
+            pending[i].iov_len -= written;
+        }
+    }
+
+    if(policy_.sync) {
+        fdatasync(fd_);
+    }
+}
+
+} //namespace util
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef FD_LOGGER_HPP__
+#define FD_LOGGER_HPP__
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <condition_variable>
+#include <sys/uio.h>
+
+#include "logger.hpp"
+
+namespace util {
+
+/**
+ * When the buffered lines of a logger are written to its file
+ */
+struct FlushPolicy {
+    size_t bytes = 64 * 1024;                   //buffer size, lines are written when it is full
+    std::chrono::milliseconds interval {100};   //lines older than this are written, also without a next line
+    LogLevel level = LogLevel::Error;           //lines of this level or higher are written at once
+    bool sync = false;                          //fdatasync() after every write
+};
+
+/**
+ * Logger which writes lines to a file descriptor.
+ *
+ * Lines are collected in a buffer and written with one writev() per flush,
+ * instead of one write per line. A line which doesn't fit in the buffer is
+ * written together with the buffer in the same writev() without being copied.
+ * A thread of the logger writes the buffer once its oldest line is FlushPolicy::interval old.
+ */
+class FdLogger : public ILogger {
+public:
+    /**
+     * @brief Write to an open file descriptor, which is not closed by FdLogger
+     */
+    explicit FdLogger(int fd, const FlushPolicy &policy = FlushPolicy());
+
+    /**
+     * @brief Append to a file, which is created if it doesn't exist
+     */
+    explicit FdLogger(const std::string &fileName, const FlushPolicy &policy = FlushPolicy());
+    virtual ~FdLogger();
+
+    FdLogger(const FdLogger&) = delete;
+    FdLogger& operator = (const FdLogger&) = delete;
+
+    virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+    virtual void flush() override;
+
+    /**
+     * @brief Write a line without the level tag, it must not end with '\n'
+     */
+    void writeLine(LogLevel level, const char *line, size_t len) noexcept;
+
+    bool isOpen() const noexcept {
+        return fd_ >= 0;
+    }
+
+    /**
+     * @brief Bytes of the lines logged so far, including the buffered ones
+     */
+    size_t bytes() const noexcept {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void append_(LogLevel level, const LogLevelTag &tag, const char *str, size_t len) noexcept;
+    void write_(const struct iovec *iov, int count) noexcept;
+    void flushLoop_() noexcept;
+
+    int fd_;
+    bool owned_;
+    const FlushPolicy policy_;
+    std::mutex mutex_;
+    std::unique_ptr<char[]> buffer_;
+    size_t used_;
+    std::atomic<size_t> bytes_;
+    Clock::time_point flushed_;
+    bool stopped_;
+    std::condition_variable buffered_;  //notified when a line is buffered into an empty buffer
+    std::thread flusher_;               //writes the buffer when the interval has passed, if the interval is not 0
+};
+
+} //namespace util
+
+#endif //FD_LOGGER_HPP__
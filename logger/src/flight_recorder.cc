@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <chrono>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "flight_recorder.hpp"
+
+namespace util {
+
+namespace {
+const int CRASH_SIGNALS[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+struct sigaction previousActions[sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0])];
+char crashFile[PATH_MAX];
+char crashStack[64 * 1024];
+
+std::string segmentName(const std::string &name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+//the functions below are async-signal-safe
+
+void writeAll(int fd, const char *data, size_t len) noexcept {
+    while(len > 0) {
+        ssize_t written = write(fd, data, len);
+
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+size_t writeDecimal(char *dst, uint64_t value, size_t digits) noexcept {
+    for(size_t i = digits; i > 0; --i) {
+        dst[i - 1] = '0' + value % 10;
+        value /= 10;
+    }
+    return digits;
+}
+
+size_t writeDecimal(char *dst, uint64_t value) noexcept {
+    size_t digits = 1;
+
+    for(uint64_t rest = value / 10; rest > 0; rest /= 10) {
+        ++digits;
+    }
+    return writeDecimal(dst, value, digits);
+}
+}
+
+std::atomic<FlightRecorder*> FlightRecorder::s_crashRecorder {nullptr};
+
+FlightRecorder::FlightRecorder(const std::string &name, size_t bytes) : name_(segmentName(name)),
+                                                                        size_(0),
+                                                                        header_(nullptr),
+                                                                        slots_(nullptr),
+                                                                        mask_(0) {
+    uint64_t slots = logSlotCount(bytes);
+
+    size_ = sizeof(Header) + slots * sizeof(LogSlot);
+
+    int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if(fd < 0) {
+        std::cerr << "Fail to open shared memory " << name_ << " : " << strerror(errno) << std::endl;
+        return;
+    }
+
+    //drop the content of a previous segment before it is resized
+    void *map = MAP_FAILED;
+
+    if(ftruncate(fd, 0) == 0 && ftruncate(fd, size_) == 0) {
+        map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if(map == MAP_FAILED) {
+        std::cerr << "Fail to map shared memory " << name_ << " : " << strerror(errno) << std::endl;
+        shm_unlink(name_.c_str());
+        return;
+    }
+
+    header_ = static_cast<Header*>(map);
+    header_->magic = MAGIC;
+    header_->version = VERSION;
+    header_->slotSize = sizeof(LogSlot);
+    header_->slots = slots;
+    header_->pid = getpid();
+    header_->head.store(0, std::memory_order_release);
+    slots_ = reinterpret_cast<LogSlot*>(header_ + 1);
+    mask_ = slots - 1;
+}
+
+FlightRecorder::~FlightRecorder() {
+    FlightRecorder *self = this;
+
+    if(s_crashRecorder.compare_exchange_strong(self, nullptr)) {
+        for(size_t i = 0; i < sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]); ++i) {
+            sigaction(CRASH_SIGNALS[i], &previousActions[i], nullptr);
+        }
+    }
+
+    if(header_) {
+        munmap(header_, size_);
+        shm_unlink(name_.c_str());
+    }
+}
+
+void FlightRecorder::out(LogLevel level, const char* str) {
+    out(level, str, strnlen(str, MAX_SLOTS * LogSlot::TEXT_SIZE));
+}
+
+void FlightRecorder::out(LogLevel level, const char* str, size_t len) {
+    out(level, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+        str, len);
+}
+
+void FlightRecorder::out(LogLevel level, int64_t timestamp, const char* str, size_t len) {
+    if(!header_) {
+        return;
+    }
+
+    writeLogSlots(slots_, mask_ + 1, header_->head, MAX_SLOTS, level, timestamp, str, len);
+}
+
+void FlightRecorder::dumpOnCrash(const std::string &fileName) {
+    if(!header_) {
+        return;
+    }
+
+    strncpy(crashFile, fileName.c_str(), sizeof(crashFile) - 1);
+
+    FlightRecorder *expected = nullptr;
+
+    if(!s_crashRecorder.compare_exchange_strong(expected, this)) {
+        s_crashRecorder.store(this);
+        return;
+    }
+
+    stack_t stack;
+
+    stack.ss_sp = crashStack;
+    stack.ss_size = sizeof(crashStack);
+    stack.ss_flags = 0;
+    sigaltstack(&stack, nullptr);
+
+    struct sigaction action;
+
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = &FlightRecorder::crashHandler_;
+    action.sa_flags = SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    for(size_t i = 0; i < sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]); ++i) {
+        sigaction(CRASH_SIGNALS[i], &action, &previousActions[i]);
+    }
+}
+
+bool FlightRecorder::dump(int fd, bool timestamps) const noexcept {
+    return header_ && dump_(header_, size_, fd, timestamps);
+}
+
+bool FlightRecorder::dump(const std::string &name, int fd, bool timestamps) {
+    struct stat st;
+    int shm = shm_open(segmentName(name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+
+    if(shm < 0) {
+        return false;
+    }
+    if(fstat(shm, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        close(shm);
+        return false;
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, shm, 0);
+
+    close(shm);
+    if(map == MAP_FAILED) {
+        return false;
+    }
+
+    bool dumped = dump_(static_cast<const Header*>(map), st.st_size, fd, timestamps);
+
+    munmap(map, st.st_size);
+    return dumped;
+}
+
+bool FlightRecorder::remove(const std::string &name) {
+    return shm_unlink(segmentName(name).c_str()) == 0;
+}
+
+bool FlightRecorder::dump_(const Header *header, size_t size, int fd, bool timestamps) noexcept {
+    if(header->magic != MAGIC || header->version != VERSION || header->slotSize != sizeof(LogSlot) ||
+       header->slots == 0 || (header->slots & (header->slots - 1)) != 0 ||
+       header->slots > (size - sizeof(Header)) / sizeof(LogSlot)) {
+        return false;
+    }
+
+    //the prefix of a line goes in front of its text, the newline after it
+    char line[64 + MAX_SLOTS * LogSlot::TEXT_SIZE + 1];
+
+    auto wanted = [](uint8_t level, int64_t) {
+        return level <= static_cast<uint8_t>(LogLevel::Fatal);
+    };
+    auto print = [&](char *text, size_t len, uint8_t level, int64_t timestamp) {
+        char prefix[64];
+        size_t prefixLen = 0;
+
+        if(timestamps) {
+            prefixLen += writeDecimal(prefix + prefixLen, timestamp / 1000000000);
+            prefix[prefixLen++] = '.';
+            prefixLen += writeDecimal(prefix + prefixLen, timestamp % 1000000000 / 1000, 6);
+            prefix[prefixLen++] = ' ';
+        }
+
+        const LogLevelTag &tag = LOG_LEVEL_TAGS[level];
+
+        std::memcpy(prefix + prefixLen, tag.str, tag.len);
+        prefixLen += tag.len;
+
+        std::memcpy(text - prefixLen, prefix, prefixLen);
+        text[len++] = '\n';
+        writeAll(fd, text - prefixLen, prefixLen + len);
+    };
+    readLogSlots(reinterpret_cast<const LogSlot*>(header + 1), header->slots, header->head.load(std::memory_order_acquire),
+                 line + 64, MAX_SLOTS * LogSlot::TEXT_SIZE, wanted, print);
+    return true;
+}
+
+void FlightRecorder::crashHandler_(int signal) noexcept {
+    FlightRecorder *recorder = s_crashRecorder.load();
+
+    if(recorder) {
+        int fd = crashFile[0] ? open(crashFile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : STDERR_FILENO;
+
+        if(fd >= 0) {
+            recorder->dump(fd, true);
+            if(fd != STDERR_FILENO) {
+                close(fd);
+            }
+        }
+    }
+
+    //hand the signal to the previous handler or the default action once this handler returns
+    for(size_t i = 0; i < sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]); ++i) {
+        if(CRASH_SIGNALS[i] == signal) {
+            sigaction(signal, &previousActions[i], nullptr);
+        }
+    }
+    raise(signal);
+}
+
+} //namespace util
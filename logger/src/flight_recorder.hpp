@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#ifndef FLIGHT_RECORDER_HPP__
+#define FLIGHT_RECORDER_HPP__
+
+#include <atomic>
+#include <string>
+#include <csignal>
+
+#include "logger.hpp"
+#include "log_slots.hpp"
+
+namespace util {
+
+/**
+ * Logger which keeps the latest lines in a POSIX shared memory segment, so they
+ * outlive a crash of the process.
+ *
+ * The segment is a header followed by a ring of LogSlot, so a reader never blocks the callers
+ * and tells the slots of the latest lap from older ones.
+ *
+ * The segment is removed when the recorder is destroyed. After a crash it is left
+ * in place, and flight_reader prints it.
+ */
+class FlightRecorder : public ILogger {
+public:
+    static constexpr size_t SIZE = 4 * 1024 * 1024;
+
+    /**
+     * @brief Create the shared memory segment /<name>, a segment left by a previous run is replaced
+     * @param bytes size of the ring, rounded down to a power of two number of slots
+     */
+    explicit FlightRecorder(const std::string &name, size_t bytes = SIZE);
+    virtual ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator = (const FlightRecorder&) = delete;
+
+    virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+    virtual void out(LogLevel level, int64_t timestamp, const char* str, size_t len) override;
+
+    bool isOpen() const noexcept {
+        return header_ != nullptr;
+    }
+
+    /**
+     * @brief Write the lines of the ring to `fileName`, or to stderr if it is empty, when the process
+     *        gets SIGSEGV, SIGBUS, SIGFPE, SIGILL or SIGABRT. The signal then terminates the process as before.
+     *        The handler runs on an alternate stack of the calling thread, so a stack overflow of this thread is dumped too.
+     */
+    void dumpOnCrash(const std::string &fileName = std::string());
+
+    /**
+     * @brief Write the lines of the ring, oldest first, as "[LEVEL]message". Async-signal-safe.
+     * @param timestamps print "seconds.microseconds " since epoch before a line
+     */
+    bool dump(int fd, bool timestamps = false) const noexcept;
+
+    /**
+     * @brief Write the lines of the segment /<name>, e.g. the one of a crashed process
+     * @return return false if there is no such segment or it is not a flight recorder
+     */
+    static bool dump(const std::string &name, int fd, bool timestamps = false);
+
+    /**
+     * @brief Remove the segment /<name> left by a crashed process
+     */
+    static bool remove(const std::string &name);
+
+private:
+    static constexpr uint64_t MAGIC = 0x4452434552544c46; //"FLTRECRD"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t MAX_SLOTS = 8; //of one line, longer lines are cut
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t slotSize;
+        uint64_t slots;
+        int32_t pid;
+        alignas(64) std::atomic<uint64_t> head; //next ticket
+    };
+
+    static bool dump_(const Header *header, size_t size, int fd, bool timestamps) noexcept;
+    static void crashHandler_(int signal) noexcept;
+
+    std::string name_;
+    size_t size_;
+    Header *header_;
+    LogSlot *slots_;
+    uint64_t mask_;
+
+    static std::atomic<FlightRecorder*> s_crashRecorder;
+};
+
+} //namespace util
+
+#endif //FLIGHT_RECORDER_HPP__
@@ -0,0 +1,680 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_FORMAT_HPP__
+#define LOG_FORMAT_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <charconv>
+#include <algorithm>
+#include <tuple>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <initializer_list>
+
+namespace util {
+
+/**
+ * Conversion specification of one printf-style argument, e.g. "%-08.3f"
+ */
+struct FormatSpec {
+    enum Flag : uint8_t {
+        LEFT = 1,
+        PLUS = 2,
+        SPACE = 4,
+        ZERO = 8,
+        ALT = 16
+    };
+
+    char conversion = '\0';
+    uint8_t flags = 0;
+    int width = -1;
+    int precision = -1;
+};
+
+/**
+ * One step of a compiled format, either literal text or an argument
+ */
+struct FormatOp {
+    const char *literal = nullptr; //nullptr for an argument
+    size_t length = 0;
+    FormatSpec spec;
+};
+
+/**
+ * Functions called when a format string is rejected at compile time.
+ * They are not constexpr, so the compiler reports their name as the error.
+ */
+inline void formatErrorTooFewArguments() {}
+inline void formatErrorTooManyArguments() {}
+inline void formatErrorIncompleteSpecifier() {}
+inline void formatErrorUnsupportedConversion() {}
+inline void formatErrorArgumentTypeMismatch() {}
+
+/**
+ * Parse a printf-style format, calling visitor.literal(str, len) and visitor.argument(spec) in order.
+ * Length modifiers (h, l, ll, z, ...) are accepted and ignored, the argument type decides.
+ */
+template<typename Visitor>
+constexpr void parseFormat(const char *format, Visitor &visitor) {
+    const char *p = format;
+    const char *literal = p;
+
+    while(*p) {
+        if(*p != '%') {
+            ++p;
+            continue;
+        }
+
+        if(p > literal) {
+            visitor.literal(literal, p - literal);
+        }
+        ++p;
+
+        if(*p == '%') {
+            visitor.literal(p, 1);
+            literal = ++p;
+            continue;
+        }
+
+        FormatSpec spec;
+
+        for(bool flag = true; flag; ) {
+            switch(*p) {
+                case '-': spec.flags |= FormatSpec::LEFT; ++p; break;
+                case '+': spec.flags |= FormatSpec::PLUS; ++p; break;
+                case ' ': spec.flags |= FormatSpec::SPACE; ++p; break;
+                case '0': spec.flags |= FormatSpec::ZERO; ++p; break;
+                case '#': spec.flags |= FormatSpec::ALT; ++p; break;
+                default: flag = false; break;
+            }
+        }
+
+        if(*p >= '0' && *p <= '9') {
+            spec.width = 0;
+            while(*p >= '0' && *p <= '9') {
+                spec.width = spec.width * 10 + (*p++ - '0');
+            }
+        }
+
+        if(*p == '.') {
+            ++p;
+            spec.precision = 0;
+            while(*p >= '0' && *p <= '9') {
+                spec.precision = spec.precision * 10 + (*p++ - '0');
+            }
+        }
+
+        while(*p == 'h' || *p == 'l' || *p == 'L' || *p == 'q' || *p == 'j' || *p == 'z' || *p == 't') {
+            ++p;
+        }
+
+        switch(*p) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+            case 's': case 'p':
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                spec.conversion = *p++;
+                break;
+            case '\0':
+                formatErrorIncompleteSpecifier();
+                return;
+            default:
+                formatErrorUnsupportedConversion();
+                return;
+        }
+
+        visitor.argument(spec);
+        literal = p;
+    }
+
+    if(p > literal) {
+        visitor.literal(literal, p - literal);
+    }
+}
+
+/**
+ * Number of FormatOp a format compiles into
+ */
+constexpr size_t countFormatOps(const char *format) {
+    struct Counter {
+        size_t count = 0;
+        constexpr void literal(const char*, size_t) { ++count; }
+        constexpr void argument(const FormatSpec&) { ++count; }
+    } counter;
+
+    parseFormat(format, counter);
+    return counter.count;
+}
+
+template<typename T>
+struct IsDuration : std::false_type {};
+
+template<typename Rep, typename Period>
+struct IsDuration<std::chrono::duration<Rep, Period>> : std::true_type {};
+
+/**
+ * Whether an argument of type T can be printed with the given conversion
+ */
+template<typename T>
+constexpr bool acceptsConversion(char conversion) {
+    using U = typename std::decay<T>::type;
+    constexpr bool isString = std::is_same<U, const char*>::value || std::is_same<U, char*>::value ||
+                              std::is_same<U, std::string>::value;
+    constexpr bool isInteger = std::is_integral<U>::value || std::is_enum<U>::value ||
+                               std::is_same<U, std::thread::id>::value || IsDuration<U>::value;
+
+    switch(conversion) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+            return isInteger;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            return std::is_floating_point<U>::value || IsDuration<U>::value;
+        case 's':
+            return isString;
+        case 'p':
+            return std::is_pointer<U>::value || std::is_null_pointer<U>::value;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Bounded output buffer of the formatter, it truncates silently like snprintf
+ */
+class FormatWriter final {
+public:
+    FormatWriter(char *buf, size_t size) noexcept : buf_(buf), size_(size), len_(0) {}
+
+    void append(const char *str, size_t len) noexcept {
+        len = std::min(len, room_());
+        std::memcpy(buf_ + len_, str, len);
+        len_ += len;
+    }
+
+    void append(char c, size_t count = 1) noexcept {
+        count = std::min(count, room_());
+        std::memset(buf_ + len_, c, count);
+        len_ += count;
+    }
+
+    /**
+     * @brief Terminate the output with null
+     * @return return the length of the output without null
+     */
+    size_t finish() noexcept {
+        if(size_ > 0) {
+            buf_[len_] = '\0';
+        }
+        return len_;
+    }
+
+private:
+    size_t room_() const noexcept {
+        return size_ > len_ + 1 ? size_ - len_ - 1 : 0;
+    }
+
+    char *buf_;
+    size_t size_;
+    size_t len_;
+};
+
+/**
+ * Growable buffer for lines which don't fit the stack buffer of their writer.
+ * It keeps its memory, so only a line longer than every line before allocates.
+ * Keep one per thread and per writer, e.g. as a static thread_local.
+ */
+class LineBuffer final {
+public:
+    static constexpr size_t MAX_SIZE = 64 << 20;
+
+    LineBuffer() noexcept : size_(0) {}
+    LineBuffer(const LineBuffer&) = delete;
+    LineBuffer& operator=(const LineBuffer&) = delete;
+
+    /**
+     * @brief Run write(buf, size) into `stack` first, and again into this buffer, grown, while the output fills it.
+     *        write returns the length of its output, or the length it needs like vsnprintf,
+     *        an output of size - 1 bytes or more is taken as cut. A line which can't be allocated stays cut.
+     * @param stack buffer of the caller for the common case
+     * @param size size of `stack`
+     * @param len set to the length of the line
+     * @return return the line, `stack` or the memory of this buffer
+     */
+    template<typename F>
+    char* format(char *stack, size_t size, size_t &len, F &&write) noexcept {
+        char *buf = stack;
+
+        len = write(buf, size);
+        while(len + 1 >= size && size < MAX_SIZE) {
+            size_t wanted = std::min(std::max(2 * size, len + 2), MAX_SIZE);
+
+            if(size_ < wanted) {
+                char *grown = new(std::nothrow) char[wanted];
+
+                if(!grown) {
+                    break;
+                }
+                data_.reset(grown);
+                size_ = wanted;
+            }
+
+            buf = data_.get();
+            size = size_;
+            len = write(buf, size);
+        }
+
+        len = std::min(len, size - 1);
+        return buf;
+    }
+
+private:
+    std::unique_ptr<char[]> data_;
+    size_t size_;
+};
+
+/**
+ * Write `prefix` + `zeros` zeros + `body` within the field width of the spec
+ */
+inline void writeField(FormatWriter &out, const FormatSpec &spec, const char *prefix, size_t prefixLen,
+                       size_t zeros, const char *body, size_t bodyLen, bool zeroPad) noexcept {
+    size_t total = prefixLen + zeros + bodyLen;
+    size_t pad = spec.width > 0 && static_cast<size_t>(spec.width) > total ? spec.width - total : 0;
+
+    if(spec.flags & FormatSpec::LEFT) {
+        out.append(prefix, prefixLen);
+        out.append('0', zeros);
+        out.append(body, bodyLen);
+        out.append(' ', pad);
+    } else if(zeroPad && (spec.flags & FormatSpec::ZERO)) {
+        out.append(prefix, prefixLen);
+        out.append('0', zeros + pad);
+        out.append(body, bodyLen);
+    } else {
+        out.append(' ', pad);
+        out.append(prefix, prefixLen);
+        out.append('0', zeros);
+        out.append(body, bodyLen);
+    }
+}
+
+template<typename T>
+void writeInteger(FormatWriter &out, const FormatSpec &spec, T value) noexcept {
+    using U = typename std::make_unsigned<T>::type;
+    const char conversion = spec.conversion;
+
+    if(conversion == 'c') {
+        char c = static_cast<char>(value);
+        writeField(out, spec, "", 0, 0, &c, 1, false);
+        return;
+    }
+
+    bool isSigned = conversion == 'd' || conversion == 'i';
+    bool negative = false;
+    U magnitude = static_cast<U>(value);
+
+    if(std::is_signed<T>::value && isSigned && value < 0) {
+        negative = true;
+        magnitude = static_cast<U>(U(0) - magnitude);
+    }
+
+    int base = conversion == 'o' ? 8 : (conversion == 'x' || conversion == 'X') ? 16 : 10;
+    char digits[72];
+    size_t len = std::to_chars(digits, digits + sizeof(digits), magnitude, base).ptr - digits;
+
+    if(conversion == 'X') {
+        std::transform(digits, digits + len, digits, [](char c) { return c >= 'a' ? c - 'a' + 'A' : c; });
+    }
+    if(spec.precision == 0 && magnitude == 0) {
+        len = 0;
+    }
+
+    size_t zeros = spec.precision > 0 && static_cast<size_t>(spec.precision) > len ? spec.precision - len : 0;
+    char prefix[2];
+    size_t prefixLen = 0;
+
+    if(negative) {
+        prefix[prefixLen++] = '-';
+    } else if(isSigned && (spec.flags & FormatSpec::PLUS)) {
+        prefix[prefixLen++] = '+';
+    } else if(isSigned && (spec.flags & FormatSpec::SPACE)) {
+        prefix[prefixLen++] = ' ';
+    } else if((spec.flags & FormatSpec::ALT) && magnitude != 0 && base == 16) {
+        prefix[prefixLen++] = '0';
+        prefix[prefixLen++] = conversion;
+    } else if((spec.flags & FormatSpec::ALT) && base == 8 && zeros == 0 && (len == 0 || digits[0] != '0')) {
+        zeros = 1;
+    }
+
+    writeField(out, spec, prefix, prefixLen, zeros, digits, len, spec.precision < 0);
+}
+
+inline void writeFloat(FormatWriter &out, const FormatSpec &spec, double value) noexcept {
+    const char conversion = spec.conversion;
+    char digits[384];
+    std::to_chars_result result;
+    char *first = digits;
+    char *last = digits + sizeof(digits);
+
+    if(spec.flags & FormatSpec::ALT) {
+        //alternative forms are rare, leave them to the C library
+        char format[32];
+        char *p = format;
+        *p++ = '%';
+        if(spec.flags & FormatSpec::LEFT) *p++ = '-';
+        if(spec.flags & FormatSpec::PLUS) *p++ = '+';
+        if(spec.flags & FormatSpec::SPACE) *p++ = ' ';
+        if(spec.flags & FormatSpec::ZERO) *p++ = '0';
+        *p++ = '#';
+        *p++ = '*';
+        *p++ = '.';
+        *p++ = '*';
+        *p++ = conversion;
+        *p = '\0';
+        int len = std::snprintf(digits, sizeof(digits), format, spec.width, spec.precision, value);
+        out.append(digits, len < 0 ? 0 : std::min<size_t>(len, sizeof(digits) - 1));
+        return;
+    }
+
+    int precision = spec.precision < 0 ? 6 : spec.precision;
+
+    switch(conversion) {
+        case 'f': case 'F':
+            result = std::to_chars(first, last, value, std::chars_format::fixed, precision);
+            break;
+        case 'e': case 'E':
+            result = std::to_chars(first, last, value, std::chars_format::scientific, precision);
+            break;
+        case 'g': case 'G':
+            result = std::to_chars(first, last, value, std::chars_format::general, precision == 0 ? 1 : precision);
+            break;
+        default:
+            result = spec.precision < 0 ? std::to_chars(first, last, value, std::chars_format::hex) :
+                                          std::to_chars(first, last, value, std::chars_format::hex, precision);
+            break;
+    }
+
+    if(result.ec != std::errc()) {
+        out.append("?", 1);
+        return;
+    }
+
+    size_t len = result.ptr - first;
+    bool negative = *first == '-';
+    bool finite = std::isfinite(value);
+
+    if(negative) {
+        ++first;
+        --len;
+    }
+    if(conversion >= 'A' && conversion <= 'Z') {
+        std::transform(first, first + len, first, [](char c) { return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c; });
+    }
+
+    char prefix[3];
+    size_t prefixLen = 0;
+
+    if(negative) {
+        prefix[prefixLen++] = '-';
+    } else if(spec.flags & FormatSpec::PLUS) {
+        prefix[prefixLen++] = '+';
+    } else if(spec.flags & FormatSpec::SPACE) {
+        prefix[prefixLen++] = ' ';
+    }
+    if((conversion == 'a' || conversion == 'A') && finite) {
+        prefix[prefixLen++] = '0';
+        prefix[prefixLen++] = conversion == 'a' ? 'x' : 'X';
+    }
+
+    writeField(out, spec, prefix, prefixLen, 0, first, len, finite);
+}
+
+inline void writeFloat(FormatWriter &out, const FormatSpec &spec, long double value) noexcept {
+    writeFloat(out, spec, static_cast<double>(value));
+}
+
+inline void writeString(FormatWriter &out, const FormatSpec &spec, const char *str, size_t len) noexcept {
+    if(spec.precision >= 0) {
+        len = std::min<size_t>(len, spec.precision);
+    }
+    writeField(out, spec, "", 0, 0, str, len, false);
+}
+
+inline void writeString(FormatWriter &out, const FormatSpec &spec, const char *str) noexcept {
+    if(!str) {
+        str = "(null)";
+    }
+    if(spec.precision >= 0) {
+        writeString(out, spec, str, strnlen(str, spec.precision));
+    } else {
+        writeString(out, spec, str, std::strlen(str));
+    }
+}
+
+inline void writePointer(FormatWriter &out, const FormatSpec &spec, const void *ptr) noexcept {
+    if(!ptr) {
+        writeField(out, spec, "", 0, 0, "(nil)", 5, false);
+        return;
+    }
+
+    char digits[24];
+    size_t len = std::to_chars(digits, digits + sizeof(digits), reinterpret_cast<uintptr_t>(ptr), 16).ptr - digits;
+
+    writeField(out, spec, "0x", 2, 0, digits, len, false);
+}
+
+/**
+ * Write one argument with its conversion specification.
+ * The format was validated against the argument type at compile time.
+ */
+template<typename T>
+void writeArg(FormatWriter &out, const FormatSpec &spec, const T &value) noexcept {
+    using U = typename std::decay<T>::type;
+
+    if constexpr(std::is_same<U, const char*>::value || std::is_same<U, char*>::value) {
+        writeString(out, spec, value);
+    } else if constexpr(std::is_same<U, std::string>::value) {
+        writeString(out, spec, value.data(), value.size());
+    } else if constexpr(std::is_same<U, bool>::value) {
+        writeInteger(out, spec, static_cast<int>(value));
+    } else if constexpr(std::is_integral<U>::value) {
+        writeInteger(out, spec, value);
+    } else if constexpr(std::is_enum<U>::value) {
+        writeInteger(out, spec, static_cast<typename std::underlying_type<U>::type>(value));
+    } else if constexpr(std::is_floating_point<U>::value) {
+        writeFloat(out, spec, value);
+    } else if constexpr(IsDuration<U>::value) {
+        writeArg(out, spec, value.count());
+    } else if constexpr(std::is_same<U, std::thread::id>::value) {
+        //print the native handle, as printf used to do with the id passed through varargs
+        static_assert(sizeof(U) == sizeof(std::thread::native_handle_type), "unexpected std::thread::id layout");
+        std::thread::native_handle_type handle;
+        std::memcpy(&handle, &value, sizeof(handle));
+        writeArg(out, spec, handle);
+    } else {
+        writePointer(out, spec, static_cast<const void*>(value));
+    }
+}
+
+/**
+ * Kind and size in bytes of a captured argument, kept with the format for binary logs.
+ * kind is 'i' signed integer, 'u' unsigned integer, 'f' floating point, 'p' pointer or 's' string.
+ */
+struct ArgType {
+    char kind;
+    uint8_t size;
+};
+
+template<typename T>
+constexpr ArgType argType() {
+    using U = typename std::decay<T>::type;
+
+    if constexpr(std::is_same<U, const char*>::value || std::is_same<U, char*>::value || std::is_same<U, std::string>::value) {
+        return {'s', 0};
+    } else if constexpr(std::is_same<U, bool>::value) {
+        return {'u', sizeof(U)};
+    } else if constexpr(std::is_integral<U>::value) {
+        return {std::is_signed<U>::value ? 'i' : 'u', sizeof(U)};
+    } else if constexpr(std::is_enum<U>::value) {
+        return argType<typename std::underlying_type<U>::type>();
+    } else if constexpr(std::is_floating_point<U>::value) {
+        return {'f', sizeof(U)};
+    } else if constexpr(IsDuration<U>::value) {
+        return argType<typename U::rep>();
+    } else if constexpr(std::is_same<U, std::thread::id>::value) {
+        return argType<std::thread::native_handle_type>();
+    } else {
+        return {'p', sizeof(U)};
+    }
+}
+
+/**
+ * Type-erased part of a compiled format, it keeps the original format string
+ * and the types of its arguments. The format of a LOG_*_KV call also has the
+ * names of its arguments, and str() is the name of its event.
+ */
+class FormatString {
+public:
+    constexpr FormatString(const char *str, const ArgType *types, size_t arguments,
+                           const char *const *keys = nullptr) : str_(str),
+                                                                types_(types),
+                                                                arguments_(arguments),
+                                                                keys_(keys) {}
+
+    constexpr const char* str() const {
+        return str_;
+    }
+
+    constexpr const ArgType* types() const {
+        return types_;
+    }
+
+    constexpr size_t arguments() const {
+        return arguments_;
+    }
+
+    /**
+     * @brief Names of the arguments, nullptr unless the format is a KvFormat
+     */
+    constexpr const char* const* keys() const {
+        return keys_;
+    }
+
+protected:
+    const char *str_;
+    const ArgType *types_;
+    size_t arguments_;
+    const char *const *keys_;
+};
+
+/**
+ * A printf-style format parsed and checked against the argument types at compile time.
+ *
+ * Construct it as a constexpr variable, a format which does not match Args
+ * stops the compilation at one of the formatError* functions.
+ * format() only walks the parsed steps, it never looks at the format string again.
+ */
+template<size_t OPS_, typename... Args>
+class CompiledFormat final : public FormatString {
+public:
+    using Arguments = std::tuple<Args...>;
+
+    static constexpr size_t OPS = OPS_;
+    static constexpr ArgType TYPES[] = {argType<Args>()..., {'\0', 0}};
+
+    constexpr explicit CompiledFormat(const char *str) : FormatString(str, TYPES, sizeof...(Args)), ops_(), count_(0) {
+        struct Builder {
+            FormatOp *ops;
+            size_t count;
+            size_t arguments;
+
+            constexpr void literal(const char *str, size_t len) {
+                ops[count].literal = str;
+                ops[count].length = len;
+                ++count;
+            }
+
+            constexpr void argument(const FormatSpec &spec) {
+                ops[count].spec = spec;
+                ++count;
+                ++arguments;
+            }
+        } builder {ops_, 0, 0};
+
+        parseFormat(str, builder);
+        count_ = builder.count;
+
+        if(builder.arguments < sizeof...(Args)) {
+            formatErrorTooManyArguments();
+        }
+        if(builder.arguments > sizeof...(Args)) {
+            formatErrorTooFewArguments();
+        }
+
+        size_t op = 0;
+        (void)op;
+        (void)std::initializer_list<int>{(check_<Args>(op), 0)...};
+    }
+
+    /**
+     * @brief Format values into buf, values must be the Args (or their captured form)
+     * @return return the length written without null
+     */
+    template<typename... Values>
+    size_t format(char *buf, size_t size, const Values&... values) const noexcept {
+        static_assert(sizeof...(Values) == sizeof...(Args), "argument count does not match the format");
+
+        FormatWriter out(buf, size);
+        size_t op = 0;
+
+        (void)std::initializer_list<int>{(writeLiterals_(out, op), writeArg(out, ops_[op++].spec, values), 0)...};
+        writeLiterals_(out, op);
+
+        return out.finish();
+    }
+
+private:
+    template<typename T>
+    constexpr void check_(size_t &op) const {
+        while(ops_[op].literal) {
+            ++op;
+        }
+        if(!acceptsConversion<T>(ops_[op].spec.conversion)) {
+            formatErrorArgumentTypeMismatch();
+        }
+        ++op;
+    }
+
+    void writeLiterals_(FormatWriter &out, size_t &op) const noexcept {
+        while(op < count_ && ops_[op].literal) {
+            out.append(ops_[op].literal, ops_[op].length);
+            ++op;
+        }
+    }
+
+    FormatOp ops_[OPS_ == 0 ? 1 : OPS_];
+    size_t count_;
+};
+
+} //namespace util
+
+#endif //LOG_FORMAT_HPP__
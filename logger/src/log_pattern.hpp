@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_PATTERN_HPP__
+#define LOG_PATTERN_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "log_record.hpp"
+
+namespace util {
+
+/**
+ * Layout of a log line, compiled once into a sequence of steps.
+ *
+ *   %Y %m %d %H %M %S   local date and time as strftime prints them
+ *   %T                  %H:%M:%S
+ *   %D                  %Y-%m-%d
+ *   %e %u %N            milliseconds, microseconds, nanoseconds of the second
+ *   %l                  level, e.g. INFO
+ *   %t                  thread id (gettid)
+ *   %P                  process id
+ *   %v                  message
+ *   %%                  '%'
+ *
+ * Date and time with the text between them are rendered with strftime once per second,
+ * a line copies them and writes only the digits below the second.
+ * Other characters, including unknown conversions, are copied as they are.
+ *
+ * format() updates the cached second, callers serialize it, e.g. under the lock of a logger.
+ */
+class LogPattern {
+public:
+    static constexpr const char *DEFAULT = "[%l]%v";
+
+    explicit LogPattern(const std::string &pattern = DEFAULT);
+
+    /**
+     * @brief Write a line without '\n', a line longer than size is cut
+     * @param timestamp nanoseconds since epoch
+     * @return return the length written without null
+     */
+    size_t format(LogLevel level, int64_t timestamp, const char *str, size_t len, char *buf, size_t size) noexcept;
+
+    const std::string& pattern() const noexcept {
+        return pattern_;
+    }
+
+private:
+    static constexpr size_t TIME_SIZE = 256; //longest date and time text
+
+    enum class Field : uint8_t {
+        Text,       //literal text
+        Time,       //strftime format, rendered into `text` once per second
+        Millis,
+        Micros,
+        Nanos,
+        Level,
+        Thread,
+        Pid,
+        Message
+    };
+
+    struct Op {
+        Field field;
+        std::string format;     //strftime format of Time
+        std::string text;       //literal text, or Time of the cached second
+    };
+
+    void addText_(const char *str, size_t len);
+    void addTime_(const char *format);
+    void refresh_(int64_t second) noexcept;
+
+    std::string pattern_;
+    std::vector<Op> ops_;
+    int64_t second_;
+    std::string pid_;
+};
+
+} //namespace util
+
+#endif //LOG_PATTERN_HPP__
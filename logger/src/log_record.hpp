@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_RECORD_HPP__
+#define LOG_RECORD_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+
+namespace util {
+
+enum class LogLevel : uint8_t {
+    Debug = 0,
+    Verbose,
+    Info,
+    Warn,
+    Error,
+    Fatal
+};
+
+constexpr size_t LOG_LEVELS = static_cast<size_t>(LogLevel::Fatal) + 1;
+
+class FormatString;
+
+/**
+ * Static data of a LOG_* call site. Every call site owns one instance for the whole program,
+ * which is constant initialized and registered at Logger before main().
+ */
+struct LogSite {
+    enum State : uint8_t {
+        UNREGISTERED = 0,
+        DISABLED,
+        ENABLED
+    };
+
+    const char *file;
+    int line;
+    const char *function;
+    LogLevel level;
+    bool prefix; //print "[file:line][function] " before the message
+    std::atomic<uint8_t> state; //State, computed from the log level and the patterns given to Logger::enableLogSites
+};
+
+/**
+ * @brief File name without directories, evaluated at compile time for __FILE__
+ */
+constexpr const char* baseName(const char *path) noexcept {
+    const char *name = path;
+
+    for(const char *c = path; *c != '\0'; ++c) {
+        if(*c == '/') {
+            name = c + 1;
+        }
+    }
+    return name;
+}
+
+/**
+ * Level of a line as printed before the message by the file loggers
+ */
+struct LogLevelTag {
+    const char *str;
+    size_t len;
+};
+
+constexpr LogLevelTag LOG_LEVEL_TAGS[] = {
+    {"[DEBUG]", 7},
+    {"[VERBOSE]", 9},
+    {"[INFO]", 6},
+    {"[WARN]", 6},
+    {"[ERROR]", 7},
+    {"[FATAL]", 7}
+};
+
+/**
+ * A log message waiting in the asynchronous backend to be written to the sinks.
+ *
+ * A record holds either the preformatted text (formatter is nullptr) or the raw
+ * argument bytes of a LOG_* call which are formatted by `formatter` on the backend thread.
+ */
+struct LogRecord {
+    using Formatter = size_t (*)(const LogRecord &record, char *buf, size_t size);
+
+    static constexpr size_t PAYLOAD_SIZE = 1024;
+
+    LogLevel level;
+    uint32_t length; //bytes of payload in use
+    uint16_t context; //bytes at the end of the payload holding the LogContext of the caller, which precedes the message
+    uint64_t sequence; //global order of the record, records are written to the sinks in this order
+    int64_t timestamp; //nanoseconds since epoch, taken when the record was queued
+    const LogSite *site;
+    const FormatString *format;
+    Formatter formatter;
+    alignas(8) char payload[PAYLOAD_SIZE];
+};
+
+/**
+ * @brief Copy a record without the unused part of its payload
+ */
+inline void copyLogRecord(LogRecord &to, const LogRecord &from) noexcept {
+    size_t payload = from.length < LogRecord::PAYLOAD_SIZE ? from.length + 1 : LogRecord::PAYLOAD_SIZE;
+
+    std::memcpy(&to, &from, offsetof(LogRecord, payload) + payload);
+}
+
+} //namespace util
+
+#endif //LOG_RECORD_HPP__
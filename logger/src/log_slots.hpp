@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef LOG_SLOTS_HPP__
+#define LOG_SLOTS_HPP__
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "log_record.hpp"
+
+namespace util {
+
+/**
+ * Slot of a ring of fixed size slots, the storage of FlightRecorder and RecentLog.
+ *
+ * A writer claims the slots of its message with one atomic add on the head of the ring
+ * and copies the message in, a longer message continues in the following slots.
+ * Every slot carries the ticket it was written for, which tells a reader whether
+ * the slot belongs to the latest lap of the ring and whether it was overwritten while reading.
+ */
+struct LogSlot {
+    static constexpr size_t SIZE = 256;
+
+    enum Flag : uint8_t {
+        FIRST = 1,
+        LAST = 2
+    };
+
+    std::atomic<uint64_t> sequence; //ticket + 1 once written, 0 while being written
+    int64_t timestamp;
+    uint16_t length;
+    uint8_t level;
+    uint8_t flags;
+    char text[SIZE - 20];
+
+    static constexpr size_t TEXT_SIZE = sizeof(text);
+};
+
+/**
+ * @brief Number of slots of a ring which fits in `bytes`, rounded down to a power of two
+ */
+inline uint64_t logSlotCount(size_t bytes) noexcept {
+    uint64_t slots = 1;
+
+    while(slots * 2 * sizeof(LogSlot) <= bytes) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+/**
+ * @brief Write a message to the ring of `count` slots, a message longer than `maxSlots` slots or the ring is cut
+ */
+inline void writeLogSlots(LogSlot *slots, uint64_t count, std::atomic<uint64_t> &head, size_t maxSlots,
+                          LogLevel level, int64_t timestamp, const char *str, size_t len) noexcept {
+    len = std::min(len, std::min<size_t>(maxSlots, count) * LogSlot::TEXT_SIZE);
+
+    size_t parts = len == 0 ? 1 : (len + LogSlot::TEXT_SIZE - 1) / LogSlot::TEXT_SIZE;
+    uint64_t ticket = head.fetch_add(parts, std::memory_order_relaxed);
+
+    for(size_t i = 0; i < parts; ++i) {
+        LogSlot &slot = slots[(ticket + i) & (count - 1)];
+        size_t part = std::min(len - i * LogSlot::TEXT_SIZE, LogSlot::TEXT_SIZE);
+
+        //a reader which sees the old sequence after copying knows the copy is intact
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.timestamp = timestamp;
+        slot.length = part;
+        slot.level = static_cast<uint8_t>(level);
+        slot.flags = (i == 0 ? LogSlot::FIRST : 0) | (i == parts - 1 ? LogSlot::LAST : 0);
+        std::memcpy(slot.text, str + i * LogSlot::TEXT_SIZE, part);
+
+        slot.sequence.store(ticket + i + 1, std::memory_order_release);
+    }
+}
+
+/**
+ * @brief Read the messages of the ring of `count` slots, oldest first, without blocking the writers.
+ *        begin(level, timestamp) tells from the first slot of a message whether it is wanted, the slots
+ *        of a wanted message are copied to `message` of `size` bytes and end(message, len, level, timestamp)
+ *        gets it once every slot was copied intact. Messages overwritten meanwhile are skipped.
+ *        Async-signal-safe if the callbacks are.
+ */
+template<typename Begin, typename End>
+void readLogSlots(const LogSlot *slots, uint64_t count, uint64_t head, char *message, size_t size,
+                  Begin &&begin, End &&end) {
+    uint64_t ticket = head > count ? head - count : 0;
+    size_t len = 0;
+    int64_t timestamp = 0;
+    uint8_t level = 0;
+    bool started = false;
+
+    for(; ticket < head; ++ticket) {
+        const LogSlot &slot = slots[ticket & (count - 1)];
+
+        if(slot.sequence.load(std::memory_order_acquire) != ticket + 1) {
+            started = false; //not written yet, or already overwritten by the next lap
+            continue;
+        }
+
+        uint8_t flags = slot.flags;
+        size_t part = std::min<size_t>(slot.length, LogSlot::TEXT_SIZE);
+
+        if(flags & LogSlot::FIRST) {
+            timestamp = slot.timestamp;
+            level = slot.level;
+            //the level and the time are known from the first slot, the text of unwanted messages isn't copied
+            started = begin(level, timestamp);
+            len = 0;
+        }
+        if(!started || len + part > size) {
+            started = false;
+            continue;
+        }
+
+        std::memcpy(message + len, slot.text, part);
+
+        //the slot was overwritten while it was copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.sequence.load(std::memory_order_relaxed) != ticket + 1) {
+            started = false;
+            continue;
+        }
+        len += part;
+
+        if(flags & LogSlot::LAST) {
+            started = false;
+            end(message, len, level, timestamp);
+        }
+    }
+}
+
+} //namespace util
+
+#endif //LOG_SLOTS_HPP__
@@ -16,16 +16,131 @@
  */
 
 #include <cstdarg>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <mutex>
+#include <climits> //PATH_MAX
+#include <fnmatch.h>
 
 #include "logger.hpp"
 
 namespace util {
 
+namespace {
+bool matchLogSite(const std::string &pattern, const LogSite &site) noexcept {
+    char location[PATH_MAX];
+
+    snprintf(location, sizeof(location), "%s:%d", site.file, site.line);
+    return fnmatch(pattern.c_str(), location, 0) == 0 || fnmatch(pattern.c_str(), site.function, 0) == 0;
+}
+
+//format of the records of LOG_HEXDUMP, a logger which takes records sees no arguments
+constexpr FormatString HEXDUMP_FORMAT {"hexdump", nullptr, 0};
+
+size_t formatHexDump(const LogSite &site, const void *data, size_t len, size_t shown, char *buf, size_t size) noexcept {
+    size_t prefix = formatPrefix(site, buf, size);
+    size_t header = len > shown ? formatArgs(buf + prefix, size - prefix, "hexdump of %zu bytes, first %zu", len, shown)
+                                : formatArgs(buf + prefix, size - prefix, "hexdump of %zu bytes", len);
+    size_t used = prefix + header;
+
+    if(shown == 0) {
+        return used;
+    }
+    if(used + 1 < size) {
+        buf[used] = '\n';
+    }
+    return used + 1 + HexDump::write(data, shown, buf + std::min(used + 1, size - 1), size - std::min(used + 1, size - 1));
+}
+
+//format a record which holds arguments, the LogContext of the caller at the end of the payload precedes the message
+size_t formatRecord(const LogRecord &record, char *buf, size_t size) noexcept {
+    size_t context = std::min<size_t>(record.context, size - 1);
+
+    std::memcpy(buf, record.payload + record.length - record.context, context);
+    return context + record.formatter(record, buf + context, size - context);
+}
+
+//the payload is the length of the data, the number of bytes shown and the bytes
+size_t formatHexDumpRecord(const LogRecord &record, char *buf, size_t size) noexcept {
+    uint64_t len;
+    uint64_t shown;
+
+    std::memcpy(&len, record.payload, sizeof(len));
+    std::memcpy(&shown, record.payload + sizeof(len), sizeof(shown));
+    return formatHexDump(*record.site, record.payload + 2 * sizeof(uint64_t), len, shown, buf, size);
+}
+}
+
+Logger::~Logger() {
+    disableAsync();
+    sinks_.update([](SinkList &list) { list.sinks.clear(); }); //workers drain their queues
+
+    //a call site reached after a new Logger is created registers itself there
+    for(auto site : sites_) {
+        site->state.store(LogSite::UNREGISTERED, std::memory_order_relaxed);
+    }
+}
+
 void Logger::registerLogger(ILogger::Ptr logger) {
-    loggers_.push_back(logger);
+    registerLogger(logger, SinkOptions());
+}
+
+void Logger::registerLogger(ILogger::Ptr logger, const SinkOptions &options) {
+    std::shared_ptr<Sink> sink = std::make_shared<Sink>();
+    Sink *target = sink.get();
+
+    sink->logger = logger;
+    sink->recordLogger = dynamic_cast<RecordLogger*>(logger.get());
+    sink->level = options.level;
+
+    if(options.worker) {
+        //records copied from the backend thread carry system time already, so the worker never converts ticks
+        sink->worker.reset(new AsyncBackend(options.capacity,
+                                            AsyncStaging::Shared,
+                                            [this, target](const LogRecord &record) { this->write_(*target, record); },
+                                            [target] { target->logger->flush(); },
+                                            [this](LogLevel level) { this->countDrop_(level); },
+                                            LogClock::System));
+        sink->worker->setBackpressure(options.backpressure);
+    }
+    //loggers which buffer lines are flushed at exit in synchronous mode too, the Logger is never destroyed
+    drainAtExit_();
+
+    bool hasRecordLoggers = false;
+
+    sinks_.update([&](SinkList &list) {
+        list.sinks.push_back(sink);
+        for(const auto &registered : list.sinks) {
+            hasRecordLoggers = hasRecordLoggers || registered->recordLogger;
+        }
+        hasRecordLoggers_.store(hasRecordLoggers, std::memory_order_relaxed);
+    });
+}
+
+bool Logger::unregisterLogger(const ILogger::Ptr &logger) {
+    bool found = false;
+    bool hasRecordLoggers = false;
+
+    //the Sink, and its worker, goes away with the last list which holds it, after the grace period
+    sinks_.update([&](SinkList &list) {
+        auto registered = [&](const std::shared_ptr<Sink> &sink) { return sink->logger == logger; };
+        auto end = std::remove_if(list.sinks.begin(), list.sinks.end(), registered);
+
+        found = end != list.sinks.end();
+        list.sinks.erase(end, list.sinks.end());
+        for(const auto &sink : list.sinks) {
+            hasRecordLoggers = hasRecordLoggers || sink->recordLogger;
+        }
+        hasRecordLoggers_.store(hasRecordLoggers, std::memory_order_relaxed);
+    });
+
+    if(found) {
+        logger->flush();
+    }
+    return found;
 }
 
 void Logger::out(LogLevel level, const char* format, ...) noexcept {
@@ -33,16 +148,11 @@ void Logger::out(LogLevel level, const char* format, ...) noexcept {
         return;
     }
 
-    char buf[BUF_SIZE];
     va_list args;
 
     va_start(args, format);
-    vsnprintf(buf, BUF_SIZE, format, args);
+    out_(level, format, args);
     va_end(args);
-
-    for (auto& logger : loggers_) {
-        logger->out(level, buf);
-    }
 }
 
 void Logger::out(LogLevel level, const std::string &format, ...) noexcept {
@@ -50,20 +160,392 @@ void Logger::out(LogLevel level, const std::string &format, ...) noexcept {
         return;
     }
 
-    char buf[BUF_SIZE];
     va_list args;
 
     va_start(args, format);
-    vsnprintf(buf, BUF_SIZE, format.c_str(), args);
+    out_(level, format.c_str(), args);
     va_end(args);
+}
+
+void Logger::out_(LogLevel level, const char *format, va_list args) noexcept {
+    char buf[BUF_SIZE];
+    size_t len;
+    //vsnprintf tells the length it needs, so a long message is formatted twice at most
+    const char *text = lineBuffer_().format(buf, BUF_SIZE, len, [&](char *dst, size_t size) {
+        va_list copy;
+
+        va_copy(copy, args);
+        size_t context = LogContext::write(dst, size);
+        int needed = vsnprintf(dst + context, size - context, format, copy);
+        va_end(copy);
+
+        return context + (needed < 0 ? 0 : static_cast<size_t>(needed));
+    });
 
-    for (auto& logger : loggers_) {
-        logger->out(level, buf);
+    outText_(level, text, len);
+}
+
+void Logger::outText_(LogLevel level, const char *text, size_t len) noexcept {
+    AsyncBackend *backend = backend_.load(std::memory_order_acquire);
+
+    if(backend && len >= LogRecord::PAYLOAD_SIZE) {
+        //too long for a record, it is written after the records queued before it
+        backend->flush();
+    } else if(backend) {
+        bool queued = backend->push(level, [&](LogRecord &record) {
+            std::memcpy(record.payload, text, len);
+            record.payload[len] = '\0';
+
+            record.level = level;
+            record.length = len;
+            record.context = 0;
+            record.site = nullptr;
+            record.format = nullptr;
+            record.formatter = nullptr;
+        });
+
+        if(queued) {
+            return;
+        }
     }
+
+    dispatch_(level, text, len);
+}
+
+void Logger::outHexDump(const LogSite &site, const void *data, size_t len, size_t maxBytes) noexcept {
+    const uint64_t shown = std::min(len, maxBytes);
+    AsyncBackend *backend = backend_.load(std::memory_order_acquire);
+    size_t contextLen;
+    const char *context = LogContext::current(contextLen);
+
+    //the backend dumps the bytes, unless a logger takes records, which would only see their format
+    if(backend && !hasRecordLoggers_.load(std::memory_order_relaxed) &&
+       2 * sizeof(uint64_t) + shown + contextLen <= LogRecord::PAYLOAD_SIZE) {
+        bool queued = backend->push(site.level, [&](LogRecord &record) {
+            const uint64_t total = len;
+
+            std::memcpy(record.payload, &total, sizeof(total));
+            std::memcpy(record.payload + sizeof(total), &shown, sizeof(shown));
+            std::memcpy(record.payload + 2 * sizeof(uint64_t), data, shown);
+            std::memcpy(record.payload + 2 * sizeof(uint64_t) + shown, context, contextLen);
+
+            record.level = site.level;
+            record.length = 2 * sizeof(uint64_t) + shown + contextLen;
+            record.context = contextLen;
+            record.site = &site;
+            record.format = &HEXDUMP_FORMAT;
+            record.formatter = &formatHexDumpRecord;
+        });
+
+        if(queued) {
+            return;
+        }
+    }
+
+    char buf[BUF_SIZE];
+    size_t textLen;
+    const char *text = lineBuffer_().format(buf, BUF_SIZE, textLen, [&](char *dst, size_t size) {
+        size_t prefix = LogContext::write(dst, size);
+
+        return prefix + formatHexDump(site, data, len, shown, dst + prefix, size - prefix);
+    });
+
+    outText_(site.level, text, textLen);
+}
+
+void Logger::consume_(const LogRecord &record) noexcept {
+    char buf[BUF_SIZE];
+    const char *text = record.formatter ? nullptr : record.payload;
+    size_t len = record.length;
+    auto sinks = sinks_.read();
+    auto start = std::chrono::steady_clock::now();
+
+    for(auto &sink : sinks->sinks) {
+        if(record.level < sink->level) {
+            continue;
+        }
+        if(sink->worker) {
+            //the worker measures the latency of its writes
+            sink->worker->push(record.level, [&](LogRecord &copy) { copyLogRecord(copy, record); });
+            start = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        if(sink->recordLogger) {
+            sink->recordLogger->out(record);
+        } else {
+            //formatted once for all loggers which take text
+            if(!text) {
+                text = lineBuffer_().format(buf, BUF_SIZE, len, [&](char *dst, size_t size) {
+                    return formatRecord(record, dst, size);
+                });
+            }
+            sink->logger->out(record.level, record.timestamp, text, len);
+        }
+
+        //one clock read per logger, the end of a write is the start of the next one
+        auto end = std::chrono::steady_clock::now();
+        sink->latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        start = end;
+    }
+    count_(record.level, len);
+}
+
+void Logger::dispatch_(LogLevel level, const char *str, size_t len) noexcept {
+    auto sinks = sinks_.read();
+    auto start = std::chrono::steady_clock::now();
+
+    for(auto &sink : sinks->sinks) {
+        if(level < sink->level) {
+            continue;
+        }
+        if(sink->worker && len >= LogRecord::PAYLOAD_SIZE) {
+            //too long for a record, written here after the worker has caught up
+            sink->worker->flush();
+        } else if(sink->worker) {
+            sink->worker->push(level, [&](LogRecord &record) {
+                std::memcpy(record.payload, str, len);
+                record.payload[len] = '\0';
+
+                record.level = level;
+                record.length = len;
+                record.context = 0;
+                record.site = nullptr;
+                record.format = nullptr;
+                record.formatter = nullptr;
+            });
+            start = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        sink->logger->out(level, str, len);
+
+        auto end = std::chrono::steady_clock::now();
+        sink->latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        start = end;
+    }
+    count_(level, len);
+}
+
+void Logger::write_(Sink &sink, const LogRecord &record) noexcept {
+    auto start = std::chrono::steady_clock::now();
+
+    if(sink.recordLogger) {
+        sink.recordLogger->out(record);
+    } else if(record.formatter) {
+        char buf[BUF_SIZE];
+        size_t len;
+        const char *text = lineBuffer_().format(buf, BUF_SIZE, len, [&](char *dst, size_t size) {
+            return formatRecord(record, dst, size);
+        });
+
+        sink.logger->out(record.level, record.timestamp, text, len);
+    } else {
+        sink.logger->out(record.level, record.timestamp, record.payload, record.length);
+    }
+
+    sink.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+LineBuffer& Logger::lineBuffer_() noexcept {
+    static thread_local LineBuffer buffer;
+
+    return buffer;
+}
+
+void Logger::countDrop_(LogLevel level) noexcept {
+    MetricsShard::add(metrics_.local().dropped[static_cast<size_t>(level)], 1);
+}
+
+void Logger::count_(LogLevel level, size_t len) noexcept {
+    MetricsShard &shard = metrics_.local();
+
+    MetricsShard::add(shard.messages[static_cast<size_t>(level)], 1);
+    MetricsShard::add(shard.bytes[static_cast<size_t>(level)], len);
+    if(len >= LineBuffer::MAX_SIZE - 1) {
+        MetricsShard::add(shard.truncated, 1);
+    }
+}
+
+void Logger::flushLoggers_() noexcept {
+    auto sinks = sinks_.read();
+
+    //workers flush their logger at the end of each of their batches
+    for(auto &sink : sinks->sinks) {
+        if(!sink->worker) {
+            sink->logger->flush();
+        }
+    }
+}
+
+bool Logger::enableAsync(size_t capacity, AsyncStaging staging) {
+    if(backend_.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    //a late caller may still hold the backend stopped by disableAsync(), so its husk is retired instead of freed
+    if(asyncBackend_) {
+        retiredBackends_.push_back(std::move(asyncBackend_));
+    }
+    asyncBackend_.reset(new AsyncBackend(capacity,
+                                         staging,
+                                         [this](const LogRecord &record) { this->consume_(record); },
+                                         [this] { this->flushLoggers_(); },
+                                         [this](LogLevel level) { this->countDrop_(level); },
+                                         clock_));
+    asyncBackend_->setBackpressure(backpressure_, dropLevel_);
+    backend_.store(asyncBackend_.get(), std::memory_order_release);
+    drainAtExit_();
+
+    return true;
+}
+
+void Logger::drainAtExit_() {
+    static std::once_flag atExit;
+
+    std::call_once(atExit, [] {
+        std::atexit([] {
+            if(Logger::hasInstance()) {
+                Logger::getInstance().disableAsync();
+                Logger::getInstance().flush();
+            }
+        });
+    });
+}
+
+void Logger::disableAsync() {
+    if(!backend_.exchange(nullptr)) {
+        return;
+    }
+
+    //a late caller still holding the backend is turned away by push() and falls back to synchronous output
+    asyncBackend_->stop();
+}
+
+void Logger::flush() {
+    AsyncBackend *backend = backend_.load(std::memory_order_acquire);
+
+    if(backend) {
+        backend->flush();
+    } else {
+        flushLoggers_();
+    }
+
+    auto sinks = sinks_.read();
+    for(auto &sink : sinks->sinks) {
+        if(sink->worker) {
+            sink->worker->flush();
+        }
+    }
+}
+
+void Logger::setBackpressure(Backpressure policy, LogLevel level) {
+    backpressure_ = policy;
+    dropLevel_ = level;
+
+    AsyncBackend *backend = backend_.load(std::memory_order_acquire);
+    if(backend) {
+        backend->setBackpressure(policy, level);
+    }
+}
+
+void Logger::setClock(LogClock clock) {
+    clock_ = clock;
+}
+
+LogCounters Logger::counters() {
+    LogMetrics metrics;
+    LogCounters counters;
+
+    metrics_.collect(metrics);
+    for(size_t i = 0; i < LOG_LEVELS; ++i) {
+        counters.emitted[i] = metrics.messages[i];
+        counters.dropped[i] = metrics.dropped[i];
+    }
+    return counters;
+}
+
+LogMetrics Logger::metrics() {
+    LogMetrics metrics;
+    AsyncBackend *backend = backend_.load(std::memory_order_acquire);
+
+    metrics_.collect(metrics);
+    metrics.queued = backend ? backend->queued() : 0;
+
+    auto sinks = sinks_.read();
+    for(const auto &registered : sinks->sinks) {
+        SinkLatency sink {registered->logger.get(), 0, registered->latency.total(), {}};
+
+        for(size_t b = 0; b < LatencyHistogram::BUCKETS; ++b) {
+            sink.buckets[b] = registered->latency.bucket(b);
+            sink.count += sink.buckets[b];
+        }
+        metrics.sinks.push_back(sink);
+        metrics.queued += registered->worker ? registered->worker->queued() : 0;
+    }
+    return metrics;
 }
 
 void Logger::setLogLevel(LogLevel level) {
+    std::lock_guard<std::mutex> lock(sitesMutex_);
+
     defaultLevel_ = level;
+    updateLogSites_();
+}
+
+bool Logger::registerLogSite(LogSite &site) noexcept {
+    std::lock_guard<std::mutex> lock(sitesMutex_);
+
+    //a call site reached before its registration, or shared by several translation units, is registered once
+    if(site.state.load(std::memory_order_relaxed) == LogSite::UNREGISTERED) {
+        sites_.push_back(&site);
+        site.state.store(siteState_(site), std::memory_order_relaxed);
+    }
+    return site.state.load(std::memory_order_relaxed) == LogSite::ENABLED;
+}
+
+size_t Logger::enableLogSites(const std::string &pattern, bool enabled) {
+    std::lock_guard<std::mutex> lock(sitesMutex_);
+    size_t count = 0;
+
+    siteRules_.push_back({pattern, enabled});
+    for(auto site : sites_) {
+        if(matchLogSite(pattern, *site)) {
+            ++count;
+        }
+    }
+    updateLogSites_();
+
+    return count;
+}
+
+void Logger::resetLogSites() {
+    std::lock_guard<std::mutex> lock(sitesMutex_);
+
+    siteRules_.clear();
+    updateLogSites_();
+}
+
+std::vector<const LogSite*> Logger::logSites() {
+    std::lock_guard<std::mutex> lock(sitesMutex_);
+
+    return std::vector<const LogSite*>(sites_.begin(), sites_.end());
+}
+
+uint8_t Logger::siteState_(const LogSite &site) const noexcept {
+    //the last matching pattern decides, otherwise the log level
+    for(auto rule = siteRules_.rbegin(); rule != siteRules_.rend(); ++rule) {
+        if(matchLogSite(rule->pattern, site)) {
+            return rule->enabled ? LogSite::ENABLED : LogSite::DISABLED;
+        }
+    }
+    return site.level >= defaultLevel_ ? LogSite::ENABLED : LogSite::DISABLED;
+}
+
+void Logger::updateLogSites_() noexcept {
+    for(auto site : sites_) {
+        site->state.store(siteState_(*site), std::memory_order_relaxed);
+    }
 }
 
 void Logger::setLocale(int category) {
@@ -92,7 +574,8 @@ void DltLogger::out(LogLevel level, const char* str) {
 
 OutStrmLogger::OutStrmLogger() : out_(std::make_shared<std::ostream>(std::cout.rdbuf())) {}
 
-OutStrmLogger::OutStrmLogger(const std::string fileName) : fout_(std::make_shared<std::ofstream>()) {
+OutStrmLogger::OutStrmLogger(const std::string fileName, const std::string &pattern) : fout_(std::make_shared<std::ofstream>()),
+                                                                                        pattern_(pattern) {
     try {
         fout_->open(fileName);
         out_ = std::make_shared<std::ostream>(fout_->rdbuf());
@@ -111,9 +594,47 @@ OutStrmLogger::~OutStrmLogger() {
 }
 
 void OutStrmLogger::out(LogLevel level, const char* str) {
+    out(level, str, strlen(str));
+}
+
+void OutStrmLogger::out(LogLevel level, const char* str, size_t len) {
+    //written by the caller, so now is the time of the call
+    out(level, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+        str, len);
+}
+
+void OutStrmLogger::out(LogLevel level, int64_t timestamp, const char* str, size_t len) {
+    if(!out_.get()) {
+        return;
+    }
+
+    static thread_local LineBuffer lineBuffer;
+    char buf[LINE_SIZE];
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t lineLen;
+    char *line = lineBuffer.format(buf, LINE_SIZE, lineLen, [&](char *dst, size_t size) {
+        return pattern_.format(level, timestamp, str, len, dst, size);
+    });
+
+    //the newline takes the place of the null
+    line[lineLen++] = '\n';
+    out_->write(line, lineLen);
+    out_->flush();
+}
+
+void OutStrmLogger::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
     if(out_.get()) {
-        *out_ << logLevelStr_[static_cast<int>(level)] << str << std::endl;
+        out_->flush();
     }
 }
 
+void OutStrmLogger::setPattern(const std::string &pattern) {
+    LogPattern compiled(pattern);
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    pattern_ = std::move(compiled);
+}
+
 } //namespace util
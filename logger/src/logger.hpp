@@ -21,48 +21,310 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <mutex>
 #ifdef DLT_ENABLED
 #include <dlt/dlt.h>
 #endif //DLT_ENABLED
-#include <cstring> //strrchr
+#include <cstring>
+#include <cstdarg>
 
 #include "singleton.hpp"
+#include "log_record.hpp"
+#include "log_backend.hpp"
+#include "log_metrics.hpp"
+#include "rcu.hpp"
+#include "log_capture.hpp"
+#include "log_kv.hpp"
+#include "log_pattern.hpp"
+#include "log_hexdump.hpp"
+#include "log_context.hpp"
+#include "log_limiter.hpp"
 
 namespace util {
 
-enum class LogLevel : uint8_t {
-    Debug = 0,
-    Verbose,
-    Info,
-    Warn,
-    Error,
-    Fatal
-};
-
 class ILogger {
 public:
     using Ptr = std::shared_ptr<ILogger>;
     virtual ~ILogger() = default;
     virtual void out(LogLevel level, const char* str) = 0;
+
+    /**
+     * @brief Write a message of `len` bytes, which is also terminated with null.
+     *        Logger calls this one, loggers override it to skip strlen(), by default it calls out(level, str).
+     */
+    virtual void out(LogLevel level, const char* str, size_t len) {
+        out(level, str);
+    }
+
+    /**
+     * @brief Write a message logged at `timestamp`, nanoseconds since epoch. Logger calls this one for the records
+     *        of asynchronous mode and of workers, loggers which print or keep the time override it to use the time
+     *        of the call instead of the time of the write, by default it calls out(level, str, len).
+     */
+    virtual void out(LogLevel level, int64_t timestamp, const char* str, size_t len) {
+        out(level, str, len);
+    }
+
+    virtual void flush() {}
+};
+
+/**
+ * Logger which takes the records of LOG_* call sites before they are formatted,
+ * e.g. to store the raw arguments. Messages without a call site come through out(level, str).
+ */
+class RecordLogger : public ILogger {
+public:
+    using ILogger::out;
+
+    /**
+     * @brief Take a record, it is only valid during the call.
+     *        record.formatter is nullptr if the payload holds the formatted message.
+     */
+    virtual void out(const LogRecord &record) = 0;
+};
+
+/**
+ * How Logger writes to one registered logger
+ */
+struct SinkOptions {
+    LogLevel level = LogLevel::Debug;               //messages below it are not written to the logger
+    bool worker = false;                            //write on a thread of its own, so a slow logger doesn't delay the others
+    size_t capacity = 4096;                         //messages the queue of the worker can hold
+    Backpressure backpressure = Backpressure::Block; //what callers do while the queue of the worker is full
+};
+
+/**
+ * Records of each LogLevel, counted since the program started, see Logger::metrics() for more
+ */
+struct LogCounters {
+    uint64_t emitted[LOG_LEVELS];   //written to the loggers
+    uint64_t dropped[LOG_LEVELS];   //dropped by the backpressure policy of asynchronous mode
 };
 
 class Logger : public Singleton<Logger> {
 public:
     void registerLogger(ILogger::Ptr logger);
+
+    /**
+     * @brief Register a logger with a level filter, or with a queue and thread of its own.
+     *        A worker writes the messages in the order they were given to it, and Fatal messages
+     *        are written before the caller returns. flush() also waits for the workers.
+     */
+    void registerLogger(ILogger::Ptr logger, const SinkOptions &options);
+
+    /**
+     * @brief Stop writing to a logger. Messages being written by other threads may still reach it,
+     *        it is flushed and released once they are done. Don't call it from a logger.
+     * @return return false if the logger is not registered
+     */
+    bool unregisterLogger(const ILogger::Ptr &logger);
     void out(LogLevel level, const char* format, ...) noexcept;
     void out(LogLevel level, const std::string &format, ...) noexcept;
+
+    /**
+     * @brief Log from a LOG_* call site with a format checked at compile time.
+     *        In asynchronous mode only the format, the call site and the raw argument bytes
+     *        are queued, and the message is formatted on the backend thread.
+     *        The caller checks isEnabled(site) first.
+     * @param site static data of the call site
+     * @param format CompiledFormat or KvFormat of Args, it must have static storage
+     * @param args trivially copyable values or strings, strings are copied
+     */
+    template<typename Format, typename... Args>
+    typename std::enable_if<std::is_base_of<FormatString, Format>::value>::type
+    out(const LogSite &site, const Format &format, const Args&... args) noexcept;
+
+    /**
+     * @brief Log from a LOG_* call site. `format` returns the format of the call site,
+     *        a string literal is compiled and checked against Args at compile time,
+     *        a std::string is formatted at runtime.
+     */
+    template<typename F, typename... Args>
+    typename std::enable_if<std::is_invocable<F>::value>::type
+    out(const LogSite &site, F format, const Args&... args) noexcept;
+
+    /**
+     * @brief Log from a LOG_* call site whose format is built at runtime, it is formatted on the caller's thread
+     */
+    template<typename... Args>
+    void out(const LogSite &site, const std::string &format, const Args&... args) noexcept;
+
+    /**
+     * @brief Log an event with named values from a LOG_*_KV call site.
+     *        The call site gets one KvFormat, built on its first call, and the values
+     *        are captured and formatted as with out(site, format, args...).
+     * @param event returns the event name, its type is unique to the call site
+     * @param args keys, which must be string literals, alternating with values
+     */
+    template<typename F, typename... Args>
+    void outKv(const LogSite &site, F event, const Args&... args) noexcept;
+
+    /**
+     * @brief Log `len` bytes at `data` from a LOG_HEXDUMP call site as "hexdump of N bytes"
+     *        followed by a hex and ASCII line per 16 bytes, at most `maxBytes` of them.
+     *        In asynchronous mode the bytes are copied into the record and dumped by the backend thread.
+     */
+    void outHexDump(const LogSite &site, const void *data, size_t len, size_t maxBytes) noexcept;
+
+    /**
+     * @brief Check whether a LOG_* call site is enabled, with one relaxed load once the site is registered
+     */
+    static bool isEnabled(LogSite &site) noexcept {
+        uint8_t state = site.state.load(std::memory_order_relaxed);
+
+        return state == LogSite::ENABLED || (state == LogSite::UNREGISTERED && getInstance().registerLogSite(site));
+    }
+
+    /**
+     * @brief Add a call site to the registry and compute its state. LOG_* macros call it before main().
+     * @return return true if the call site is enabled
+     */
+    bool registerLogSite(LogSite &site) noexcept;
+
+    /**
+     * @brief Enable or disable the LOG_* call sites matching a pattern regardless of the log level.
+     *        The pattern is a shell wildcard (fnmatch) matched against "file:line" and against the function name,
+     *        e.g. "pcap.cc:120", "pcap.cc:*" or "dump". A later pattern overrides an earlier one.
+     * @return return the number of registered call sites matching the pattern
+     */
+    size_t enableLogSites(const std::string &pattern, bool enabled = true);
+
+    /**
+     * @brief Forget the patterns given to enableLogSites, call sites follow the log level again
+     */
+    void resetLogSites();
+
+    /**
+     * @brief Registered LOG_* call sites
+     */
+    std::vector<const LogSite*> logSites();
+
     void setLogLevel(LogLevel level);
     void setLocale(int category);
 
+    /**
+     * @brief Switch to asynchronous mode. Callers only enqueue the formatted message,
+     *        a background thread writes it to the registered loggers in batches.
+     *        Call this before other threads start logging.
+     * @param capacity number of messages which can be queued, rounded up to a power of two
+     * @param staging AsyncStaging::PerThread gives every logging thread its own queue of `capacity` messages,
+     *        which scales with the number of threads, the messages are still written in one global order
+     * @return return false if asynchronous mode is already enabled, otherwise true
+     */
+    bool enableAsync(size_t capacity = ASYNC_CAPACITY, AsyncStaging staging = AsyncStaging::Shared);
+
+    /**
+     * @brief Write out all queued messages and go back to synchronous mode.
+     *        It is also called at exit while asynchronous mode is enabled.
+     *        A caller still holding the stopped backend writes synchronously, only its rings are freed.
+     */
+    void disableAsync();
+
+    /**
+     * @brief Select what callers do while the queue of asynchronous mode is full, Backpressure::Block by default.
+     *        Fatal messages are never dropped, and they are written to the loggers before the caller returns.
+     * @param policy the backpressure policy
+     * @param level Backpressure::DropBelow drops messages below this level, Error and Fatal are always kept
+     */
+    void setBackpressure(Backpressure policy, LogLevel level = LogLevel::Error);
+
+    /**
+     * @brief Set the clock of the timestamps taken by callers of the asynchronous mode,
+     *        it applies from the next enableAsync(). With LogClock::Tsc a timestamp costs
+     *        a read of the time stamp counter, which the backend converts to system time.
+     */
+    void setClock(LogClock clock);
+
+    /**
+     * @brief Number of emitted and dropped messages of each level
+     */
+    LogCounters counters();
+
+    /**
+     * @brief Snapshot of the counters of every thread, the depth of the queue and the write latencies of each logger.
+     *        Threads count into their own shard without atomic read-modify-writes, so logging doesn't contend on them.
+     */
+    LogMetrics metrics();
+
+    /**
+     * @brief Block until every message logged before this call has been written to the loggers
+     */
+    void flush();
+
 private:
     friend class Singleton<Logger>;
-    Logger() : defaultLevel_(LogLevel::Verbose) {}
-    ~Logger() = default;
-    void out_(LogLevel level, const char *format, ...);
+    Logger() : sinks_(new SinkList),
+               defaultLevel_(LogLevel::Verbose),
+               hasRecordLoggers_(false),
+               backpressure_(Backpressure::Block),
+               dropLevel_(LogLevel::Error),
+               clock_(LogClock::System),
+               backend_(nullptr) {}
+    ~Logger();
+    void out_(LogLevel level, const char *format, va_list args) noexcept;
+    void outText_(LogLevel level, const char *text, size_t len) noexcept;
+    void consume_(const LogRecord &record) noexcept;
+    void dispatch_(LogLevel level, const char *str, size_t len) noexcept;
+    template<typename F, typename Tuple, size_t... I>
+    void outKv_(const LogSite &site, F event, const Tuple &args, std::index_sequence<I...>) noexcept;
+    void count_(LogLevel level, size_t len) noexcept;
+    void countDrop_(LogLevel level) noexcept;
+    static LineBuffer& lineBuffer_() noexcept;
+    void flushLoggers_() noexcept;
+    uint8_t siteState_(const LogSite &site) const noexcept;
+    void updateLogSites_() noexcept;
+
+    struct SiteRule {
+        std::string pattern;
+        bool enabled;
+    };
+
+    struct Sink {
+        ILogger::Ptr logger;
+        RecordLogger *recordLogger;             //nullptr if it takes formatted messages
+        LogLevel level;
+        LatencyHistogram latency;
+        std::unique_ptr<AsyncBackend> worker;   //nullptr if it is written by the caller or the backend thread
+    };
+
+    //copied on registration, so callers read the sinks without locks
+    struct SinkList {
+        std::vector<std::shared_ptr<Sink>> sinks;
+    };
 
-    std::vector<ILogger::Ptr> loggers_;
-    static constexpr uint64_t BUF_SIZE = 1024;
+    void write_(Sink &sink, const LogRecord &record) noexcept;
+    static void drainAtExit_();
+
+    RcuPointer<SinkList> sinks_;
+    static constexpr uint64_t BUF_SIZE = LogRecord::PAYLOAD_SIZE;
+    static constexpr size_t ASYNC_CAPACITY = 4096;
     LogLevel defaultLevel_;
+    std::atomic<bool> hasRecordLoggers_;
+    Backpressure backpressure_;
+    LogLevel dropLevel_;
+    LogClock clock_;
+    LogMetricsRegistry metrics_;
+    std::atomic<AsyncBackend*> backend_;
+    std::unique_ptr<AsyncBackend> asyncBackend_;
+    std::vector<std::unique_ptr<AsyncBackend>> retiredBackends_;   //stopped ones without their rings, callers don't announce when they let go
+    std::mutex sitesMutex_;
+    std::vector<LogSite*> sites_;
+    std::vector<SiteRule> siteRules_;
+};
+
+/**
+ * Registers the call site `Site` during static initialization, so every LOG_* call site
+ * is known before it is reached. Call sites compiled out by logModuleLevel are not registered.
+ */
+template<bool Enabled, LogSite *Site>
+struct LogSiteRegistration {
+    static inline const bool registered = Logger::getInstance().registerLogSite(*Site);
+};
+
+template<LogSite *Site>
+struct LogSiteRegistration<false, Site> {
+    enum : bool { registered = false };
 };
 
 #ifdef DLT_ENABLED
@@ -77,50 +339,246 @@ private:
 };
 #endif //DLT_ENABLED
 
+/**
+ * Logger which writes lines laid out by a LogPattern to stdout or a file, flushing every line
+ */
 class OutStrmLogger : public ILogger {
 public:
     OutStrmLogger();
-    OutStrmLogger(const std::string fileName);
+    OutStrmLogger(const std::string fileName, const std::string &pattern = LogPattern::DEFAULT);
     ~OutStrmLogger();
     virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+    virtual void out(LogLevel level, int64_t timestamp, const char* str, size_t len) override;
+    virtual void flush() override;
+
+    /**
+     * @brief Lay out the following lines with a pattern, e.g. "%D %T.%u [%l] [%t] %v"
+     */
+    void setPattern(const std::string &pattern);
 
 private:
+    static constexpr size_t LINE_SIZE = 2 * LogRecord::PAYLOAD_SIZE;
+
     std::shared_ptr<std::ostream> out_;
     std::shared_ptr<std::ofstream> fout_;
-    const std::vector<std::string> logLevelStr_ {"[DEBUG]", "[VERBOSE]", "[INFO]", "[WARN]", "[ERROR]", "[FATAL]"};
+    std::mutex mutex_;
+    LogPattern pattern_;
 };
 
+template<typename Format, typename... Args>
+typename std::enable_if<std::is_base_of<FormatString, Format>::value>::type
+Logger::out(const LogSite &site, const Format &format, const Args&... args) noexcept {
+    using Capture = LogCapture<typename CaptureType<Args>::type...>;
+
+    static_assert(std::is_same<typename Format::Arguments, std::tuple<typename CaptureType<Args>::type...>>::value,
+                  "format was compiled for other argument types");
+
+    AsyncBackend *backend = backend_.load(std::memory_order_acquire);
+    size_t contextLen;
+    const char *context = LogContext::current(contextLen);
+    auto fill = [&](LogRecord &record) {
+        record.level = site.level;
+        record.site = &site;
+        record.format = &format;
+        record.formatter = &Capture::template format<Format>;
+        record.length = Capture::encode(record.payload, args...);
+        record.context = 0;
+    };
+
+    //the context is copied after the arguments, loggers which take records get the message as text instead
+    if(backend && Capture::size(args...) + contextLen <= LogRecord::PAYLOAD_SIZE &&
+       (contextLen == 0 || !hasRecordLoggers_.load(std::memory_order_relaxed))) {
+        bool queued = backend->push(site.level, [&](LogRecord &record) {
+            fill(record);
+            std::memcpy(record.payload + record.length, context, contextLen);
+            record.length += contextLen;
+            record.context = contextLen;
+        });
+
+        if(queued) {
+            return;
+        }
+    }
+
+    if(contextLen == 0 && hasRecordLoggers_.load(std::memory_order_relaxed) && Capture::size(args...) <= LogRecord::PAYLOAD_SIZE) {
+        //loggers which take records get them in synchronous mode too
+        LogRecord record;
+
+        fill(record);
+        record.sequence = 0;
+        record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::system_clock::now().time_since_epoch()).count();
+        consume_(record);
+        return;
+    }
+
+    char buf[BUF_SIZE];
+    size_t len;
+    const char *line = lineBuffer_().format(buf, BUF_SIZE, len, [&](char *dst, size_t size) {
+        size_t prefix = LogContext::write(dst, size);
+
+        prefix += formatPrefix(site, dst + prefix, size - prefix);
+        return prefix + format.format(dst + prefix, size - prefix, args...);
+    });
+
+    outText_(site.level, line, len);
+}
+
+template<typename F, typename... Args>
+typename std::enable_if<std::is_invocable<F>::value>::type
+Logger::out(const LogSite &site, F format, const Args&... args) noexcept {
+    if constexpr(std::is_same<decltype(format()), const char*>::value) {
+        static constexpr const char *str = format();
+        static constexpr CompiledFormat<countFormatOps(str), typename CaptureType<Args>::type...> compiled {str};
+
+        out(site, compiled, args...);
+    } else {
+        out(site, std::string(format()), args...);
+    }
+}
+
+template<typename... Args>
+void Logger::out(const LogSite &site, const std::string &format, const Args&... args) noexcept {
+    char buf[BUF_SIZE];
+    size_t len;
+    const char *line = lineBuffer_().format(buf, BUF_SIZE, len, [&](char *dst, size_t size) {
+        size_t prefix = LogContext::write(dst, size);
+
+        prefix += formatPrefix(site, dst + prefix, size - prefix);
+        return prefix + formatArgs(dst + prefix, size - prefix, format.c_str(), printfArg(args)...);
+    });
+
+    outText_(site.level, line, len);
+}
+
+template<typename F, typename... Args>
+void Logger::outKv(const LogSite &site, F event, const Args&... args) noexcept {
+    static_assert(sizeof...(Args) % 2 == 0, "LOG_*_KV takes an event name and pairs of key and value");
+
+    outKv_(site, event, std::forward_as_tuple(args...), std::make_index_sequence<sizeof...(Args) / 2>());
+}
+
+template<typename F, typename Tuple, size_t... I>
+void Logger::outKv_(const LogSite &site, F event, const Tuple &args, std::index_sequence<I...>) noexcept {
+    using Format = KvFormat<typename CaptureType<typename std::tuple_element<2 * I + 1, Tuple>::type>::type...>;
+
+    static_assert((std::is_array<typename std::remove_reference<typename std::tuple_element<2 * I, Tuple>::type>::type>::value && ...),
+                  "keys of LOG_*_KV must be string literals");
+
+    //F is a lambda of the call site, so every call site has its own format
+    static const Format format(event(), std::get<2 * I>(args)...);
+
+    out(site, format, std::get<2 * I + 1>(args)...);
+}
+
 } //namespace util
 
-#define __FILENAME__ (std::strrchr(__FILE__, '/') ? (std::strrchr(__FILE__, '/') + 1) : __FILE__)
+#define __FILENAME__ (util::baseName(__FILE__))
+
+#ifndef LOG_MODULE_LEVEL
+#define LOG_MODULE_LEVEL util::LogLevel::Debug
+#endif //LOG_MODULE_LEVEL
+
+/**
+ * Lowest level of the LOG_* calls compiled into a module. Calls below it emit no code
+ * and don't evaluate their arguments. LOG_MODULE_LEVEL sets it for a whole target or
+ * translation unit, and a namespace overrides it with its own declaration, e.g.
+ *   namespace util { namespace { constexpr LogLevel logModuleLevel = LogLevel::Info; } }
+ */
+constexpr util::LogLevel logModuleLevel = LOG_MODULE_LEVEL;
 
 #ifdef LOG_ENABLED
 
-#define LOG_FATAL(format, args...) \
-    util::Logger::getInstance().out(util::LogLevel::Fatal, "[%s:%d][%s] " format, __FILENAME__, __LINE__, __func__, ##args)
+#define LOG_SITE_(level, prefix) \
+    static util::LogSite logSite_ {__FILENAME__, __LINE__, __func__, level, prefix, {util::LogSite::UNREGISTERED}}; \
+    static_cast<void>(util::LogSiteRegistration<(level >= logModuleLevel), &logSite_>::registered)
 
-#define LOG_ERROR(format, args...) \
-    util::Logger::getInstance().out(util::LogLevel::Error, "[%s:%d][%s] " format, __FILENAME__, __LINE__, __func__, ##args)
+#define LOG_OUT_(level, prefix, format, args...) \
+    do { \
+        if constexpr(level >= logModuleLevel) { \
+            LOG_SITE_(level, prefix); \
+            if(util::Logger::isEnabled(logSite_)) { \
+                util::Logger::getInstance().out(logSite_, [&] { return "" format; }, ##args); \
+            } \
+        } \
+    } while(0)
 
-#define LOG_WARN(format, args...) \
-    util::Logger::getInstance().out(util::LogLevel::Warn, "[%s:%d][%s] " format, __FILENAME__, __LINE__, __func__, ##args)
+#define LOG_FATAL(format, args...)    LOG_OUT_(util::LogLevel::Fatal, true, format, ##args)
+#define LOG_ERROR(format, args...)    LOG_OUT_(util::LogLevel::Error, true, format, ##args)
+#define LOG_WARN(format, args...)     LOG_OUT_(util::LogLevel::Warn, true, format, ##args)
+#define LOG_INFO(format, args...)     LOG_OUT_(util::LogLevel::Info, true, format, ##args)
+#define LOG_DEBUG(format, args...)    LOG_OUT_(util::LogLevel::Debug, true, format, ##args)
+#define LOG_VERBOSE(format, args...)  LOG_OUT_(util::LogLevel::Verbose, true, format, ##args)
 
-#define LOG_INFO(format, args...) \
-    util::Logger::getInstance().out(util::LogLevel::Info, "[%s:%d][%s] " format, __FILENAME__, __LINE__, __func__, ##args)
+//print message without file name, line, function name
+#define LOG_DEBUG_RAW(format, args...)    LOG_OUT_(util::LogLevel::Debug, false, format, ##args)
+#define LOG_VERBOSE_RAW(format, args...)  LOG_OUT_(util::LogLevel::Verbose, false, format, ##args)
+#define LOG_INFO_RAW(format, args...)     LOG_OUT_(util::LogLevel::Info, false, format, ##args)
+#define LOG_WARN_RAW(format, args...)     LOG_OUT_(util::LogLevel::Warn, false, format, ##args)
+#define LOG_ERROR_RAW(format, args...)    LOG_OUT_(util::LogLevel::Error, false, format, ##args)
+#define LOG_FATAL_RAW(format, args...)    LOG_OUT_(util::LogLevel::Fatal, false, format, ##args)
 
-#define LOG_DEBUG(format, args...) \
-    util::Logger::getInstance().out(util::LogLevel::Debug, "[%s:%d][%s] " format, __FILENAME__, __LINE__, __func__, ##args)
+//log an event with named values, e.g. LOG_INFO_KV("packet", "caplen", hdr->caplen, "len", hdr->len)
+//prints "packet caplen=60 len=60" to text loggers, StructuredLogger writes it as JSON or logfmt
+#define LOG_KV_(level, event, args...) \
+    do { \
+        if constexpr(level >= logModuleLevel) { \
+            LOG_SITE_(level, true); \
+            if(util::Logger::isEnabled(logSite_)) { \
+                util::Logger::getInstance().outKv(logSite_, [] { return "" event; }, ##args); \
+            } \
+        } \
+    } while(0)
 
-#define LOG_VERBOSE(format, args...) \
-    util::Logger::getInstance().out(util::LogLevel::Verbose, "[%s:%d][%s] " format, __FILENAME__, __LINE__, __func__, ##args)
+#define LOG_FATAL_KV(event, args...)    LOG_KV_(util::LogLevel::Fatal, event, ##args)
+#define LOG_ERROR_KV(event, args...)    LOG_KV_(util::LogLevel::Error, event, ##args)
+#define LOG_WARN_KV(event, args...)     LOG_KV_(util::LogLevel::Warn, event, ##args)
+#define LOG_INFO_KV(event, args...)     LOG_KV_(util::LogLevel::Info, event, ##args)
+#define LOG_DEBUG_KV(event, args...)    LOG_KV_(util::LogLevel::Debug, event, ##args)
+#define LOG_VERBOSE_KV(event, args...)  LOG_KV_(util::LogLevel::Verbose, event, ##args)
 
-//print message without file name, line, function name
-#define LOG_DEBUG_RAW(format, args...)    util::Logger::getInstance().out(util::LogLevel::Debug, "" format, ##args)
-#define LOG_VERBOSE_RAW(format, args...)  util::Logger::getInstance().out(util::LogLevel::Verbose, "" format, ##args)
-#define LOG_INFO_RAW(format, args...)     util::Logger::getInstance().out(util::LogLevel::Info, "" format, ##args)
-#define LOG_WARN_RAW(format, args...)     util::Logger::getInstance().out(util::LogLevel::Warn, "" format, ##args)
-#define LOG_ERROR_RAW(format, args...)    util::Logger::getInstance().out(util::LogLevel::Error, "" format, ##args)
-#define LOG_FATAL_RAW(format, args...)    util::Logger::getInstance().out(util::LogLevel::Fatal, "" format, ##args)
+//print `len` bytes at `data` as hex and ASCII, at most `maxBytes` of them, e.g. LOG_HEXDUMP(Debug, payload, caplen, 64)
+#define LOG_HEXDUMP(level, data, len, maxBytes) \
+    do { \
+        if constexpr(util::LogLevel::level >= logModuleLevel) { \
+            LOG_SITE_(util::LogLevel::level, true); \
+            if(util::Logger::isEnabled(logSite_)) { \
+                util::Logger::getInstance().outHexDump(logSite_, data, len, maxBytes); \
+            } \
+        } \
+    } while(0)
+
+//"suppressed N messages" is printed when the limiter reports suppressed calls, before the message of an allowed call.
+//The summary is lazy, nothing runs between the calls of a site, so the calls suppressed at the end of a storm are
+//only reported by the next call of the site
+#define LOG_LIMITED_(level, limiter, allow, format, args...) \
+    do { \
+        if constexpr(level >= logModuleLevel) { \
+            LOG_SITE_(level, true); \
+            static util::limiter logLimiter_; \
+            uint64_t logSuppressed_ = 0; \
+            if(util::Logger::isEnabled(logSite_)) { \
+                bool logAllowed_ = logLimiter_.allow; \
+                if(logSuppressed_ > 0) { \
+                    util::Logger::getInstance().out(logSite_, [] { return "suppressed %lu message%s"; }, logSuppressed_, \
+                                                    logSuppressed_ == 1 ? "" : "s"); \
+                } \
+                if(logAllowed_) { \
+                    util::Logger::getInstance().out(logSite_, [&] { return "" format; }, ##args); \
+                } \
+            } \
+        } \
+    } while(0)
+
+//print message of a call site at most every n-th time, e.g. LOG_EVERY_N(Warn, 100, "queue is full")
+#define LOG_EVERY_N(level, n, format, args...)                LOG_LIMITED_(util::LogLevel::level, LogEveryN, allow(n, logSuppressed_), format, ##args)
+//print message of a call site only the first n times
+#define LOG_FIRST_N(level, n, format, args...)                LOG_LIMITED_(util::LogLevel::level, LogFirstN, allow(n, logSuppressed_), format, ##args)
+//print message of a call site at most once per period, e.g. LOG_EVERY_T(Warn, std::chrono::seconds(1), "queue is full")
+#define LOG_EVERY_T(level, period, format, args...)           LOG_LIMITED_(util::LogLevel::level, LogEveryT, allow(period, logSuppressed_), format, ##args)
+//print message of a call site at most `rate` times per second on average, `burst` times at once
+#define LOG_RATE_LIMITED(level, rate, burst, format, args...) LOG_LIMITED_(util::LogLevel::level, LogTokenBucket, allow(rate, burst, logSuppressed_), format, ##args)
 
 #else //LOG_ENABLED
 
@@ -139,6 +597,20 @@ private:
 #define LOG_ERROR_RAW(format, args...)
 #define LOG_FATAL_RAW(format, args...)
 
+#define LOG_FATAL_KV(event, args...)
+#define LOG_ERROR_KV(event, args...)
+#define LOG_WARN_KV(event, args...)
+#define LOG_INFO_KV(event, args...)
+#define LOG_DEBUG_KV(event, args...)
+#define LOG_VERBOSE_KV(event, args...)
+
+#define LOG_HEXDUMP(level, data, len, maxBytes)
+
+#define LOG_EVERY_N(level, n, format, args...)
+#define LOG_FIRST_N(level, n, format, args...)
+#define LOG_EVERY_T(level, period, format, args...)
+#define LOG_RATE_LIMITED(level, rate, burst, format, args...)
+
 #endif //LOG_ENABLED
 
 #endif  //LOGGER_HPP_
\ No newline at end of file
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mmap_logger.hpp"
+
+namespace util {
+
+namespace {
+size_t roundUp(size_t size, size_t unit) noexcept {
+    return (size + unit - 1) / unit * unit;
+}
+
+//a previous run which didn't shut down cleanly left zeros up to the end of its window
+size_t dataLength(int fd) noexcept {
+    struct stat st;
+    char buf[64 * 1024];
+
+    if(fstat(fd, &st) != 0) {
+        return 0;
+    }
+
+    size_t length = st.st_size;
+    while(length > 0) {
+        size_t chunk = std::min(length, sizeof(buf));
+
+        if(pread(fd, buf, chunk, length - chunk) != static_cast<ssize_t>(chunk)) {
+            break;
+        }
+
+        size_t used = chunk;
+        while(used > 0 && buf[used - 1] == '\0') {
+            --used;
+        }
+        if(used > 0) {
+            return length - chunk + used;
+        }
+        length -= chunk;
+    }
+    return length;
+}
+}
+
+MmapLogger::MmapLogger(const std::string &fileName, size_t windowSize) : fd_(-1),
+                                                                         windowSize_(roundUp(std::max<size_t>(windowSize, 1), 2 * sysconf(_SC_PAGESIZE))),
+                                                                         current_(nullptr),
+                                                                         remaps_(0),
+                                                                         spare_(nullptr),
+                                                                         length_(0),
+                                                                         failed_(false),
+                                                                         running_(true) {
+    fd_ = open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd_ < 0) {
+        std::cerr << "Fail to open " << fileName << " : " << strerror(errno) << std::endl;
+        return;
+    }
+
+    size_t length = dataLength(fd_);
+    size_t offset = length / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+    Window *window = map_(offset, 0);
+
+    if(window == nullptr) {
+        std::cerr << "Fail to map " << fileName << " : " << strerror(errno) << std::endl;
+        close(fd_);
+        fd_ = -1;
+        return;
+    }
+    window->tail.store(length - offset, std::memory_order_relaxed);
+    window->committed.store(length - offset, std::memory_order_relaxed);
+    windows_.emplace_back(window);
+    current_.store(window, std::memory_order_release);
+
+    thread_ = std::thread(&MmapLogger::run_, this);
+}
+
+MmapLogger::~MmapLogger() {
+    if(fd_ < 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        work_.notify_one();
+    }
+    thread_.join();
+
+    Window *window = current_.load(std::memory_order_acquire);
+    size_t length = length_;
+
+    if(window) {
+        length = window->offset + std::min(window->tail.load(std::memory_order_acquire), windowSize_);
+    }
+    for(auto &mapped : windows_) {
+        if(mapped->map) {
+            munmap(mapped->map, windowSize_);
+        }
+    }
+
+    //cut the zeros after the last line
+    if(ftruncate(fd_, length) != 0) {
+        std::cerr << "Fail to truncate log file : " << strerror(errno) << std::endl;
+    }
+    close(fd_);
+}
+
+void MmapLogger::out(LogLevel level, const char* str) {
+    out(level, str, strlen(str));
+}
+
+void MmapLogger::out(LogLevel level, const char* str, size_t len) {
+    const LogLevelTag &tag = LOG_LEVEL_TAGS[static_cast<int>(level)];
+
+    //a line takes half a window at most
+    len = std::min(len, windowSize_ / 2 - tag.len - 1);
+    size_t lineLen = tag.len + len + 1;
+
+    for(;;) {
+        Window *window = current_.load(std::memory_order_acquire);
+
+        if(window == nullptr) {
+            return;
+        }
+
+        size_t offset = window->tail.fetch_add(lineLen, std::memory_order_relaxed);
+
+        if(offset + lineLen <= windowSize_) {
+            char *dst = window->map + offset;
+
+            std::memcpy(dst, tag.str, tag.len);
+            std::memcpy(dst + tag.len, str, len);
+            dst[lineLen - 1] = '\n';
+            window->committed.fetch_add(lineLen, std::memory_order_release);
+            return;
+        }
+
+        if(offset <= windowSize_) {
+            //the line crosses the end of the window, this caller moves everyone to the next window
+            switch_(window, offset);
+        } else {
+            while(current_.load(std::memory_order_acquire) == window) {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+MmapLogger::Window* MmapLogger::map_(size_t offset, size_t populate) noexcept {
+    //the file grows sparse, the part beyond the last line is cut on destruction
+    struct stat st;
+
+    if(fstat(fd_, &st) != 0) {
+        return nullptr;
+    }
+    if(static_cast<size_t>(st.st_size) < offset + windowSize_ && ftruncate(fd_, offset + windowSize_) != 0) {
+        return nullptr;
+    }
+
+    void *map = mmap(nullptr, windowSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+
+    if(map == MAP_FAILED) {
+        return nullptr;
+    }
+
+#ifdef MADV_POPULATE_WRITE
+    //take the page faults here instead of in the callers, the content is not changed
+    madvise(static_cast<char*>(map) + populate, windowSize_ - populate, MADV_POPULATE_WRITE);
+#endif
+
+    Window *window = new Window;
+
+    window->map = static_cast<char*>(map);
+    window->offset = offset;
+    window->tail.store(0, std::memory_order_relaxed);
+    window->committed.store(0, std::memory_order_relaxed);
+    window->end = 0;
+    return window;
+}
+
+void MmapLogger::unmap_(Window *window) noexcept {
+    //callers which reserved space before the window was full may still be copying
+    while(window->committed.load(std::memory_order_acquire) != window->end) {
+        std::this_thread::yield();
+    }
+
+    munmap(window->map, windowSize_);
+    window->map = nullptr;
+}
+
+void MmapLogger::switch_(Window *window, size_t end) noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    ready_.wait(lock, [this] { return spare_ != nullptr || failed_; });
+
+    window->end = end;
+    full_.push_back(window);
+    work_.notify_one();
+
+    if(spare_ == nullptr) {
+        length_ = window->offset + end;
+        current_.store(nullptr, std::memory_order_release);
+        return;
+    }
+
+    //the next window overlaps this one by half, it continues right after the last line
+    Window *next = spare_;
+    size_t tail = window->offset + end - next->offset;
+
+    next->tail.store(tail, std::memory_order_relaxed);
+    next->committed.store(tail, std::memory_order_relaxed);
+    spare_ = nullptr;
+    remaps_.fetch_add(1, std::memory_order_relaxed);
+    current_.store(next, std::memory_order_release);
+}
+
+void MmapLogger::run_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for(;;) {
+        Window *window = current_.load(std::memory_order_relaxed);
+
+        if(running_ && window && !spare_ && !failed_) {
+            lock.unlock();
+            Window *next = map_(window->offset + windowSize_ / 2, windowSize_ / 2);
+            lock.lock();
+
+            if(next) {
+                windows_.emplace_back(next);
+                spare_ = next;
+            } else {
+                std::cerr << "Fail to map log file : " << strerror(errno) << std::endl;
+                failed_ = true;
+            }
+            ready_.notify_all();
+            continue;
+        }
+
+        if(!full_.empty()) {
+            Window *full = full_.front();
+
+            full_.pop_front();
+            lock.unlock();
+            unmap_(full);
+            lock.lock();
+            continue;
+        }
+
+        if(!running_) {
+            break;
+        }
+        work_.wait(lock);
+    }
+}
+
+} //namespace util
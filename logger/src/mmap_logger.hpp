@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef MMAP_LOGGER_HPP__
+#define MMAP_LOGGER_HPP__
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "logger.hpp"
+
+namespace util {
+
+/**
+ * Logger which appends lines to a file through a shared memory mapping.
+ *
+ * A caller reserves space for its line by advancing the tail of the mapped window
+ * with one atomic add and copies the line in, there is no lock and no system call.
+ * The line is in the page cache when out() returns, so it survives a crash of the process.
+ *
+ * A background thread maps the next window in advance and unmaps full windows.
+ * Consecutive windows overlap by half a window, so a window can start where the
+ * previous one ended without knowing the end in advance. Lines are cut to half a window.
+ * On destruction the file is truncated to the length of the lines.
+ */
+class MmapLogger : public ILogger {
+public:
+    static constexpr size_t WINDOW_SIZE = 64 * 1024 * 1024;
+
+    /**
+     * @brief Append to a file, which is created if it doesn't exist
+     * @param windowSize bytes mapped at once, rounded up to two pages
+     */
+    explicit MmapLogger(const std::string &fileName, size_t windowSize = WINDOW_SIZE);
+    virtual ~MmapLogger();
+
+    MmapLogger(const MmapLogger&) = delete;
+    MmapLogger& operator = (const MmapLogger&) = delete;
+
+    virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+
+    bool isOpen() const noexcept {
+        return fd_ >= 0;
+    }
+
+    /**
+     * @brief Number of times callers moved to the next window
+     */
+    size_t remaps() const noexcept {
+        return remaps_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Window {
+        char *map;
+        size_t offset;                      //file offset of the mapping
+        std::atomic<size_t> tail;           //bytes reserved by callers, runs past the window when it is full
+        std::atomic<size_t> committed;      //bytes copied by callers
+        size_t end;                         //bytes in use once the window is full
+    };
+
+    Window* map_(size_t offset, size_t populate) noexcept;
+    void unmap_(Window *window) noexcept;
+    void switch_(Window *window, size_t end) noexcept;
+    void run_();
+
+    int fd_;
+    const size_t windowSize_;
+    std::atomic<Window*> current_;          //nullptr once a window failed to map
+    std::atomic<size_t> remaps_;
+
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable ready_;
+    std::deque<std::unique_ptr<Window>> windows_;  //kept until destruction, a late caller may still read its tail
+    std::deque<Window*> full_;              //full windows waiting to be unmapped
+    Window *spare_;                         //next window, once it is mapped
+    size_t length_;                         //length of the file after a window failed to map
+    bool failed_;
+    bool running_;
+    std::thread thread_;
+};
+
+} //namespace util
+
+#endif //MMAP_LOGGER_HPP__
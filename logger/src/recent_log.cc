@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <chrono>
+#include <regex>
+#include <algorithm>
+
+#include "recent_log.hpp"
+
+namespace util {
+
+RecentLog::RecentLog(size_t bytes) : mask_(0), head_(0) {
+    uint64_t slots = logSlotCount(bytes);
+
+    slots_.reset(new LogSlot[slots]());
+    mask_ = slots - 1;
+}
+
+void RecentLog::out(LogLevel level, const char* str) {
+    out(level, str, strnlen(str, MAX_SLOTS * LogSlot::TEXT_SIZE));
+}
+
+void RecentLog::out(LogLevel level, const char* str, size_t len) {
+    out(level, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+        str, len);
+}
+
+void RecentLog::out(LogLevel level, int64_t timestamp, const char* str, size_t len) {
+    writeLogSlots(slots_.get(), mask_ + 1, head_, MAX_SLOTS, level, timestamp, str, len);
+}
+
+std::vector<RecentLogEntry> RecentLog::query(const RecentLogQuery &query) const {
+    std::unique_ptr<std::regex> regex;
+
+    if(!query.regex.empty()) {
+        regex.reset(new std::regex(query.regex, std::regex::ECMAScript | std::regex::optimize));
+    }
+
+    std::vector<RecentLogEntry> entries;
+    char message[MAX_SLOTS * LogSlot::TEXT_SIZE];
+
+    auto wanted = [&](uint8_t level, int64_t timestamp) {
+        return static_cast<LogLevel>(level) >= query.level && timestamp >= query.from && timestamp < query.to;
+    };
+    auto found = [&](const char *text, size_t len, uint8_t level, int64_t timestamp) {
+        if(!findText(text, len, query.text.data(), query.text.size())) {
+            return;
+        }
+        if(regex && !std::regex_search(text, text + len, *regex)) {
+            return;
+        }
+        entries.push_back(RecentLogEntry {static_cast<LogLevel>(level), timestamp, std::string(text, len)});
+    };
+    readLogSlots(slots_.get(), mask_ + 1, head_.load(std::memory_order_acquire), message, sizeof(message), wanted, found);
+
+    if(query.limit > 0 && entries.size() > query.limit) {
+        entries.erase(entries.begin(), entries.end() - query.limit);
+    }
+    return entries;
+}
+
+} //namespace util
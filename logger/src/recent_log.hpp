@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef RECENT_LOG_HPP__
+#define RECENT_LOG_HPP__
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <climits>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif //__SSE2__
+
+#include "logger.hpp"
+#include "log_slots.hpp"
+
+namespace util {
+
+/**
+ * @brief Find `pattern` in `text`. With SSE2 it compares the first and the last byte of
+ *        the pattern against 16 positions at once, and only the candidates are compared in full.
+ * @return return the first occurrence, or nullptr if there is none
+ */
+inline const char* findText(const char *text, size_t len, const char *pattern, size_t patternLen) noexcept {
+    if(patternLen == 0) {
+        return text;
+    }
+    if(patternLen > len) {
+        return nullptr;
+    }
+
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[patternLen - 1]);
+
+    for(; i + patternLen - 1 + 16 <= len; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + patternLen - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+                                                        _mm_cmpeq_epi8(last, blockLast)));
+
+        for(; mask != 0; mask &= mask - 1) {
+            const char *candidate = text + i + __builtin_ctz(mask);
+
+            if(std::memcmp(candidate, pattern, patternLen) == 0) {
+                return candidate;
+            }
+        }
+    }
+#endif //__SSE2__
+
+    //the positions left over, or all of them without SSE2
+    for(; i + patternLen <= len; ++i) {
+        const char *candidate = static_cast<const char*>(std::memchr(text + i, pattern[0], len - patternLen + 1 - i));
+
+        if(!candidate) {
+            return nullptr;
+        }
+        if(std::memcmp(candidate, pattern, patternLen) == 0) {
+            return candidate;
+        }
+        i = candidate - text;
+    }
+    return nullptr;
+}
+
+/**
+ * Filter of RecentLog::query(), a message is returned if it meets every condition
+ */
+struct RecentLogQuery {
+    LogLevel level = LogLevel::Debug;   //lowest level
+    int64_t from = INT64_MIN;           //nanoseconds since epoch, inclusive
+    int64_t to = INT64_MAX;             //nanoseconds since epoch, exclusive
+    std::string text;                   //substring of the message
+    std::string regex;                  //ECMAScript regular expression searched in the message
+    size_t limit = 0;                   //only the newest `limit` messages, 0 for all
+};
+
+struct RecentLogEntry {
+    LogLevel level;
+    int64_t timestamp;                  //nanoseconds since epoch
+    std::string text;
+};
+
+/**
+ * Logger which keeps the latest messages in memory, so a debug hook can ask what just happened
+ * without waiting for the files of other loggers.
+ *
+ * The messages are kept in a ring of LogSlot, like in FlightRecorder, so query() never blocks the callers.
+ */
+class RecentLog : public ILogger {
+public:
+    static constexpr size_t SIZE = 1024 * 1024;
+
+    /**
+     * @param bytes size of the ring, rounded down to a power of two number of slots
+     */
+    explicit RecentLog(size_t bytes = SIZE);
+
+    RecentLog(const RecentLog&) = delete;
+    RecentLog& operator = (const RecentLog&) = delete;
+
+    virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+    virtual void out(LogLevel level, int64_t timestamp, const char* str, size_t len) override;
+
+    /**
+     * @brief Messages of the ring which match `query`, oldest first.
+     *        An invalid query.regex throws std::regex_error.
+     */
+    std::vector<RecentLogEntry> query(const RecentLogQuery &query) const;
+
+    /**
+     * @brief Number of bytes of messages the ring can hold
+     */
+    size_t capacity() const noexcept {
+        return (mask_ + 1) * LogSlot::TEXT_SIZE;
+    }
+
+private:
+    static constexpr size_t MAX_SLOTS = 32; //of one message, longer messages are cut
+
+    std::unique_ptr<LogSlot[]> slots_;
+    uint64_t mask_;
+    alignas(64) std::atomic<uint64_t> head_; //next ticket
+};
+
+} //namespace util
+
+#endif //RECENT_LOG_HPP__
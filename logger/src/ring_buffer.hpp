@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RING_BUFFER_HPP__
+#define RING_BUFFER_HPP__
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace util {
+
+/**
+ * Bounded lock-free queue with a power-of-two number of slots.
+ *
+ * Every slot carries a sequence number which tells producers and consumers
+ * whether the slot is free or published, so push() and pop() only contend on
+ * their own position counter. Items are constructed in place by the callback
+ * given to push(), which avoids copying large records twice. A callback which
+ * returns a value stores it as the key of the item, which front() reads atomically.
+ */
+template<typename T>
+class RingBuffer final {
+public:
+    explicit RingBuffer(size_t capacity) : mask_(roundUp_(capacity) - 1),
+                                           cells_(new Cell[mask_ + 1]) {
+        for(size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos_.store(0, std::memory_order_relaxed);
+        dequeuePos_.store(0, std::memory_order_relaxed);
+    }
+
+    ~RingBuffer() = default;
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator = (const RingBuffer&) = delete;
+
+    /**
+     * @brief Claim a free slot and let `fill` write the item into it.
+     * @param fill callable invoked as fill(T&) or fill(T&, size_t ticket) on the claimed slot,
+     *        the ticket is the position of the slot in the order of pop(), what it returns is the key of the item
+     * @return return false if the ring is full, otherwise true
+     */
+    template<typename F>
+    bool push(F&& fill) noexcept {
+        Cell *cell;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+
+        for(;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if(diff == 0) {
+                if(enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if(diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        if constexpr(std::is_void<decltype(fill_(fill, cell->data, pos))>::value) {
+            fill_(fill, cell->data, pos);
+        } else {
+            cell->key.store(static_cast<uint64_t>(fill_(fill, cell->data, pos)), std::memory_order_relaxed);
+        }
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest published item and hand it to `consume`.
+     * @param consume callable invoked as consume(T&) before the slot is released
+     * @return return false if there is no published item, otherwise true
+     */
+    template<typename F>
+    bool pop(F&& consume) noexcept {
+        Cell *cell;
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+
+        for(;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+            if(diff == 0) {
+                if(dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if(diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        consume(cell->data);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief Peek at the key of the oldest published item and its position without taking it.
+     *        The item itself is not read, another consumer may pop it and a producer refill the slot meanwhile.
+     *        Then the key may belong to the next item of the slot, and pop(position, ...) fails.
+     * @param position set to the position to give to pop(position, ...)
+     * @param key set to the value returned by the fill callback of the item
+     * @return return false if there is no published item
+     */
+    bool front(size_t &position, uint64_t &key) const noexcept {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        const Cell &cell = cells_[pos & mask_];
+
+        if(cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        position = pos;
+        key = cell.key.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Take the item peeked by front(position), unless another consumer has taken it first.
+     * @param position position given by front()
+     * @param consume callable invoked as consume(T&) before the slot is released
+     * @return return false if the item has been taken by another consumer, otherwise true
+     */
+    template<typename F>
+    bool pop(size_t position, F&& consume) noexcept {
+        size_t pos = position;
+
+        if(!dequeuePos_.compare_exchange_strong(pos, position + 1, std::memory_order_relaxed)) {
+            return false;
+        }
+
+        Cell &cell = cells_[position & mask_];
+        consume(cell.data);
+        cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief Number of slots claimed by producers so far
+     */
+    size_t enqueued() const noexcept {
+        return enqueuePos_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Number of slots released by consumers so far
+     */
+    size_t dequeued() const noexcept {
+        return dequeuePos_.load(std::memory_order_acquire);
+    }
+
+    size_t size() const noexcept {
+        size_t head = dequeued();
+        size_t tail = enqueued();
+
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    size_t capacity() const noexcept {
+        return mask_ + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        std::atomic<uint64_t> key;
+        T data;
+    };
+
+    template<typename F>
+    static auto fill_(F &fill, T &data, size_t pos) noexcept {
+        if constexpr(std::is_invocable<F, T&, size_t>::value) {
+            return fill(data, pos);
+        } else {
+            return fill(data);
+        }
+    }
+
+    static size_t roundUp_(size_t capacity) noexcept {
+        size_t size = 2;
+        while(size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    static constexpr size_t CACHE_LINE = 64;
+
+    const size_t mask_;
+    const std::unique_ptr<Cell[]> cells_;
+    alignas(CACHE_LINE) std::atomic<size_t> enqueuePos_;
+    alignas(CACHE_LINE) std::atomic<size_t> dequeuePos_;
+};
+
+} //namespace util
+
+#endif //RING_BUFFER_HPP__
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "rotating_logger.hpp"
+
+namespace util {
+
+RotatingFileLogger::RotatingFileLogger(const std::string &fileName,
+                                       const RotationPolicy &rotation,
+                                       const FlushPolicy &flush) : fileName_(fileName),
+                                                                   nextName_(fileName + ".next"),
+                                                                   rotation_(rotation),
+                                                                   flush_(flush),
+                                                                   base_(0),
+                                                                   next_(1),
+                                                                   rotations_(0),
+                                                                   busy_(false),
+                                                                   running_(true) {
+    //continue the numbering of the segments of a previous run
+    glob_t found;
+    std::string pattern = fileName_ + ".*";
+
+    if(glob(pattern.c_str(), 0, nullptr, &found) == 0) {
+        for(size_t i = 0; i < found.gl_pathc; ++i) {
+            const char *suffix = found.gl_pathv[i] + fileName_.size() + 1;
+            char *end = nullptr;
+            size_t index = strtoul(suffix, &end, 10);
+
+            if(end == suffix || index == 0) {
+                continue;
+            }
+            if(*end == '\0' && rotation_.compress) {
+                pending_.push_back({index, nullptr}); //the previous run stopped before compressing it
+            } else if(*end == '\0' || std::string(end) == ".gz") {
+                segments_.push_back(index);
+            } else {
+                continue;
+            }
+            next_ = std::max(next_, index + 1);
+        }
+        std::sort(pending_.begin(), pending_.end(), [](const Rotated &a, const Rotated &b) { return a.index < b.index; });
+        std::sort(segments_.begin(), segments_.end());
+    }
+    globfree(&found);
+
+    //the previous run stopped between switching to the next file and renaming it, the next file has the newest lines
+    struct stat st;
+
+    if(stat(nextName_.c_str(), &st) == 0) {
+        if(st.st_size > 0) {
+            if(rename(fileName_.c_str(), segmentName_(next_, false).c_str()) == 0) {
+                pending_.push_back({next_++, nullptr});
+            }
+            rename(nextName_.c_str(), fileName_.c_str());
+        } else {
+            unlink(nextName_.c_str());
+        }
+    }
+
+    file_.reset(new FdLogger(fileName_, flush_));
+    base_ = stat(fileName_.c_str(), &st) == 0 ? st.st_size : 0;
+    opened_ = Clock::now();
+    prepare_();
+
+    thread_ = std::thread(&RotatingFileLogger::run_, this);
+}
+
+RotatingFileLogger::~RotatingFileLogger() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_.reset();
+    }
+    {
+        std::lock_guard<std::mutex> lock(workMutex_);
+        running_ = false;
+        work_.notify_one();
+    }
+    thread_.join();
+
+    spare_.reset();
+    unlink(nextName_.c_str());
+}
+
+void RotatingFileLogger::out(LogLevel level, const char* str) {
+    out(level, str, strlen(str));
+}
+
+void RotatingFileLogger::out(LogLevel level, const char* str, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if(!file_ || !file_->isOpen()) {
+        return;
+    }
+
+    file_->out(level, str, len);
+
+    if(spare_ &&
+       (base_ + file_->bytes() >= rotation_.maxBytes ||
+        (rotation_.maxAge.count() > 0 && Clock::now() - opened_ >= rotation_.maxAge))) {
+        rotate_();
+    }
+}
+
+void RotatingFileLogger::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if(file_) {
+        file_->flush();
+    }
+}
+
+void RotatingFileLogger::rotate() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    ready_.wait(lock, [this] { return spare_ != nullptr; });
+    rotate_();
+}
+
+void RotatingFileLogger::wait() {
+    std::unique_lock<std::mutex> lock(workMutex_);
+
+    done_.wait(lock, [this] { return pending_.empty() && !busy_; });
+}
+
+void RotatingFileLogger::rotate_() {
+    Rotated rotated {next_++, std::move(file_)};
+
+    file_ = std::move(spare_);
+    base_ = 0;
+    opened_ = Clock::now();
+    rotations_.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(workMutex_);
+    pending_.push_back(std::move(rotated));
+    work_.notify_one();
+}
+
+void RotatingFileLogger::prepare_() {
+    std::unique_ptr<FdLogger> spare(new FdLogger(nextName_, flush_));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    spare_ = std::move(spare);
+    ready_.notify_all();
+}
+
+void RotatingFileLogger::run_() {
+    std::unique_lock<std::mutex> lock(workMutex_);
+
+    for(;;) {
+        work_.wait(lock, [this] { return !pending_.empty() || !running_; });
+
+        if(pending_.empty()) {
+            break;
+        }
+
+        Rotated rotated = std::move(pending_.front());
+        pending_.pop_front();
+        busy_ = true;
+
+        lock.unlock();
+        if(rotated.file) {
+            //no rotation happens until the next file is prepared again, so <fileName> is the full file here
+            rename(fileName_.c_str(), segmentName_(rotated.index, false).c_str());
+            rename(nextName_.c_str(), fileName_.c_str());
+            prepare_();
+            rotated.file.reset();
+        }
+        if(rotation_.compress) {
+            compress_(segmentName_(rotated.index, false));
+        }
+        lock.lock();
+
+        segments_.insert(std::upper_bound(segments_.begin(), segments_.end(), rotated.index), rotated.index);
+        prune_();
+        busy_ = false;
+        done_.notify_all();
+    }
+}
+
+void RotatingFileLogger::compress_(const std::string &segment) noexcept {
+    std::string compressed = segment + ".gz";
+    std::string temp = compressed + ".tmp";
+    FILE *in = fopen(segment.c_str(), "rb");
+
+    if(in == nullptr) {
+        return;
+    }
+
+    gzFile out = gzopen(temp.c_str(), "wb");
+    if(out == nullptr) {
+        fclose(in);
+        return;
+    }
+
+    char buf[64 * 1024];
+    size_t len;
+    bool failed = false;
+
+    while((len = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if(gzwrite(out, buf, len) != static_cast<int>(len)) {
+            failed = true;
+            break;
+        }
+    }
+    fclose(in);
+
+    //keep the plain segment unless the compressed one is complete
+    if(gzclose(out) != Z_OK || failed || rename(temp.c_str(), compressed.c_str()) != 0) {
+        unlink(temp.c_str());
+        return;
+    }
+    unlink(segment.c_str());
+}
+
+void RotatingFileLogger::prune_() noexcept {
+    while(segments_.size() > rotation_.maxSegments) {
+        size_t index = segments_.front();
+
+        unlink(segmentName_(index, false).c_str());
+        unlink(segmentName_(index, true).c_str());
+        segments_.pop_front();
+    }
+}
+
+std::string RotatingFileLogger::segmentName_(size_t index, bool compressed) const {
+    return fileName_ + "." + std::to_string(index) + (compressed ? ".gz" : "");
+}
+
+} //namespace util
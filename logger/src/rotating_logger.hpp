@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef ROTATING_LOGGER_HPP__
+#define ROTATING_LOGGER_HPP__
+
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "fd_logger.hpp"
+
+namespace util {
+
+/**
+ * When a file logger starts a new segment, and how many segments are kept
+ */
+struct RotationPolicy {
+    size_t maxBytes = 64 * 1024 * 1024;     //rotate when the file reaches this size
+    std::chrono::seconds maxAge {0};        //rotate when the file is this old, 0 disables it
+    size_t maxSegments = 10;                //rotated segments to keep, the oldest are removed
+    bool compress = true;                   //gzip rotated segments
+};
+
+/**
+ * Logger which writes to a file and rotates it by size and age.
+ *
+ * A background thread keeps the next file "<fileName>.next" open in advance, so a rotation
+ * only switches the logger a caller writes to. The background thread then renames the
+ * full file to "<fileName>.<n>" (higher n is newer) and the next file to <fileName>,
+ * writes the lines still buffered for the full file, compresses it to "<fileName>.<n>.gz"
+ * and removes old segments. If the next file isn't ready yet, rotation is postponed.
+ */
+class RotatingFileLogger : public ILogger {
+public:
+    RotatingFileLogger(const std::string &fileName,
+                       const RotationPolicy &rotation = RotationPolicy(),
+                       const FlushPolicy &flush = FlushPolicy());
+    virtual ~RotatingFileLogger();
+
+    RotatingFileLogger(const RotatingFileLogger&) = delete;
+    RotatingFileLogger& operator = (const RotatingFileLogger&) = delete;
+
+    virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+    virtual void flush() override;
+
+    /**
+     * @brief Rotate the file now, waits until the next file is ready
+     */
+    void rotate();
+
+    /**
+     * @brief Number of rotations so far
+     */
+    size_t rotations() const noexcept {
+        return rotations_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Block until the rotated segments are compressed and the old ones are removed
+     */
+    void wait();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Rotated {
+        size_t index;                       //segment number of the full file
+        std::unique_ptr<FdLogger> file;     //logger of the full file, nullptr for a segment of a previous run
+    };
+
+    void rotate_();
+    void run_();
+    void prepare_();
+    void compress_(const std::string &segment) noexcept;
+    void prune_() noexcept;
+    std::string segmentName_(size_t index, bool compressed) const;
+
+    const std::string fileName_;
+    const std::string nextName_;
+    const RotationPolicy rotation_;
+    const FlushPolicy flush_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::unique_ptr<FdLogger> file_;
+    std::unique_ptr<FdLogger> spare_;       //logger of the next file, once it is ready
+    size_t base_;                           //size of the file when it was opened
+    Clock::time_point opened_;
+    size_t next_;                           //index of the next segment
+    std::atomic<size_t> rotations_;
+
+    //rotated segments waiting for the background thread
+    std::mutex workMutex_;
+    std::condition_variable work_;
+    std::condition_variable done_;
+    std::deque<Rotated> pending_;
+    std::deque<size_t> segments_;           //kept segments, oldest first
+    bool busy_;
+    bool running_;
+    std::thread thread_;
+};
+
+} //namespace util
+
+#endif //ROTATING_LOGGER_HPP__
@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <iostream>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm_logger.hpp"
+
+namespace util {
+
+namespace {
+//where shm_open() keeps the segments on Linux
+const char SHM_DIRECTORY[] = "/dev/shm";
+
+int64_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool isAlive(int pid) noexcept {
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+}
+
+ShmLogger::ShmLogger(const std::string &channel, size_t bytes) : name_("/" + channel + "." + std::to_string(getpid())),
+                                                                 size_(0),
+                                                                 header_(nullptr),
+                                                                 data_(nullptr),
+                                                                 tail_(0),
+                                                                 timestamp_(INT64_MIN) {
+    uint64_t capacity = 1024;
+
+    while(capacity * 2 <= bytes) {
+        capacity *= 2;
+    }
+    size_ = sizeof(ShmRing::Header) + capacity;
+
+    //a segment left by an earlier logger with the same name is replaced, not truncated under the collector
+    shm_unlink(name_.c_str());
+
+    int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+    if(fd < 0) {
+        std::cerr << "Fail to open shared memory " << name_ << " : " << strerror(errno) << std::endl;
+        return;
+    }
+
+    void *map = MAP_FAILED;
+
+    if(ftruncate(fd, size_) == 0) {
+        map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if(map == MAP_FAILED) {
+        std::cerr << "Fail to map shared memory " << name_ << " : " << strerror(errno) << std::endl;
+        shm_unlink(name_.c_str());
+        return;
+    }
+
+    header_ = static_cast<ShmRing::Header*>(map);
+    header_->version = ShmRing::VERSION;
+    header_->pid = getpid();
+    header_->capacity = capacity;
+    header_->closed.store(0, std::memory_order_relaxed);
+    header_->dropped.store(0, std::memory_order_relaxed);
+    header_->head.store(0, std::memory_order_relaxed);
+    header_->tail.store(0, std::memory_order_relaxed);
+    data_ = reinterpret_cast<char*>(header_ + 1);
+
+    //the collector takes the segment once the magic is there
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = ShmRing::MAGIC;
+}
+
+ShmLogger::~ShmLogger() {
+    if(header_) {
+        header_->closed.store(1, std::memory_order_release);
+        munmap(header_, size_);
+    }
+}
+
+void ShmLogger::out(LogLevel level, const char* str) {
+    out(level, str, strlen(str));
+}
+
+void ShmLogger::out(LogLevel level, const char* str, size_t len) {
+    out(level, now(), str, len);
+}
+
+void ShmLogger::out(LogLevel level, int64_t timestamp, const char* str, size_t len) {
+    if(!header_) {
+        return;
+    }
+
+    const uint64_t capacity = header_->capacity;
+
+    //a record takes half the ring at most
+    len = std::min<size_t>(len, capacity / 2 - sizeof(ShmRing::Record));
+
+    size_t size = ShmRing::align(sizeof(ShmRing::Record) + len);
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    size_t rest = capacity - (head & (capacity - 1));
+    size_t skip = rest < size ? rest : 0;
+
+    //the cache line of tail is only shared with the collector when the ring seems full
+    if(head + skip + size - tail_ > capacity) {
+        tail_ = header_->tail.load(std::memory_order_acquire);
+
+        if(head + skip + size - tail_ > capacity) {
+            header_->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    //a record doesn't wrap, the rest of the lap is skipped
+    if(skip >= sizeof(ShmRing::Record)) {
+        ShmRing::Record padding {};
+
+        padding.flags = ShmRing::Record::PADDING;
+        std::memcpy(data_ + (head & (capacity - 1)), &padding, sizeof(padding));
+    }
+    head += skip;
+
+    //the time was taken before the lock, a caller which got the lock first may have taken a later one
+    timestamp_ = std::max(timestamp_, timestamp);
+
+    ShmRing::Record record {};
+    char *dst = data_ + (head & (capacity - 1));
+
+    record.length = len;
+    record.level = static_cast<uint8_t>(level);
+    record.timestamp = timestamp_;
+    std::memcpy(dst, &record, sizeof(record));
+    std::memcpy(dst + sizeof(record), str, len);
+
+    header_->head.store(head + size, std::memory_order_release);
+}
+
+ShmCollector::ShmCollector(const std::string &channel, std::chrono::milliseconds delay) : prefix_(channel + "."),
+                                                                                         delay_(delay) {}
+
+ShmCollector::~ShmCollector() {
+    for(auto &segment : segments_) {
+        munmap(segment.header, segment.size);
+    }
+}
+
+size_t ShmCollector::scan() {
+    DIR *dir = opendir(SHM_DIRECTORY);
+
+    if(dir == nullptr) {
+        return segments_.size();
+    }
+
+    while(struct dirent *entry = readdir(dir)) {
+        std::string name = std::string("/") + entry->d_name;
+        auto mapped = [&](const Segment &segment) { return segment.name == name; };
+
+        if(strncmp(entry->d_name, prefix_.c_str(), prefix_.size()) != 0 ||
+           std::any_of(segments_.begin(), segments_.end(), mapped)) {
+            continue;
+        }
+
+        int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+        struct stat st;
+
+        if(fd < 0) {
+            continue;
+        }
+        if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRing::Header)) {
+            close(fd);
+            continue;
+        }
+
+        void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if(map == MAP_FAILED) {
+            continue;
+        }
+
+        auto header = static_cast<ShmRing::Header*>(map);
+        bool valid = header->magic == ShmRing::MAGIC;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        valid = valid && header->version == ShmRing::VERSION &&
+                header->capacity > 0 && (header->capacity & (header->capacity - 1)) == 0 &&
+                header->capacity <= static_cast<size_t>(st.st_size) - sizeof(ShmRing::Header);
+
+        //not initialized yet, or not a ring, it is looked at again by the next scan
+        if(!valid) {
+            munmap(map, st.st_size);
+            continue;
+        }
+
+        uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        segments_.push_back(Segment {name, static_cast<size_t>(st.st_size), static_cast<uint64_t>(st.st_ino), header,
+                                     reinterpret_cast<const char*>(header + 1), tail, tail, 0});
+    }
+    closedir(dir);
+
+    return segments_.size();
+}
+
+size_t ShmCollector::poll(const Writer &write, bool drain) {
+    const int64_t limit = drain ? INT64_MAX : now() - std::chrono::duration_cast<std::chrono::nanoseconds>(delay_).count();
+    size_t written = 0;
+
+    for(auto &segment : segments_) {
+        uint64_t dropped = segment.header->dropped.load(std::memory_order_relaxed);
+
+        if(dropped != segment.dropped) {
+            char text[64];
+            int len = snprintf(text, sizeof(text), "dropped %lu messages", dropped - segment.dropped);
+
+            write(ShmRecord {segment.header->pid, LogLevel::Warn, now(), text, static_cast<size_t>(len)});
+            segment.dropped = dropped;
+            ++written;
+        }
+    }
+
+    //the oldest waiting message of all rings goes first
+    for(;;) {
+        Segment *oldest = nullptr;
+        ShmRing::Record oldestRecord;
+        const char *oldestText = nullptr;
+
+        for(auto &segment : segments_) {
+            ShmRing::Record record;
+            const char *text;
+
+            if(peek_(segment, record, text) && record.timestamp <= limit &&
+               (!oldest || record.timestamp < oldestRecord.timestamp)) {
+                oldest = &segment;
+                oldestRecord = record;
+                oldestText = text;
+            }
+        }
+
+        if(!oldest) {
+            break;
+        }
+
+        write(ShmRecord {oldest->header->pid, static_cast<LogLevel>(std::min<uint8_t>(oldestRecord.level, static_cast<uint8_t>(LogLevel::Fatal))),
+                         oldestRecord.timestamp, oldestText, oldestRecord.length});
+        oldest->tail += ShmRing::align(sizeof(ShmRing::Record) + oldestRecord.length);
+        //the process gets the room back at once, it caches the tail until its ring seems full
+        oldest->header->tail.store(oldest->tail, std::memory_order_release);
+        ++written;
+    }
+
+    for(auto segment = segments_.begin(); segment != segments_.end();) {
+        segment->header->tail.store(segment->tail, std::memory_order_release);
+
+        //closed is read first, a message written before closing is seen by peek_()
+        bool done = segment->header->closed.load(std::memory_order_acquire) || !isAlive(segment->header->pid);
+        ShmRing::Record record;
+        const char *text;
+
+        if(done && !peek_(*segment, record, text)) {
+            release_(*segment);
+            segment = segments_.erase(segment);
+        } else {
+            ++segment;
+        }
+    }
+
+    return written;
+}
+
+bool ShmCollector::peek_(Segment &segment, ShmRing::Record &record, const char *&text) noexcept {
+    const uint64_t capacity = segment.header->capacity;
+
+    if(segment.tail >= segment.head) {
+        segment.head = segment.header->head.load(std::memory_order_acquire);
+    }
+
+    while(segment.tail < segment.head) {
+        size_t offset = segment.tail & (capacity - 1);
+        size_t rest = capacity - offset;
+
+        if(rest < sizeof(ShmRing::Record)) {
+            segment.tail += rest;
+            continue;
+        }
+
+        std::memcpy(&record, segment.data + offset, sizeof(record));
+        if(record.flags & ShmRing::Record::PADDING) {
+            segment.tail += rest;
+            continue;
+        }
+
+        //a corrupt length must not send the reader out of the ring
+        record.length = std::min<uint64_t>(record.length, rest - sizeof(record));
+        text = segment.data + offset + sizeof(record);
+        return true;
+    }
+    return false;
+}
+
+void ShmCollector::release_(Segment &segment) noexcept {
+    munmap(segment.header, segment.size);
+
+    //the process may have created a new ring of the same name meanwhile
+    int fd = shm_open(segment.name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    struct stat st;
+
+    if(fd < 0) {
+        return;
+    }
+    if(fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_ino) == segment.inode) {
+        shm_unlink(segment.name.c_str());
+    }
+    close(fd);
+}
+
+} //namespace util
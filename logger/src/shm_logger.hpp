@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef SHM_LOGGER_HPP__
+#define SHM_LOGGER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "logger.hpp"
+
+namespace util {
+
+/**
+ * Ring of one process in the shared memory segment /<channel>.<pid>, written by ShmLogger and read by ShmCollector.
+ *
+ * The ring holds variable size records of 8 byte aligned {length, level, flags, timestamp, text}.
+ * The process is the only producer and the collector the only consumer, each of them owns one of the
+ * byte counters `head` and `tail`, so neither takes a lock or waits for the other.
+ */
+struct ShmRing {
+    static constexpr uint64_t MAGIC = 0x474e49524d485355; //"USHMRING"
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        int32_t pid;
+        uint64_t capacity;                      //bytes of the records, a power of two
+        std::atomic<uint32_t> closed;           //set when the process is done with the ring
+        std::atomic<uint64_t> dropped;          //records which didn't fit
+        alignas(64) std::atomic<uint64_t> head; //bytes written by the process
+        alignas(64) std::atomic<uint64_t> tail; //bytes read by the collector
+    };
+
+    struct Record {
+        enum Flag : uint8_t {
+            PADDING = 1                         //the rest of the lap is skipped
+        };
+
+        uint32_t length;                        //of the text
+        uint8_t level;
+        uint8_t flags;
+        uint16_t reserved;
+        int64_t timestamp;                      //nanoseconds since epoch
+    };
+
+    static constexpr size_t align(size_t size) noexcept {
+        return (size + 7) & ~static_cast<size_t>(7);
+    }
+};
+
+/**
+ * Logger which hands its messages to a log_collector process through a shared memory ring,
+ * so processes on one host don't write files of their own.
+ *
+ * Threads of the process serialize on a mutex to be the one producer of the ring. Registered with
+ * a worker (SinkOptions::worker) or written by the backend thread of asynchronous mode, it is uncontended.
+ * A message which doesn't fit in the free part of the ring is dropped and counted, the process never waits for the collector.
+ * The collector merges the rings by timestamp, so a message is never stamped earlier than the one before it in the ring.
+ */
+class ShmLogger : public ILogger {
+public:
+    static constexpr size_t SIZE = 4 * 1024 * 1024;
+
+    /**
+     * @brief Create the segment /<channel>.<pid>, which the collector of `channel` picks up
+     * @param bytes size of the ring, rounded down to a power of two
+     */
+    explicit ShmLogger(const std::string &channel, size_t bytes = SIZE);
+
+    /**
+     * @brief Mark the ring closed, the collector removes the segment once it has read the ring
+     */
+    virtual ~ShmLogger();
+
+    ShmLogger(const ShmLogger&) = delete;
+    ShmLogger& operator = (const ShmLogger&) = delete;
+
+    virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+    virtual void out(LogLevel level, int64_t timestamp, const char* str, size_t len) override;
+
+    bool isOpen() const noexcept {
+        return header_ != nullptr;
+    }
+
+    /**
+     * @brief Number of messages dropped because the ring was full
+     */
+    uint64_t dropped() const noexcept {
+        return header_ ? header_->dropped.load(std::memory_order_relaxed) : 0;
+    }
+
+private:
+    std::string name_;
+    size_t size_;
+    ShmRing::Header *header_;
+    char *data_;
+    uint64_t tail_;             //last tail read from the collector, reloaded when the ring seems full
+    int64_t timestamp_;         //of the last record written
+    std::mutex mutex_;
+};
+
+/**
+ * Message read from the ring of a process
+ */
+struct ShmRecord {
+    int pid;
+    LogLevel level;
+    int64_t timestamp;          //nanoseconds since epoch
+    const char *text;           //valid during the callback only
+    size_t length;
+};
+
+/**
+ * Reads the rings of every process of a channel and merges their messages by timestamp.
+ *
+ * The messages of one ring are in timestamp order. A message is handed out once it is older than
+ * `delay`, by then the messages stamped before it in other processes have been written too,
+ * and the oldest of the waiting messages of all rings goes first.
+ */
+class ShmCollector {
+public:
+    using Writer = std::function<void(const ShmRecord &record)>;
+
+    explicit ShmCollector(const std::string &channel, std::chrono::milliseconds delay = std::chrono::milliseconds(50));
+    ~ShmCollector();
+
+    ShmCollector(const ShmCollector&) = delete;
+    ShmCollector& operator = (const ShmCollector&) = delete;
+
+    /**
+     * @brief Map the segments of processes which have started since the last scan
+     * @return return the number of rings being read
+     */
+    size_t scan();
+
+    /**
+     * @brief Write the messages older than the delay in timestamp order, or every message if `drain` is set.
+     *        The dropped messages of a process are reported as a Warn message.
+     *        Segments of processes which have closed their ring, or exited, are removed once they are read.
+     * @return return the number of messages written
+     */
+    size_t poll(const Writer &write, bool drain = false);
+
+private:
+    struct Segment {
+        std::string name;
+        size_t size;
+        uint64_t inode;         //tells the segment from a later one of the same name
+        ShmRing::Header *header;
+        const char *data;
+        uint64_t head;          //last head read from the process, reloaded when the reader catches up
+        uint64_t tail;          //copy of header->tail
+        uint64_t dropped;       //reported so far
+    };
+
+    bool peek_(Segment &segment, ShmRing::Record &record, const char *&text) noexcept;
+    void release_(Segment &segment) noexcept;
+
+    std::string prefix_;
+    std::chrono::milliseconds delay_;
+    std::vector<Segment> segments_;
+};
+
+} //namespace util
+
+#endif //SHM_LOGGER_HPP__
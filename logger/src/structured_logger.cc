@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <chrono>
+#include <charconv>
+
+#include "structured_logger.hpp"
+
+namespace util {
+
+namespace {
+constexpr const char *LEVEL_NAMES[] = {"debug", "verbose", "info", "warn", "error", "fatal"};
+
+int64_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Write a timestamp as "2026-10-17T09:30:00.123456789Z", gmtime_r runs once per second and thread
+ */
+void writeTimestamp(FormatWriter &out, int64_t timestamp) noexcept {
+    struct Date {
+        int64_t second = INT64_MIN;
+        char str[20];
+    };
+    thread_local Date date;
+
+    int64_t second = timestamp / 1000000000;
+    int64_t nanos = timestamp % 1000000000;
+
+    if(nanos < 0) {
+        --second;
+        nanos += 1000000000;
+    }
+    if(second != date.second) {
+        time_t t = static_cast<time_t>(second);
+        struct tm tm;
+
+        gmtime_r(&t, &tm);
+        strftime(date.str, sizeof(date.str), "%Y-%m-%dT%H:%M:%S", &tm);
+        date.second = second;
+    }
+
+    char fraction[11] = {'.'};
+    for(int i = 9; i > 0; --i, nanos /= 10) {
+        fraction[i] = static_cast<char>('0' + nanos % 10);
+    }
+    fraction[10] = 'Z';
+
+    out.append(date.str, std::strlen(date.str));
+    out.append(fraction, sizeof(fraction));
+}
+
+void writeJsonValue(FormatWriter &out, const LogValue &value) noexcept {
+    switch(value.kind) {
+        case 's':
+            writeQuoted(out, value.s, value.len);
+            break;
+        case 'p':
+            out.append('"');
+            writeLogNumber(out, value);
+            out.append('"');
+            break;
+        case 'f':
+            if(!std::isfinite(value.f)) {
+                out.append("null", 4);
+                break;
+            }
+            writeLogNumber(out, value);
+            break;
+        default:
+            writeLogNumber(out, value);
+            break;
+    }
+}
+
+/**
+ * Writes the fields of a line in the syntax of an encoding
+ */
+class FieldWriter {
+public:
+    FieldWriter(LogEncoding encoding, char *buf, size_t size) noexcept : json_(encoding == LogEncoding::Json),
+                                                                         first_(true),
+                                                                         buf_(buf),
+                                                                         out_(buf, json_ && size > 0 ? size - 1 : size) {
+        if(json_) {
+            out_.append('{');
+        }
+    }
+
+    void key(const char *key, size_t len) noexcept {
+        if(json_) {
+            out_.append(first_ ? "\"" : ",\"", first_ ? 1 : 2);
+            out_.append(key, len);
+            out_.append("\":", 2);
+        } else {
+            if(!first_) {
+                out_.append(' ');
+            }
+            out_.append(key, len);
+            out_.append('=');
+        }
+        first_ = false;
+    }
+
+    void field(const char *key, const LogValue &value) noexcept {
+        this->key(key, std::strlen(key));
+        if(json_) {
+            writeJsonValue(out_, value);
+        } else {
+            writeLogfmtValue(out_, value);
+        }
+    }
+
+    void field(const char *key, const char *str, size_t len) noexcept {
+        LogValue value;
+
+        value.kind = 's';
+        value.s = str;
+        value.len = len;
+        field(key, value);
+    }
+
+    void timestamp(int64_t timestamp) noexcept {
+        key("ts", 2);
+        if(json_) {
+            out_.append('"');
+        }
+        writeTimestamp(out_, timestamp);
+        if(json_) {
+            out_.append('"');
+        }
+    }
+
+    void level(LogLevel level) noexcept {
+        const char *name = LEVEL_NAMES[static_cast<int>(level)];
+
+        key("level", 5);
+        if(json_) {
+            out_.append('"');
+        }
+        out_.append(name, std::strlen(name));
+        if(json_) {
+            out_.append('"');
+        }
+    }
+
+    /**
+     * @brief Write "src" as "file:line" and "func" of a call site
+     */
+    void site(const LogSite &site) noexcept {
+        char src[256];
+        FormatWriter location(src, sizeof(src));
+        char line[16];
+
+        location.append(site.file, std::strlen(site.file));
+        location.append(':');
+        location.append(line, std::to_chars(line, line + sizeof(line), site.line).ptr - line);
+
+        size_t len = location.finish();
+        field("src", src, len);
+        field("func", site.function, std::strlen(site.function));
+    }
+
+    /**
+     * @brief Close the line
+     * @return return its length without null
+     */
+    size_t finish() noexcept {
+        size_t len = out_.finish();
+
+        if(json_) {
+            //the room for '}' was kept out of the writer, so that a cut line is still closed
+            buf_[len++] = '}';
+            buf_[len] = '\0';
+        }
+        return len;
+    }
+
+private:
+    const bool json_;
+    bool first_;
+    char *buf_;
+    FormatWriter out_;
+};
+
+/**
+ * Length of "[file:line][function] " which the formatter writes before the message of a call site
+ */
+size_t prefixLength(const LogSite &site) noexcept {
+    if(!site.prefix) {
+        return 0;
+    }
+
+    char line[16];
+    size_t digits = std::to_chars(line, line + sizeof(line), site.line).ptr - line;
+
+    return std::strlen(site.file) + digits + std::strlen(site.function) + 6;
+}
+}
+
+size_t LogEncoder::encode(const LogRecord &record, char *buf, size_t size) const noexcept {
+    if(size < 2) {
+        return 0;
+    }
+
+    FieldWriter out(encoding_, buf, size);
+
+    out.timestamp(record.timestamp);
+    out.level(record.level);
+
+    if(!record.formatter) {
+        out.field("msg", record.payload, record.length);
+        return out.finish();
+    }
+
+    out.site(*record.site);
+
+    if(record.format->keys()) {
+        const char *event = record.format->str();
+
+        out.field("event", event, std::strlen(event));
+        forEachLogValue(record, [&](const char *key, const LogValue &value) {
+            out.field(key, value);
+        });
+        return out.finish();
+    }
+
+    //the message of a LOG_* call, without the call site which has its own fields
+    char text[LogRecord::PAYLOAD_SIZE];
+    size_t len = record.formatter(record, text, sizeof(text));
+    size_t prefix = std::min(prefixLength(*record.site), len);
+
+    out.field("msg", text + prefix, len - prefix);
+    return out.finish();
+}
+
+size_t LogEncoder::encode(LogLevel level, int64_t timestamp, const char *str, size_t len,
+                          char *buf, size_t size) const noexcept {
+    if(size < 2) {
+        return 0;
+    }
+
+    FieldWriter out(encoding_, buf, size);
+
+    out.timestamp(timestamp);
+    out.level(level);
+    out.field("msg", str, len);
+    return out.finish();
+}
+
+StructuredLogger::StructuredLogger(const std::string &fileName, LogEncoding encoding,
+                                   const FlushPolicy &policy) : encoder_(encoding), file_(fileName, policy) {}
+
+void StructuredLogger::out(LogLevel level, const char* str) {
+    out(level, str, std::strlen(str));
+}
+
+void StructuredLogger::out(LogLevel level, const char* str, size_t len) {
+    if(!file_.isOpen()) {
+        return;
+    }
+
+    static thread_local LineBuffer lineBuffer;
+    char buf[LINE_SIZE];
+    int64_t timestamp = now();
+    size_t lineLen;
+    const char *line = lineBuffer.format(buf, LINE_SIZE, lineLen, [&](char *dst, size_t size) {
+        return encoder_.encode(level, timestamp, str, len, dst, size);
+    });
+
+    file_.writeLine(level, line, lineLen);
+}
+
+void StructuredLogger::out(const LogRecord &record) {
+    if(!file_.isOpen()) {
+        return;
+    }
+
+    char line[LINE_SIZE];
+    size_t len = encoder_.encode(record, line, sizeof(line));
+
+    file_.writeLine(record.level, line, len);
+}
+
+void StructuredLogger::flush() {
+    file_.flush();
+}
+
+} //namespace util
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STRUCTURED_LOGGER_HPP__
+#define STRUCTURED_LOGGER_HPP__
+
+#include <string>
+
+#include "logger.hpp"
+#include "fd_logger.hpp"
+
+namespace util {
+
+enum class LogEncoding : uint8_t {
+    Json,   //{"ts":"2026-10-17T09:30:00.123456789Z","level":"info","src":"pcap.cc:42","func":"run","event":"packet","caplen":60}
+    Logfmt  //ts=2026-10-17T09:30:00.123456789Z level=info src=pcap.cc:42 func=run event=packet caplen=60
+};
+
+/**
+ * Encodes records into one line of JSON or logfmt, in the caller's buffer without allocation.
+ *
+ * A LOG_*_KV record is written as its event and one field per value, numbers as numbers
+ * and strings escaped. Other records and text messages get the formatted message as "msg".
+ * The date of the timestamp is computed once per second and thread.
+ */
+class LogEncoder {
+public:
+    explicit LogEncoder(LogEncoding encoding) noexcept : encoding_(encoding) {}
+
+    /**
+     * @brief Encode a record without the trailing '\n', a line longer than size is cut
+     * @return return the length written without null
+     */
+    size_t encode(const LogRecord &record, char *buf, size_t size) const noexcept;
+
+    /**
+     * @brief Encode a formatted message
+     * @param timestamp nanoseconds since epoch
+     */
+    size_t encode(LogLevel level, int64_t timestamp, const char *str, size_t len, char *buf, size_t size) const noexcept;
+
+    LogEncoding encoding() const noexcept {
+        return encoding_;
+    }
+
+private:
+    const LogEncoding encoding_;
+};
+
+/**
+ * Logger which writes records as JSON lines or logfmt to a file, for log pipelines
+ * which parse fields instead of text. Lines are buffered as FdLogger does.
+ */
+class StructuredLogger : public RecordLogger {
+public:
+    static constexpr size_t LINE_SIZE = 8 * LogRecord::PAYLOAD_SIZE;
+
+    /**
+     * @brief Append to a file, which is created if it doesn't exist
+     */
+    explicit StructuredLogger(const std::string &fileName, LogEncoding encoding = LogEncoding::Json,
+                              const FlushPolicy &policy = FlushPolicy());
+
+    StructuredLogger(const StructuredLogger&) = delete;
+    StructuredLogger& operator = (const StructuredLogger&) = delete;
+
+    virtual void out(LogLevel level, const char* str) override;
+    virtual void out(LogLevel level, const char* str, size_t len) override;
+    virtual void out(const LogRecord &record) override;
+    virtual void flush() override;
+
+    bool isOpen() const noexcept {
+        return file_.isOpen();
+    }
+
+    /**
+     * @brief Bytes of the lines logged so far, including the buffered ones
+     */
+    size_t bytes() const noexcept {
+        return file_.bytes();
+    }
+
+private:
+    const LogEncoder encoder_;
+    FdLogger file_;
+};
+
+} //namespace util
+
+#endif //STRUCTURED_LOGGER_HPP__
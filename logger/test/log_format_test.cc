@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <cstdio>
+#include <climits>
+#include <cfloat>
+
+#include "log_record.hpp"
+#include "log_format.hpp"
+
+namespace util {
+
+template<typename F, typename... Args>
+std::string compiledFormat(F fmt, const Args&... args) {
+    static constexpr const char *str = fmt();
+    static constexpr CompiledFormat<countFormatOps(str), Args...> compiled {str};
+    char buf[512];
+
+    compiled.format(buf, sizeof(buf), args...);
+    return buf;
+}
+
+#define EXPECT_LIKE_PRINTF(fmt, args...) \
+    do { \
+        char expected[512]; \
+        std::snprintf(expected, sizeof(expected), fmt, args); \
+        EXPECT_EQ(compiledFormat([] { return fmt; }, args), expected) << "format : " << fmt; \
+    } while(0)
+
+class LogFormatTest : public ::testing::Test {
+};
+
+TEST_F(LogFormatTest, integers) {
+    const int values[] = {0, 1, -1, 42, -42, INT_MAX, INT_MIN};
+
+    for(int v : values) {
+        EXPECT_LIKE_PRINTF("%d", v);
+        EXPECT_LIKE_PRINTF("%i|", v);
+        EXPECT_LIKE_PRINTF("[%5d]", v);
+        EXPECT_LIKE_PRINTF("[%-5d]", v);
+        EXPECT_LIKE_PRINTF("[%05d]", v);
+        EXPECT_LIKE_PRINTF("[%+d]", v);
+        EXPECT_LIKE_PRINTF("[% d]", v);
+        EXPECT_LIKE_PRINTF("[%.3d]", v);
+        EXPECT_LIKE_PRINTF("[%8.3d]", v);
+        EXPECT_LIKE_PRINTF("[%.0d]", v);
+        EXPECT_LIKE_PRINTF("[%x]", v);
+        EXPECT_LIKE_PRINTF("[%#X]", v);
+        EXPECT_LIKE_PRINTF("[%#o]", v);
+        EXPECT_LIKE_PRINTF("[%u]", v);
+        EXPECT_LIKE_PRINTF("[%08x]", v);
+    }
+
+    const long long big = LLONG_MIN;
+    const unsigned long ul = ULONG_MAX;
+    EXPECT_LIKE_PRINTF("%lld", big);
+    EXPECT_LIKE_PRINTF("%lu %lx", ul, ul);
+    const char c = 'A';
+    EXPECT_LIKE_PRINTF("[%c][%3c][%-3c]", c, c, c);
+}
+
+TEST_F(LogFormatTest, floats) {
+    const double values[] = {0.0, -0.0, 0.5, -1.25, 3.14159265358979, 1e-10, 123456789.125, 1e300, DBL_MIN};
+
+    for(double v : values) {
+        EXPECT_LIKE_PRINTF("%f", v);
+        EXPECT_LIKE_PRINTF("[%.2f]", v);
+        EXPECT_LIKE_PRINTF("[%10.3f]", v);
+        EXPECT_LIKE_PRINTF("[%-10.1f]", v);
+        EXPECT_LIKE_PRINTF("[%010.2f]", v);
+        EXPECT_LIKE_PRINTF("[%+.1f]", v);
+        EXPECT_LIKE_PRINTF("[%e]", v);
+        EXPECT_LIKE_PRINTF("[%.3E]", v);
+        EXPECT_LIKE_PRINTF("[%g]", v);
+        EXPECT_LIKE_PRINTF("[%.10G]", v);
+        EXPECT_LIKE_PRINTF("[%a]", v);
+        EXPECT_LIKE_PRINTF("[%#.0f]", v);
+    }
+
+    const float f = 0.1f;
+    EXPECT_LIKE_PRINTF("%f %.9f", f, f);
+}
+
+TEST_F(LogFormatTest, strings_and_pointers) {
+    const char *str = "hello";
+    const void *ptr = &str;
+    const void *null = nullptr;
+
+    EXPECT_LIKE_PRINTF("%s", str);
+    EXPECT_LIKE_PRINTF("[%10s][%-10s][%.2s][%5.1s]", str, str, str, str);
+    EXPECT_LIKE_PRINTF("%p %p", ptr, null);
+    EXPECT_LIKE_PRINTF("100%% %s %%", str);
+}
+
+TEST_F(LogFormatTest, typed_arguments) {
+    static constexpr CompiledFormat<countFormatOps("%s %d %u %.1f"), std::string, LogLevel, std::chrono::seconds, double> compiled {"%s %d %u %.1f"};
+    char buf[64];
+
+    compiled.format(buf, sizeof(buf), std::string("text"), LogLevel::Error, std::chrono::seconds(5), 2.25);
+    EXPECT_STREQ(buf, "text 4 5 2.2");
+}
+
+TEST_F(LogFormatTest, truncation) {
+    static constexpr CompiledFormat<countFormatOps("%s-%d"), const char*, int> compiled {"%s-%d"};
+    char buf[8];
+
+    EXPECT_EQ(compiled.format(buf, sizeof(buf), "abcdef", 1234), 7u);
+    EXPECT_STREQ(buf, "abcdef-") << "output should be truncated like snprintf";
+}
+
+} //namespace util
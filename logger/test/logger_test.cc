@@ -0,0 +1,1123 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "logger.hpp"
+#include "ring_buffer.hpp"
+
+namespace util {
+
+/**
+ * Logger which keeps every message in memory
+ */
+class MemoryLogger : public ILogger {
+public:
+    virtual void out(LogLevel level, const char* str) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        lines_.push_back(str);
+
+        entered_ = true;
+        changed_.notify_all();
+        changed_.wait(lock, [this] { return !held_; });
+    }
+
+    /**
+     * @brief Make out() wait after storing a message until release(), so the queue of asynchronous mode fills up
+     */
+    void hold() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        held_ = true;
+        entered_ = false;
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        held_ = false;
+        changed_.notify_all();
+    }
+
+    /**
+     * @brief Wait until out() has been called since hold()
+     */
+    void waitEntered() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return entered_; });
+    }
+
+    std::vector<std::string> lines() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lines_;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lines_.clear();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<std::string> lines_;
+    bool held_ = false;
+    bool entered_ = false;
+};
+
+class LoggerTest : public ::testing::Test {
+public:
+    static std::shared_ptr<MemoryLogger> memory;
+
+protected:
+    void SetUp() override {
+        Logger::getInstance().setLogLevel(LogLevel::Verbose);
+        memory->clear();
+    }
+
+    void TearDown() override {
+        Logger::getInstance().disableAsync();
+        Logger::getInstance().resetLogSites();
+    }
+};
+
+std::shared_ptr<MemoryLogger> LoggerTest::memory = std::make_shared<MemoryLogger>();
+
+TEST_F(LoggerTest, ring_buffer_fifo) {
+    RingBuffer<int> ring(4);
+
+    ASSERT_EQ(ring.capacity(), 4u) << "capacity should be rounded up to a power of two";
+
+    for(int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(ring.push([i](int &item) { item = i; }));
+    }
+    ASSERT_FALSE(ring.push([](int &item) { item = -1; })) << "push should fail when the ring is full";
+
+    for(int i = 0; i < 4; ++i) {
+        int value = -1;
+        ASSERT_TRUE(ring.pop([&](int &item) { value = item; }));
+        ASSERT_EQ(value, i) << "items should be popped in push order";
+    }
+    ASSERT_FALSE(ring.pop([](int &item) {})) << "pop should fail when the ring is empty";
+}
+
+TEST_F(LoggerTest, ring_buffer_front_key) {
+    RingBuffer<int> ring(4);
+    size_t position;
+    uint64_t key;
+
+    ASSERT_FALSE(ring.front(position, key)) << "an empty ring has no front";
+
+    ASSERT_TRUE(ring.push([](int &item, size_t ticket) { item = 7; return uint64_t(100) + ticket; }));
+    ASSERT_TRUE(ring.front(position, key));
+    ASSERT_EQ(position, 0u);
+    ASSERT_EQ(key, 100u) << "front should give the key returned by the fill callback";
+
+    //another consumer takes the item, the peeked position is stale
+    ASSERT_TRUE(ring.pop([](int &item) {}));
+    ASSERT_FALSE(ring.pop(position, [](int &item) { ADD_FAILURE() << "a stale position should not be popped"; }));
+
+    ASSERT_TRUE(ring.push([](int &item, size_t ticket) { item = 8; return uint64_t(100) + ticket; }));
+    ASSERT_TRUE(ring.front(position, key));
+    ASSERT_EQ(key, 101u);
+
+    int value = -1;
+    ASSERT_TRUE(ring.pop(position, [&](int &item) { value = item; }));
+    ASSERT_EQ(value, 8);
+}
+
+TEST_F(LoggerTest, ring_buffer_multi_producer) {
+    RingBuffer<int> ring(1024);
+    const int producers = 4;
+    const int count = 10000;
+    std::vector<std::thread> threads;
+    std::vector<int> last(producers, -1);
+    int received = 0;
+
+    for(int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for(int i = 0; i < count; ++i) {
+                while(!ring.push([&](int &item) { item = p * count + i; })) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    while(received < producers * count) {
+        ring.pop([&](int &item) {
+            int p = item / count;
+            ASSERT_GT(item % count, last[p]) << "items of one producer should keep their order";
+            last[p] = item % count;
+            ++received;
+        });
+    }
+
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_TRUE(ring.empty());
+}
+
+/**
+ * Singleton which counts its constructions and destructions
+ */
+class Counted : public Singleton<Counted> {
+public:
+    static std::atomic<int> created;
+    static std::atomic<int> destroyed;
+
+private:
+    friend class Singleton<Counted>;
+    Counted() { ++created; }
+    ~Counted() { ++destroyed; }
+};
+
+std::atomic<int> Counted::created {0};
+std::atomic<int> Counted::destroyed {0};
+
+TEST_F(LoggerTest, singleton_lifetime) {
+    std::vector<std::thread> workers;
+    std::vector<Counted*> instances(8);
+
+    ASSERT_FALSE(Counted::hasInstance());
+
+    for(size_t t = 0; t < instances.size(); ++t) {
+        workers.emplace_back([&, t] { instances[t] = &Counted::getInstance(); });
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+
+    ASSERT_EQ(Counted::created, 1) << "concurrent first calls should create one instance";
+    for(auto instance : instances) {
+        ASSERT_EQ(instance, instances[0]);
+    }
+
+    Counted::destroyInstance();
+    ASSERT_EQ(Counted::destroyed, 1);
+    ASSERT_FALSE(Counted::hasInstance());
+
+    Counted::getInstance();
+    ASSERT_EQ(Counted::created, 2) << "getInstance after destroyInstance should create a new instance";
+    Counted::destroyInstance();
+}
+
+namespace quiet {
+namespace {
+constexpr LogLevel logModuleLevel = LogLevel::Warn;
+}
+
+int logBelowModuleLevel(int &evaluated) {
+    LOG_DEBUG("debug %d", ++evaluated);
+    LOG_INFO("info %d", ++evaluated);
+    LOG_WARN_RAW("warn %d", ++evaluated);
+    return evaluated;
+}
+} //namespace quiet
+
+TEST_F(LoggerTest, module_level_compiles_out) {
+    int evaluated = 0;
+
+    ASSERT_EQ(quiet::logBelowModuleLevel(evaluated), 1) << "arguments below the module level should not be evaluated";
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 1u);
+    ASSERT_EQ(lines[0], "warn 1");
+}
+
+void neverCalled() {
+    LOG_DEBUG("never logged");
+}
+
+TEST_F(LoggerTest, log_sites_registered_at_startup) {
+    auto sites = Logger::getInstance().logSites();
+    auto site = std::find_if(sites.begin(), sites.end(), [](const LogSite *site) {
+        return std::string(site->function) == "neverCalled";
+    });
+
+    ASSERT_NE(site, sites.end()) << "call sites should be registered before they are reached";
+    ASSERT_STREQ((*site)->file, "logger_test.cc");
+    ASSERT_EQ((*site)->level, LogLevel::Debug);
+    ASSERT_EQ((*site)->state, LogSite::DISABLED) << "a debug call site should follow the log level";
+
+    ASSERT_EQ(Logger::getInstance().enableLogSites("neverCalled"), 1u) << "a pattern should match the function name";
+    ASSERT_EQ((*site)->state, LogSite::ENABLED);
+}
+
+TEST_F(LoggerTest, log_sites_enabled_by_pattern) {
+    const int line = __LINE__ + 2;
+    auto log = [](int value) {
+        LOG_DEBUG_RAW("debug %d", value);
+        LOG_INFO_RAW("info %d", value);
+    };
+    std::string location = "logger_test.cc:" + std::to_string(line);
+
+    Logger::getInstance().setLogLevel(LogLevel::Warn);
+    log(1);
+    ASSERT_EQ(Logger::getInstance().enableLogSites(location), 1u);
+    log(2);
+    Logger::getInstance().enableLogSites(location, false);
+    log(3);
+    Logger::getInstance().resetLogSites();
+    Logger::getInstance().setLogLevel(LogLevel::Debug);
+    log(4);
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 3u);
+    ASSERT_EQ(lines[0], "debug 2") << "an enabled call site should log below the log level";
+    ASSERT_EQ(lines[1], "debug 4") << "call sites should follow setLogLevel";
+    ASSERT_EQ(lines[2], "info 4");
+}
+
+TEST_F(LoggerTest, sync_out) {
+    Logger::getInstance().out(LogLevel::Info, "sync %d", 1);
+    Logger::getInstance().out(LogLevel::Debug, "filtered %d", 2);
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 1u) << "messages below the log level should be filtered";
+    ASSERT_EQ(lines[0], "sync 1");
+}
+
+TEST_F(LoggerTest, async_flush) {
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+    ASSERT_FALSE(Logger::getInstance().enableAsync(16)) << "asynchronous mode should be enabled only once";
+
+    for(int i = 0; i < 1000; ++i) {
+        Logger::getInstance().out(LogLevel::Info, "async %d", i);
+    }
+    Logger::getInstance().flush();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 1000u) << "flush should wait for every queued message";
+    for(int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(lines[i], "async " + std::to_string(i));
+    }
+}
+
+TEST_F(LoggerTest, async_multi_thread_disable_drains) {
+    const int threads = 4;
+    const int count = 2000;
+    std::vector<std::thread> workers;
+
+    ASSERT_TRUE(Logger::getInstance().enableAsync(64));
+
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([t] {
+            for(int i = 0; i < count; ++i) {
+                Logger::getInstance().out(LogLevel::Info, "%d %d", t, i);
+            }
+        });
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+
+    Logger::getInstance().disableAsync();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), static_cast<size_t>(threads * count)) << "disableAsync should drain the queue";
+
+    std::vector<int> last(threads, -1);
+    for(auto &line : lines) {
+        int t, i;
+        ASSERT_EQ(sscanf(line.c_str(), "%d %d", &t, &i), 2);
+        ASSERT_EQ(i, last[t] + 1) << "messages of one thread should keep their order";
+        last[t] = i;
+    }
+
+    Logger::getInstance().out(LogLevel::Info, "sync again");
+    ASSERT_EQ(memory->lines().back(), "sync again") << "logger should be synchronous after disableAsync";
+}
+
+TEST_F(LoggerTest, async_push_after_stop) {
+    for(auto staging : {AsyncStaging::Shared, AsyncStaging::PerThread}) {
+        std::atomic<int> consumed(0);
+        std::atomic<int> filled(0);
+        AsyncBackend backend(4, staging, [&](const LogRecord&) { ++consumed; }, nullptr);
+
+        ASSERT_TRUE(backend.push(LogLevel::Info, [&](LogRecord&) { ++filled; }));
+        backend.stop();
+        ASSERT_EQ(consumed, 1);
+
+        //a late caller which still holds the stopped backend must not claim a slot nobody drains
+        ASSERT_FALSE(backend.push(LogLevel::Info, [&](LogRecord&) { ++filled; }));
+        ASSERT_EQ(filled, 1);
+        ASSERT_EQ(backend.queued(), 0u);
+        backend.flush();
+    }
+
+    //a caller blocked on the full queue while asynchronous mode is disabled still reaches the logger,
+    //"0" keeps its slot while the logger holds it
+    ASSERT_TRUE(Logger::getInstance().enableAsync(4));
+    memory->hold();
+    Logger::getInstance().out(LogLevel::Info, "%d", 0);
+    memory->waitEntered();
+    for(int i = 1; i <= 3; ++i) {
+        Logger::getInstance().out(LogLevel::Info, "%d", i);
+    }
+
+    std::thread late([] { Logger::getInstance().out(LogLevel::Info, "%d", 4); });
+    std::thread disable([] { Logger::getInstance().disableAsync(); });
+    memory->release();
+    late.join();
+    disable.join();
+
+    Logger::getInstance().out(LogLevel::Info, "%d", 5);
+
+    auto lines = memory->lines();
+    std::sort(lines.begin(), lines.end());
+    ASSERT_EQ(lines, std::vector<std::string>({"0", "1", "2", "3", "4", "5"}));
+}
+
+TEST_F(LoggerTest, per_thread_staging_keeps_order) {
+    const int threads = 4;
+    const int count = 2000;
+    std::vector<std::thread> workers;
+
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16, AsyncStaging::PerThread));
+
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([t] {
+            for(int i = 0; i < count; ++i) {
+                LOG_INFO_RAW("%d %d", t, i);
+            }
+        });
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+
+    Logger::getInstance().flush();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), static_cast<size_t>(threads * count)) << "flush should wait for every staged message";
+
+    std::vector<int> last(threads, -1);
+    for(auto &line : lines) {
+        int t, i;
+        ASSERT_EQ(sscanf(line.c_str(), "%d %d", &t, &i), 2);
+        ASSERT_EQ(i, last[t] + 1) << "messages of one thread should keep their order";
+        last[t] = i;
+    }
+}
+
+TEST_F(LoggerTest, per_thread_staging_global_order) {
+    const int rounds = 500;
+    std::mutex mutex;
+    std::condition_variable turn;
+    int next = 0;
+
+    ASSERT_TRUE(Logger::getInstance().enableAsync(4, AsyncStaging::PerThread));
+
+    //two threads take turns, so every message happens after the previous one of the other thread
+    auto player = [&](int id) {
+        for(int i = 0; i < rounds; ++i) {
+            std::unique_lock<std::mutex> lock(mutex);
+            turn.wait(lock, [&] { return next % 2 == id; });
+            LOG_INFO_RAW("%d", next);
+            ++next;
+            turn.notify_all();
+        }
+    };
+
+    std::thread even(player, 0);
+    std::thread odd(player, 1);
+    even.join();
+    odd.join();
+
+    Logger::getInstance().disableAsync();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), static_cast<size_t>(rounds * 2));
+    for(int i = 0; i < rounds * 2; ++i) {
+        ASSERT_EQ(lines[i], std::to_string(i)) << "messages of different threads should be merged in sequence order";
+    }
+}
+
+TEST_F(LoggerTest, backpressure_drops) {
+    struct Case {
+        Backpressure policy;
+        AsyncStaging staging;
+        int first;  //first queued message kept
+        int kept;   //queued messages kept
+    } cases[] = {
+        {Backpressure::DropNewest, AsyncStaging::Shared, 1, 3},
+        {Backpressure::DropOldest, AsyncStaging::Shared, 7, 4},
+        {Backpressure::DropOldest, AsyncStaging::PerThread, 7, 4}
+    };
+    const size_t info = static_cast<size_t>(LogLevel::Info);
+
+    for(const auto &c : cases) {
+        LogCounters before = Logger::getInstance().counters();
+
+        Logger::getInstance().setBackpressure(c.policy);
+        ASSERT_TRUE(Logger::getInstance().enableAsync(4, c.staging));
+
+        //the backend holds "0" in the logger, its slot is released once the logger returns,
+        //unless the backend copies it out for Backpressure::DropOldest
+        memory->hold();
+        Logger::getInstance().out(LogLevel::Info, "%d", 0);
+        memory->waitEntered();
+        for(int i = 1; i <= 10; ++i) {
+            Logger::getInstance().out(LogLevel::Info, "%d", i);
+        }
+        memory->release();
+        Logger::getInstance().flush();
+
+        LogCounters after = Logger::getInstance().counters();
+        auto lines = memory->lines();
+
+        ASSERT_EQ(lines.size(), c.kept + 1u);
+        ASSERT_EQ(lines[0], "0");
+        for(int i = 0; i < c.kept; ++i) {
+            ASSERT_EQ(lines[i + 1], std::to_string(c.first + i)) << "wrong messages dropped";
+        }
+        ASSERT_EQ(after.dropped[info] - before.dropped[info], 10u - c.kept);
+        ASSERT_EQ(after.emitted[info] - before.emitted[info], c.kept + 1u);
+
+        Logger::getInstance().disableAsync();
+        memory->clear();
+    }
+    Logger::getInstance().setBackpressure(Backpressure::Block);
+}
+
+TEST_F(LoggerTest, backpressure_keeps_errors_and_fatal) {
+    LogCounters before = Logger::getInstance().counters();
+
+    Logger::getInstance().setBackpressure(Backpressure::DropBelow, LogLevel::Warn);
+    ASSERT_TRUE(Logger::getInstance().enableAsync(4));
+
+    memory->hold();
+    Logger::getInstance().out(LogLevel::Info, "%d", 0);
+    memory->waitEntered();
+    for(int i = 1; i <= 3; ++i) {
+        Logger::getInstance().out(LogLevel::Info, "%d", i);
+    }
+    Logger::getInstance().out(LogLevel::Verbose, "dropped");
+    Logger::getInstance().out(LogLevel::Info, "dropped");
+
+    //waits for a free slot, and the fatal message is written before out() returns
+    std::thread caller([] {
+        Logger::getInstance().out(LogLevel::Error, "error");
+        Logger::getInstance().out(LogLevel::Fatal, "fatal");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    memory->release();
+    caller.join();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 6u);
+    ASSERT_EQ(lines[4], "error");
+    ASSERT_EQ(lines[5], "fatal") << "a fatal message should be drained synchronously";
+
+    LogCounters after = Logger::getInstance().counters();
+    ASSERT_EQ(after.dropped[static_cast<size_t>(LogLevel::Verbose)] - before.dropped[static_cast<size_t>(LogLevel::Verbose)], 1u);
+    ASSERT_EQ(after.dropped[static_cast<size_t>(LogLevel::Info)] - before.dropped[static_cast<size_t>(LogLevel::Info)], 1u);
+    ASSERT_EQ(after.dropped[static_cast<size_t>(LogLevel::Error)], before.dropped[static_cast<size_t>(LogLevel::Error)]);
+    ASSERT_EQ(after.emitted[static_cast<size_t>(LogLevel::Fatal)] - before.emitted[static_cast<size_t>(LogLevel::Fatal)], 1u);
+
+    Logger::getInstance().setBackpressure(Backpressure::Block);
+}
+
+TEST_F(LoggerTest, metrics_sum_up_threads) {
+    const int threads = 4;
+    const int count = 1000;
+    const size_t info = static_cast<size_t>(LogLevel::Info);
+    std::vector<std::thread> workers;
+    LogMetrics before = Logger::getInstance().metrics();
+
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([] {
+            for(int i = 0; i < count; ++i) {
+                Logger::getInstance().out(LogLevel::Info, "%04d", i);
+            }
+        });
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+    Logger::getInstance().out(LogLevel::Warn, "%s", std::string(2000, 'x').c_str());
+
+    LogMetrics after = Logger::getInstance().metrics();
+
+    ASSERT_EQ(after.messages[info] - before.messages[info], static_cast<uint64_t>(threads * count))
+        << "counters of exited threads should be kept";
+    ASSERT_EQ(after.bytes[info] - before.bytes[info], static_cast<uint64_t>(threads * count * 4));
+    ASSERT_EQ(after.bytes[static_cast<size_t>(LogLevel::Warn)] - before.bytes[static_cast<size_t>(LogLevel::Warn)], 2000u);
+    ASSERT_EQ(after.truncated - before.truncated, 0u) << "a message longer than the stack buffer should not be cut";
+    ASSERT_EQ(after.queued, 0u);
+
+    ASSERT_EQ(after.sinks.size(), 1u);
+    ASSERT_EQ(after.sinks[0].logger, memory.get());
+    ASSERT_EQ(after.sinks[0].count - before.sinks[0].count, static_cast<uint64_t>(threads * count + 1));
+    ASSERT_GT(after.sinks[0].percentile(0.99), 0u);
+    ASSERT_LE(after.sinks[0].percentile(0.5), after.sinks[0].percentile(0.99));
+}
+
+TEST_F(LoggerTest, metrics_queue_depth) {
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+
+    memory->hold();
+    Logger::getInstance().out(LogLevel::Info, "%d", 0);
+    memory->waitEntered();
+    for(int i = 1; i <= 5; ++i) {
+        Logger::getInstance().out(LogLevel::Info, "%d", i);
+    }
+    ASSERT_EQ(Logger::getInstance().metrics().queued, 5u);
+
+    memory->release();
+    Logger::getInstance().flush();
+    ASSERT_EQ(Logger::getInstance().metrics().queued, 0u);
+}
+
+TEST_F(LoggerTest, worker_sink_isolates_slow_logger) {
+    auto slow = std::make_shared<MemoryLogger>();
+    SinkOptions options;
+
+    options.level = LogLevel::Warn;
+    options.worker = true;
+    options.capacity = 16;
+    Logger::getInstance().registerLogger(slow, options);
+
+    //the worker holds "warn 0" in the slow logger, the other logger is written meanwhile
+    slow->hold();
+    Logger::getInstance().out(LogLevel::Warn, "warn %d", 0);
+    slow->waitEntered();
+    for(int i = 0; i < 5; ++i) {
+        Logger::getInstance().out(LogLevel::Info, "info %d", i);
+    }
+    Logger::getInstance().out(LogLevel::Warn, "warn %d", 1);
+    ASSERT_EQ(memory->lines().size(), 7u) << "a slow logger with a worker should not delay the others";
+
+    slow->release();
+    Logger::getInstance().flush();
+    ASSERT_EQ(slow->lines(), std::vector<std::string>({"warn 0", "warn 1"})) << "the level filter should apply";
+
+    Logger::getInstance().out(LogLevel::Fatal, "fatal");
+    ASSERT_EQ(slow->lines().back(), "fatal") << "a fatal message should be written before out() returns";
+
+    LogMetrics metrics = Logger::getInstance().metrics();
+    ASSERT_EQ(metrics.sinks.size(), 2u);
+    ASSERT_EQ(metrics.sinks[1].logger, slow.get());
+    ASSERT_EQ(metrics.sinks[1].count, 3u);
+
+    //the other tests expect `memory` only
+    Logger::destroyInstance();
+    Logger::getInstance().registerLogger(memory);
+}
+
+TEST_F(LoggerTest, register_while_logging) {
+    const int threads = 4;
+    std::atomic<bool> running {true};
+    std::vector<std::thread> workers;
+    auto extra = std::make_shared<MemoryLogger>();
+
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([&running] {
+            while(running.load(std::memory_order_relaxed)) {
+                Logger::getInstance().out(LogLevel::Debug, "filtered");
+                Logger::getInstance().out(LogLevel::Info, "message");
+            }
+        });
+    }
+
+    //the old lists are freed while the workers keep reading the sinks
+    for(int i = 0; i < 200; ++i) {
+        Logger::getInstance().registerLogger(extra);
+        ASSERT_TRUE(Logger::getInstance().unregisterLogger(extra));
+    }
+    running.store(false);
+    for(auto &worker : workers) {
+        worker.join();
+    }
+
+    ASSERT_FALSE(Logger::getInstance().unregisterLogger(extra)) << "the logger should not be registered any more";
+
+    size_t lines = extra->lines().size();
+    Logger::getInstance().out(LogLevel::Info, "after");
+    ASSERT_EQ(extra->lines().size(), lines) << "an unregistered logger should not be written";
+    ASSERT_EQ(memory->lines().back(), "after");
+}
+
+TEST_F(LoggerTest, long_messages_not_truncated) {
+    struct LengthLogger : ILogger {
+        virtual void out(LogLevel level, const char* str) override {
+            ADD_FAILURE() << "the logger should pass the length";
+        }
+        virtual void out(LogLevel level, const char* str, size_t len) override {
+            EXPECT_EQ(std::strlen(str), len);
+            lengths.push_back(len);
+        }
+
+        std::vector<size_t> lengths;
+    };
+    auto lengths = std::make_shared<LengthLogger>();
+    const std::string large(5000, 'x');
+    SinkOptions options;
+
+    options.worker = true;
+    options.capacity = 16;
+    Logger::getInstance().registerLogger(lengths, options);
+
+    Logger::getInstance().out(LogLevel::Info, "%s", large.c_str());
+    LOG_INFO_RAW("%s|%s", large, large.c_str());
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+    LOG_INFO_RAW("before %d", 1);
+    Logger::getInstance().out(LogLevel::Info, "%s", large.c_str());
+    LOG_INFO_RAW("%s", large);
+    LOG_INFO_RAW("after %d", 2);
+    Logger::getInstance().flush();
+
+    ASSERT_TRUE(Logger::getInstance().unregisterLogger(lengths));
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 6u);
+    ASSERT_EQ(lines[0], large);
+    ASSERT_EQ(lines[1], large + "|" + large);
+    ASSERT_EQ(lines[2], "before 1");
+    ASSERT_EQ(lines[3], large) << "a message too long for a record should keep its order";
+    ASSERT_EQ(lines[4], large);
+    ASSERT_EQ(lines[5], "after 2");
+    ASSERT_EQ(lengths->lengths, std::vector<size_t>({5000, 10001, 8, 5000, 5000, 7})) << "a logger with a worker should get long messages too";
+}
+
+TEST_F(LoggerTest, tsc_clock_follows_monotonic) {
+    auto steady = [] {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    auto system = [] {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    };
+
+    int64_t begin = steady();
+    int64_t tscBegin = TscClock::now().time_since_epoch().count();
+    ASSERT_LT(std::abs(tscBegin - begin), 1000000) << "TscClock should follow CLOCK_MONOTONIC";
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    int64_t tscEnd = TscClock::now().time_since_epoch().count();
+    int64_t end = steady();
+    ASSERT_LT(std::abs((tscEnd - tscBegin) - (end - begin)), (end - begin) / 100) << "the measured rate should be within 1%";
+
+    TscClock::calibrate();
+    ASSERT_GE(TscClock::now().time_since_epoch().count(), tscEnd - 100000) << "calibration should not move the clock back";
+    ASSERT_LT(std::abs(TscClock::toSystemNanoseconds(TscClock::ticks()) - system()), 1000000);
+}
+
+TEST_F(LoggerTest, tsc_record_timestamps) {
+    struct TimestampLogger : RecordLogger {
+        virtual void out(LogLevel level, const char* str) override {}
+        virtual void out(const LogRecord &record) override {
+            timestamps.push_back(record.timestamp);
+        }
+
+        std::vector<int64_t> timestamps;
+    };
+    auto stamps = std::make_shared<TimestampLogger>();
+    auto workerStamps = std::make_shared<TimestampLogger>();
+    auto system = [] {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    };
+
+    SinkOptions options;
+    options.worker = true;
+
+    Logger::getInstance().registerLogger(stamps);
+    Logger::getInstance().setClock(LogClock::Tsc);
+    Logger::getInstance().registerLogger(workerStamps, options);
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+
+    int64_t begin = system();
+    for(int i = 0; i < 10; ++i) {
+        LOG_INFO_RAW("tsc %d", i);
+    }
+    int64_t end = system();
+    Logger::getInstance().flush();
+
+    Logger::getInstance().setClock(LogClock::System);
+    ASSERT_TRUE(Logger::getInstance().unregisterLogger(stamps));
+    ASSERT_TRUE(Logger::getInstance().unregisterLogger(workerStamps));
+
+    //a worker gets the records converted by the backend and must not convert them again
+    ASSERT_EQ(workerStamps->timestamps, stamps->timestamps);
+    ASSERT_EQ(stamps->timestamps.size(), 10u);
+    for(int64_t timestamp : stamps->timestamps) {
+        //the rate was measured for 2ms only, allow for its error and the clock reads around the calls
+        ASSERT_GT(timestamp, begin - 1000000) << "the backend should convert the ticks to system time";
+        ASSERT_LT(timestamp, end + 1000000) << "the backend should convert the ticks to system time";
+    }
+    ASSERT_TRUE(std::is_sorted(stamps->timestamps.begin(), stamps->timestamps.end()));
+}
+
+TEST_F(LoggerTest, loggers_get_time_of_call) {
+    struct TimeLogger : ILogger {
+        virtual void out(LogLevel level, const char* str) override {
+            ADD_FAILURE() << "the logger should get the time of the call";
+        }
+        virtual void out(LogLevel level, int64_t timestamp, const char* str, size_t len) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            timestamps.push_back(timestamp);
+        }
+
+        std::mutex mutex;
+        std::vector<int64_t> timestamps;
+    };
+    auto direct = std::make_shared<TimeLogger>();
+    auto worker = std::make_shared<TimeLogger>();
+    auto system = [] {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    };
+    SinkOptions options;
+    options.worker = true;
+
+    //registered after memory, which holds the backend thread before it writes to them
+    Logger::getInstance().registerLogger(direct);
+    Logger::getInstance().registerLogger(worker, options);
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+
+    memory->hold();
+    int64_t begin = system();
+    LOG_INFO_RAW("held %d", 1);
+    int64_t end = system();
+    memory->waitEntered();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    memory->release();
+    Logger::getInstance().flush();
+
+    ASSERT_TRUE(Logger::getInstance().unregisterLogger(direct));
+    ASSERT_TRUE(Logger::getInstance().unregisterLogger(worker));
+
+    for(auto logger : {direct, worker}) {
+        ASSERT_EQ(logger->timestamps.size(), 1u);
+        ASSERT_GE(logger->timestamps[0], begin) << "the timestamp should be taken at the call, not at the write";
+        ASSERT_LE(logger->timestamps[0], end) << "the timestamp should be taken at the call, not at the write";
+    }
+}
+
+TEST_F(LoggerTest, log_pattern_layout) {
+    LogPattern pattern("%D %T.%e|%u|%N [%l] [%t] [%P] %v %% %q");
+    const int64_t timestamp = 1700000000123456789;
+    time_t second = 1700000000;
+    struct tm tm;
+    char date[64];
+    char buf[256];
+
+    localtime_r(&second, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+
+    std::string ids = "[" + std::to_string(syscall(SYS_gettid)) + "] [" + std::to_string(getpid()) + "]";
+
+    size_t len = pattern.format(LogLevel::Warn, timestamp, "message", 7, buf, sizeof(buf));
+    ASSERT_EQ(std::string(buf, len), std::string(date) + ".123|123456|123456789 [WARN] " + ids + " message % %q");
+
+    //the same second is copied from the cache, only the fraction changes
+    len = pattern.format(LogLevel::Info, timestamp + 876543210, "next", 4, buf, sizeof(buf));
+    ASSERT_EQ(std::string(buf, len), std::string(date) + ".999|999999|999999999 [INFO] " + ids + " next % %q");
+
+    second += 1;
+    localtime_r(&second, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+
+    len = pattern.format(LogLevel::Info, timestamp + 1000000000, "later", 5, buf, sizeof(buf));
+    ASSERT_EQ(std::string(buf, len), std::string(date) + ".123|123456|123456789 [INFO] " + ids + " later % %q");
+
+    len = LogPattern().format(LogLevel::Error, timestamp, "default", 7, buf, sizeof(buf));
+    ASSERT_EQ(std::string(buf, len), "[ERROR]default") << "the default pattern should print lines as before";
+}
+
+TEST_F(LoggerTest, rate_limited_counts) {
+    for(int i = 0; i < 10; ++i) {
+        LOG_EVERY_N(Info, 3, "every %d", i);
+        LOG_FIRST_N(Info, 2, "first %d", i);
+        LOG_RATE_LIMITED(Info, 0.001, 3, "bucket %d", i);
+    }
+
+    std::vector<std::string> messages;
+    for(auto &line : memory->lines()) {
+        //rate_limited_count_summary checks the summaries
+        if(line.find("] suppressed ") == std::string::npos) {
+            messages.push_back(line.substr(line.find("] ") + 2));
+        }
+    }
+
+    std::vector<std::string> expected {"every 0", "first 0", "bucket 0", "first 1", "bucket 1", "bucket 2",
+                                       "every 3", "every 6", "every 9"};
+    ASSERT_EQ(messages, expected);
+}
+
+TEST_F(LoggerTest, rate_limited_count_summary) {
+    for(int i = 0; i < 7; ++i) {
+        LOG_EVERY_N(Info, 3, "every %d", i);
+    }
+    for(int i = 0; i < 10; ++i) {
+        LOG_FIRST_N(Info, 2, "first %d", i);
+    }
+    for(int i = 0; i < 3; ++i) {
+        LOG_EVERY_N(Info, 0, "always %d", i);
+        LOG_FIRST_N(Info, 0, "never %d", i);
+        LOG_RATE_LIMITED(Info, 0, 1, "once %d", i);
+        LOG_RATE_LIMITED(Info, -1.0, 1, "once %d", i);
+    }
+
+    std::vector<std::string> messages;
+    for(auto &line : memory->lines()) {
+        messages.push_back(line.substr(line.find("] ") + 2));
+    }
+
+    //LOG_FIRST_N reports when 2, 4 and 8 calls have been suppressed
+    std::vector<std::string> expected {"every 0", "suppressed 2 messages", "every 3", "suppressed 2 messages", "every 6",
+                                       "first 0", "first 1", "suppressed 2 messages", "suppressed 2 messages", "suppressed 4 messages",
+                                       "always 0", "suppressed 1 message", "once 0", "once 0",
+                                       "always 1", "suppressed 1 message", "always 2"};
+    ASSERT_EQ(messages, expected);
+}
+
+TEST_F(LoggerTest, rate_limited_summary) {
+    auto log = [](int i) {
+        LOG_EVERY_T(Warn, std::chrono::milliseconds(100), "overflow %d", i);
+    };
+
+    for(int i = 0; i < 5; ++i) {
+        log(i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    log(5);
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 3u);
+    ASSERT_NE(lines[0].find("][operator()] overflow 0"), std::string::npos) << lines[0];
+    ASSERT_NE(lines[1].find("][operator()] suppressed 4 messages"), std::string::npos) << lines[1];
+    ASSERT_NE(lines[2].find("][operator()] overflow 5"), std::string::npos) << lines[2];
+}
+
+TEST_F(LoggerTest, deferred_matches_sync) {
+    const char *name = "eth0";
+    std::string filter = "tcp port 443";
+
+    auto log = [&] {
+        LOG_INFO("capture %s filter %s len %u ratio %.2f", name, filter, 1500u, 0.25);
+        LOG_INFO_RAW("raw %d%%", 100);
+    };
+
+    log();
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+    log();
+    Logger::getInstance().flush();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 4u);
+    ASSERT_EQ(lines[0], lines[2]) << "deferred formatting should produce the same message";
+    ASSERT_EQ(lines[1], lines[3]) << "deferred formatting should produce the same message";
+    ASSERT_EQ(lines[1], "raw 100%");
+    ASSERT_NE(lines[0].find("][operator()] capture eth0 filter tcp port 443 len 1500 ratio 0.25"), std::string::npos) << lines[0];
+}
+
+TEST_F(LoggerTest, deferred_copies_strings) {
+    char buf[32] = "before";
+
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+
+    LOG_INFO_RAW("%s", buf);
+    std::strcpy(buf, "after");
+    LOG_INFO_RAW("%s %s", buf, static_cast<const char*>(nullptr));
+
+    Logger::getInstance().flush();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 2u);
+    ASSERT_EQ(lines[0], "before") << "string arguments should be copied at the call site";
+    ASSERT_EQ(lines[1], "after (null)");
+}
+
+TEST_F(LoggerTest, kv_matches_sync) {
+    std::string iface = "eth 0";
+
+    auto log = [&] {
+        LOG_INFO_KV("packet", "caplen", 60u, "len", -4, "iface", iface, "ratio", 0.5);
+        LOG_WARN_KV("drop");
+    };
+
+    log();
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+    log();
+    Logger::getInstance().flush();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 4u);
+    ASSERT_EQ(lines[0], lines[2]) << "deferred formatting should produce the same message";
+    ASSERT_EQ(lines[1], lines[3]) << "deferred formatting should produce the same message";
+    ASSERT_NE(lines[0].find("][operator()] packet caplen=60 len=-4 iface=\"eth 0\" ratio=0.5"), std::string::npos) << lines[0];
+    ASSERT_NE(lines[1].find("][operator()] drop"), std::string::npos) << lines[1];
+}
+
+TEST_F(LoggerTest, deferred_runtime_format) {
+    std::string suffix = "suffix";
+
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+
+    LOG_INFO_RAW("runtime " + suffix + " %d", 7);
+
+    Logger::getInstance().flush();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 1u);
+    ASSERT_EQ(lines[0], "runtime suffix 7");
+}
+
+TEST_F(LoggerTest, hexdump_matches_printf) {
+    uint8_t data[40];
+
+    for(size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = static_cast<uint8_t>(i * 37 + 0x1b);
+    }
+
+    for(size_t len = 0; len <= sizeof(data); ++len) {
+        std::string expected;
+        char line[128];
+
+        for(size_t offset = 0; offset < len; offset += 16) {
+            int n = std::snprintf(line, sizeof(line), "%s%08zx ", offset > 0 ? "\n" : "", offset);
+            for(size_t i = 0; i < 16; ++i) {
+                n += offset + i < len ? std::snprintf(line + n, sizeof(line) - n, "%s %02x", i == 8 ? " " : "", data[offset + i])
+                                      : std::snprintf(line + n, sizeof(line) - n, "%s   ", i == 8 ? " " : "");
+            }
+            n += std::snprintf(line + n, sizeof(line) - n, "  |");
+            for(size_t i = offset; i < std::min(len, offset + 16); ++i) {
+                line[n++] = data[i] >= 0x20 && data[i] < 0x7f ? data[i] : '.';
+            }
+            line[n++] = '|';
+            expected.append(line, n);
+        }
+
+        char buf[256];
+        ASSERT_EQ(HexDump::write(data, len, buf, sizeof(buf)), expected.size());
+        ASSERT_EQ(buf, expected) << len << " bytes";
+        ASSERT_EQ(HexDump::length(len), expected.size());
+
+        //only whole lines are written to a short buffer
+        ASSERT_EQ(HexDump::write(data, len, buf, HexDump::LINE_SIZE + 1), expected.size());
+        ASSERT_EQ(buf, expected.substr(0, len > 16 ? HexDump::LINE_SIZE : expected.size()));
+    }
+}
+
+TEST_F(LoggerTest, hexdump_macro) {
+    std::vector<uint8_t> data(100);
+
+    for(size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+
+    auto log = [&] {
+        LOG_HEXDUMP(Info, data.data(), data.size(), 20);
+        LOG_HEXDUMP(Info, data.data(), 3, 64);
+    };
+
+    log();
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+    log();
+    Logger::getInstance().flush();
+
+    char dump[256];
+    HexDump::write(data.data(), 20, dump, sizeof(dump));
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 4u);
+    ASSERT_EQ(lines[0], lines[2]) << "deferred formatting should produce the same message";
+    ASSERT_EQ(lines[1], lines[3]) << "deferred formatting should produce the same message";
+    ASSERT_NE(lines[0].find("][operator()] hexdump of 100 bytes, first 20\n" + std::string(dump)), std::string::npos) << lines[0];
+    ASSERT_NE(lines[1].find("][operator()] hexdump of 3 bytes\n00000000  00 01 02  "), std::string::npos) << lines[1];
+}
+
+TEST_F(LoggerTest, log_context_prefix) {
+    std::string iface = "eth 0";
+
+    auto log = [&] {
+        LOG_INFO_RAW("before");
+        {
+            LogContext context("iface", iface, "session", 7);
+            LOG_INFO_RAW("packet %d", 1);
+            {
+                LogContext inner("timer", "retry");
+                LOG_INFO_KV("retry", "count", 2);
+                LOG_HEXDUMP(Info, "ab", 2, 2);
+            }
+            LOG_INFO_RAW("packet " + std::to_string(2));
+            //other threads don't see the context
+            std::thread([] { LOG_INFO_RAW("thread"); }).join();
+        }
+        LOG_INFO_RAW("after");
+    };
+
+    log();
+    ASSERT_TRUE(Logger::getInstance().enableAsync(16));
+    log();
+    Logger::getInstance().flush();
+
+    auto lines = memory->lines();
+    ASSERT_EQ(lines.size(), 14u);
+    for(size_t i = 0; i < 7; ++i) {
+        ASSERT_EQ(lines[i], lines[i + 7]) << "deferred formatting should produce the same message";
+    }
+    ASSERT_EQ(lines[0], "before");
+    ASSERT_EQ(lines[1], "[iface=\"eth 0\" session=7] packet 1");
+    ASSERT_EQ(lines[2].find("[iface=\"eth 0\" session=7 timer=retry] ["), 0u) << lines[2];
+    ASSERT_NE(lines[2].find("][operator()] retry count=2"), std::string::npos) << lines[2];
+    ASSERT_EQ(lines[3].find("[iface=\"eth 0\" session=7 timer=retry] ["), 0u) << lines[3];
+    ASSERT_NE(lines[3].find("][operator()] hexdump of 2 bytes\n00000000  61 62"), std::string::npos) << lines[3];
+    ASSERT_EQ(lines[4], "[iface=\"eth 0\" session=7] packet 2");
+    ASSERT_EQ(lines[5], "thread");
+    ASSERT_EQ(lines[6], "after");
+}
+
+TEST_F(LoggerTest, log_context_cut) {
+    std::string value(LogContext::MAX_SIZE, 'x');
+    size_t len;
+
+    {
+        LogContext outer("a", 1);
+        {
+            LogContext context("long", value);
+            LogContext::current(len);
+            ASSERT_EQ(len, LogContext::MAX_SIZE - 1);
+            {
+                LogContext full("b", 2);
+                ASSERT_EQ(std::string(LogContext::current(len)).substr(LogContext::MAX_SIZE - 4), "x] ");
+            }
+        }
+        ASSERT_EQ(std::string(LogContext::current(len)), "[a=1] ");
+    }
+    ASSERT_EQ(std::string(LogContext::current(len)), "");
+    ASSERT_EQ(len, 0u);
+}
+
+} //namespace util
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+
+    util::Logger::getInstance().registerLogger(util::LoggerTest::memory);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,715 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <gtest/gtest.h>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <sstream>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <glob.h>
+#include <zlib.h>
+
+#include "fd_logger.hpp"
+#include "rotating_logger.hpp"
+#include "mmap_logger.hpp"
+#include "binary_logger.hpp"
+#include "flight_recorder.hpp"
+#include "structured_logger.hpp"
+#include "recent_log.hpp"
+#include "shm_logger.hpp"
+
+namespace util {
+
+namespace {
+/**
+ * Record of a LOG_* call as Logger hands it to a RecordLogger
+ */
+template<typename Format, typename... Args>
+LogRecord makeRecord(const LogSite &site, const Format &format, int64_t timestamp, const Args&... args) {
+    using Capture = LogCapture<typename CaptureType<Args>::type...>;
+    LogRecord record;
+
+    static_assert(std::is_same<typename Format::Arguments, std::tuple<typename CaptureType<Args>::type...>>::value,
+                  "format was compiled for other argument types");
+
+    record.level = site.level;
+    record.sequence = 0;
+    record.timestamp = timestamp;
+    record.site = &site;
+    record.format = &format;
+    record.formatter = &Capture::template format<Format>;
+    record.length = Capture::encode(record.payload, args...);
+    return record;
+}
+}
+
+class SinkTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char name[] = "/tmp/sink_test.XXXXXX";
+
+        ASSERT_NE(mkdtemp(name), nullptr);
+        dir_ = name;
+        path_ = dir_ + "/test.log";
+    }
+
+    void TearDown() override {
+        for(auto &file : files("*")) {
+            unlink(file.c_str());
+        }
+        rmdir(dir_.c_str());
+    }
+
+    std::string content(const std::string &path) {
+        std::ifstream in(path);
+        std::stringstream ss;
+
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    std::string content() {
+        return content(path_);
+    }
+
+    std::string gzContent(const std::string &path) {
+        std::string text;
+        char buf[4096];
+        int len;
+        gzFile in = gzopen(path.c_str(), "rb");
+
+        if(in == nullptr) {
+            return text;
+        }
+        while((len = gzread(in, buf, sizeof(buf))) > 0) {
+            text.append(buf, len);
+        }
+        gzclose(in);
+        return text;
+    }
+
+    std::vector<std::string> files(const std::string &pattern) {
+        std::vector<std::string> found;
+        glob_t result;
+
+        if(glob((dir_ + "/" + pattern).c_str(), 0, nullptr, &result) == 0) {
+            found.assign(result.gl_pathv, result.gl_pathv + result.gl_pathc);
+        }
+        globfree(&result);
+        return found;
+    }
+
+    std::string dir_;
+    std::string path_;
+};
+
+TEST_F(SinkTest, fd_logger_batches_lines) {
+    FlushPolicy policy;
+    policy.interval = std::chrono::hours(1);
+    policy.level = LogLevel::Fatal;
+
+    FdLogger logger(path_, policy);
+    ASSERT_TRUE(logger.isOpen());
+
+    logger.out(LogLevel::Info, "first");
+    logger.out(LogLevel::Warn, "second");
+    ASSERT_EQ(content(), "") << "lines should stay in the buffer until it is flushed";
+
+    logger.flush();
+    ASSERT_EQ(content(), "[INFO]first\n[WARN]second\n");
+}
+
+TEST_F(SinkTest, fd_logger_writes_errors_at_once) {
+    FlushPolicy policy;
+    policy.interval = std::chrono::hours(1);
+
+    FdLogger logger(path_, policy);
+
+    logger.out(LogLevel::Info, "queued");
+    logger.out(LogLevel::Error, "failed");
+    ASSERT_EQ(content(), "[INFO]queued\n[ERROR]failed\n") << "an error should write the buffer at once";
+}
+
+TEST_F(SinkTest, fd_logger_writes_after_interval) {
+    FlushPolicy policy;
+    policy.interval = std::chrono::milliseconds(20);
+    policy.level = LogLevel::Fatal;
+
+    FdLogger logger(path_, policy);
+
+    //no line follows, the thread of the logger writes it
+    logger.out(LogLevel::Info, "quiet");
+    for(int i = 0; i < 200 && content().empty(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(content(), "[INFO]quiet\n") << "a buffered line should be written when the interval has passed";
+}
+
+TEST_F(SinkTest, fd_logger_flushed_at_exit) {
+    pid_t pid = fork();
+
+    ASSERT_GE(pid, 0);
+    if(pid == 0) {
+        FlushPolicy policy;
+        policy.interval = std::chrono::hours(1);
+
+        Logger::getInstance().registerLogger(std::make_shared<FdLogger>(path_, policy));
+        LOG_INFO_RAW("before exit");
+        exit(0);
+    }
+
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ASSERT_EQ(content(), "[INFO]before exit\n") << "buffered lines should be written at exit in synchronous mode";
+}
+
+TEST_F(SinkTest, fd_logger_line_larger_than_buffer) {
+    FlushPolicy policy;
+    policy.bytes = 16;
+    policy.interval = std::chrono::hours(1);
+    policy.level = LogLevel::Fatal;
+
+    std::string large(100, 'x');
+    {
+        FdLogger logger(path_, policy);
+
+        logger.out(LogLevel::Info, "a");
+        logger.out(LogLevel::Info, large.c_str());
+        ASSERT_EQ(content(), "[INFO]a\n[INFO]" + large + "\n");
+
+        logger.out(LogLevel::Info, "b");
+    }
+    ASSERT_EQ(content(), "[INFO]a\n[INFO]" + large + "\n[INFO]b\n") << "buffered lines should be written on destruction";
+}
+
+TEST_F(SinkTest, rotating_logger_keeps_every_line) {
+    RotationPolicy rotation;
+    rotation.maxBytes = 200;
+    std::string expected;
+    {
+        RotatingFileLogger logger(path_, rotation);
+
+        for(int i = 0; i < 300; ++i) {
+            std::string line = "line " + std::to_string(i);
+
+            logger.out(LogLevel::Info, line.c_str());
+            expected += "[INFO]" + line + "\n";
+
+            //rotation is postponed while the background thread prepares the next file
+            logger.wait();
+        }
+        logger.flush();
+        logger.wait();
+        ASSERT_GT(logger.rotations(), rotation.maxSegments);
+    }
+
+    auto segments = files("test.log.*.gz");
+    ASSERT_EQ(segments.size(), 10u) << "only maxSegments segments should be kept";
+    ASSERT_TRUE(files("test.log.*[0-9]").empty()) << "rotated segments should be compressed";
+
+    //the kept segments and the current file are the tail of the lines, in order
+    std::string text;
+    for(size_t index = 1; text.size() < expected.size(); ++index) {
+        std::string segment = path_ + "." + std::to_string(index) + ".gz";
+        if(std::find(segments.begin(), segments.end(), segment) == segments.end()) {
+            if(!text.empty()) {
+                break;
+            }
+            continue;
+        }
+        text += gzContent(segment);
+    }
+    text += content();
+
+    ASSERT_FALSE(text.empty());
+    ASSERT_EQ(expected.substr(expected.size() - text.size()), text);
+    ASSERT_EQ(text.find("[INFO]"), 0u) << "a segment should start with a whole line";
+}
+
+TEST_F(SinkTest, rotating_logger_continues_numbering) {
+    RotationPolicy rotation;
+    rotation.compress = false;
+    {
+        RotatingFileLogger logger(path_, rotation);
+
+        logger.out(LogLevel::Info, "first");
+        logger.rotate();
+        logger.wait();
+    }
+    {
+        RotatingFileLogger logger(path_, rotation);
+
+        logger.out(LogLevel::Info, "second");
+        logger.rotate();
+        logger.wait();
+    }
+
+    ASSERT_EQ(content(path_ + ".1"), "[INFO]first\n");
+    ASSERT_EQ(content(path_ + ".2"), "[INFO]second\n");
+    ASSERT_EQ(content(), "");
+}
+
+TEST_F(SinkTest, mmap_logger_truncates_on_destruction) {
+    {
+        MmapLogger logger(path_);
+        ASSERT_TRUE(logger.isOpen());
+
+        logger.out(LogLevel::Info, "first");
+        logger.out(LogLevel::Warn, "second");
+        ASSERT_EQ(content().substr(0, 25), "[INFO]first\n[WARN]second\n") << "lines should be in the file without a flush";
+    }
+    ASSERT_EQ(content(), "[INFO]first\n[WARN]second\n");
+
+    {
+        MmapLogger logger(path_);
+
+        logger.out(LogLevel::Info, "third");
+    }
+    ASSERT_EQ(content(), "[INFO]first\n[WARN]second\n[INFO]third\n") << "a logger should append to an existing file";
+}
+
+TEST_F(SinkTest, mmap_logger_skips_zeros_of_unclean_shutdown) {
+    {
+        std::ofstream out(path_);
+
+        out << "[INFO]first\n" << std::string(10000, '\0');
+    }
+    {
+        MmapLogger logger(path_);
+
+        logger.out(LogLevel::Info, "second");
+    }
+    ASSERT_EQ(content(), "[INFO]first\n[INFO]second\n");
+}
+
+TEST_F(SinkTest, mmap_logger_moves_to_next_window) {
+    const int THREADS = 4;
+    const int LINES = 2000;
+    size_t remaps;
+    {
+        MmapLogger logger(path_, 8 * 1024);
+        std::vector<std::thread> threads;
+
+        for(int t = 0; t < THREADS; ++t) {
+            threads.emplace_back([&logger, t] {
+                for(int i = 0; i < LINES; ++i) {
+                    std::string line = std::to_string(t) + " " + std::to_string(i);
+                    logger.out(LogLevel::Info, line.c_str());
+                }
+            });
+        }
+        for(auto &thread : threads) {
+            thread.join();
+        }
+        remaps = logger.remaps();
+    }
+    ASSERT_GT(remaps, 10u);
+
+    //every line is kept once, and the lines of a thread are in order
+    std::stringstream text(content());
+    std::string line;
+    std::vector<int> next(THREADS, 0);
+
+    while(std::getline(text, line)) {
+        int t, i;
+
+        ASSERT_EQ(sscanf(line.c_str(), "[INFO]%d %d", &t, &i), 2) << "broken line : " << line;
+        ASSERT_EQ(i, next[t]++);
+    }
+    for(int t = 0; t < THREADS; ++t) {
+        ASSERT_EQ(next[t], LINES);
+    }
+}
+
+TEST_F(SinkTest, binary_logger_decodes_to_text) {
+    static LogSite site {"sink_test.cc", 42, "binary", LogLevel::Info, true, {LogSite::ENABLED}};
+    static LogSite raw {"sink_test.cc", 43, "binary", LogLevel::Warn, false, {LogSite::ENABLED}};
+    static constexpr const char *str = "packet %d of %u bytes from %s, %.2f%% %c %#lx %p";
+    static constexpr CompiledFormat<countFormatOps(str), int, unsigned, const char*, double, char, long, const void*> format {str};
+    static constexpr CompiledFormat<countFormatOps("%-6s|%5hd|%llu"), std::string, short, uint64_t> other {"%-6s|%5hd|%llu"};
+    static const KvFormat<const char*, uint16_t, double> event("packet", "src", "len", "ratio");
+
+    FlushPolicy policy;
+    policy.bytes = 256;
+    policy.interval = std::chrono::hours(1);
+    policy.level = LogLevel::Fatal;
+
+    std::string expected;
+    char buf[LogRecord::PAYLOAD_SIZE];
+    auto log = [&](BinaryLogger &logger, const LogRecord &record) {
+        record.formatter(record, buf, sizeof(buf));
+        expected += std::string(LOG_LEVEL_TAGS[static_cast<int>(record.level)].str) + buf + "\n";
+        logger.out(record);
+    };
+
+    //the second logger starts a new session with its own site ids
+    for(int session = 0; session < 2; ++session) {
+        BinaryLogger logger(path_, policy);
+        ASSERT_TRUE(logger.isOpen());
+
+        for(int i = 0; i < 200; ++i) {
+            log(logger, makeRecord(site, format, 1000 + i, i - 100, 1514u, "10.0.0.1", i / 3.0, static_cast<char>('a' + i % 26), -i * 1000L, static_cast<const void*>(&site)));
+            log(logger, makeRecord(raw, other, 900 + i, std::string(i % 7, 'y'), static_cast<short>(-i), UINT64_MAX - i));
+            if(i % 50 == 0) {
+                log(logger, makeRecord(site, event, 950 + i, "10.0.0.1", static_cast<uint16_t>(i), -0.5));
+                logger.out(LogLevel::Error, "plain text");
+                expected += "[ERROR]plain text\n";
+            }
+        }
+        ASSERT_LT(logger.bytes() * 2, expected.size() / (session + 1)) << "the binary log should be smaller than the text";
+    }
+
+    for(unsigned threads : {1u, 3u}) {
+        std::string decoded = dir_ + "/decoded.txt";
+        std::FILE *out = std::fopen(decoded.c_str(), "w");
+        BinaryLogReader reader(path_);
+
+        ASSERT_TRUE(reader.decode(out, threads));
+        std::fclose(out);
+        ASSERT_EQ(content(decoded), expected) << "decoded with " << threads << " threads";
+    }
+}
+
+TEST_F(SinkTest, structured_logger_encodes_fields) {
+    static LogSite site {"sink_test.cc", 42, "capture", LogLevel::Info, true, {LogSite::ENABLED}};
+    static const KvFormat<unsigned, int, const char*, double, const void*> event("packet", "caplen", "delta", "iface", "ratio", "ctx");
+    static constexpr CompiledFormat<countFormatOps("read %d bytes"), int> format {"read %d bytes"};
+    const int64_t timestamp = 1700000000123456789;
+
+    FlushPolicy policy;
+    policy.level = LogLevel::Debug;
+
+    {
+        StructuredLogger logger(path_, LogEncoding::Json, policy);
+        ASSERT_TRUE(logger.isOpen());
+
+        logger.out(makeRecord(site, event, timestamp, 60u, -4, "eth\"0\"\n", 0.25, static_cast<const void*>(nullptr)));
+        logger.out(makeRecord(site, format, timestamp + 1000, 1514));
+    }
+    ASSERT_EQ(content(),
+              "{\"ts\":\"2023-11-14T22:13:20.123456789Z\",\"level\":\"info\",\"src\":\"sink_test.cc:42\",\"func\":\"capture\","
+              "\"event\":\"packet\",\"caplen\":60,\"delta\":-4,\"iface\":\"eth\\\"0\\\"\\n\",\"ratio\":0.25,\"ctx\":\"(nil)\"}\n"
+              "{\"ts\":\"2023-11-14T22:13:20.123457789Z\",\"level\":\"info\",\"src\":\"sink_test.cc:42\",\"func\":\"capture\","
+              "\"msg\":\"read 1514 bytes\"}\n");
+
+    unlink(path_.c_str());
+    {
+        StructuredLogger logger(path_, LogEncoding::Logfmt, policy);
+
+        logger.out(makeRecord(site, event, timestamp, 60u, -4, "eth0", 0.25, static_cast<const void*>(nullptr)));
+        logger.out(makeRecord(site, event, timestamp, 0u, 0, "", -1.5, static_cast<const void*>(nullptr)));
+        logger.out(makeRecord(site, format, timestamp, 1514));
+    }
+    ASSERT_EQ(content(),
+              "ts=2023-11-14T22:13:20.123456789Z level=info src=sink_test.cc:42 func=capture event=packet caplen=60 delta=-4 iface=eth0 ratio=0.25 ctx=(nil)\n"
+              "ts=2023-11-14T22:13:20.123456789Z level=info src=sink_test.cc:42 func=capture event=packet caplen=0 delta=0 iface=\"\" ratio=-1.5 ctx=(nil)\n"
+              "ts=2023-11-14T22:13:20.123456789Z level=info src=sink_test.cc:42 func=capture msg=\"read 1514 bytes\"\n");
+}
+
+TEST_F(SinkTest, flight_recorder_keeps_latest_lines) {
+    FlightRecorder recorder("sink_test_flight", 16 * 1024);
+    ASSERT_TRUE(recorder.isOpen());
+
+    std::vector<std::string> lines;
+    for(int i = 0; i < 500; ++i) {
+        std::string line = "line " + std::to_string(i);
+
+        //a long line takes several slots
+        if(i % 10 == 0) {
+            line += " " + std::string(600, 'a' + i % 26);
+        }
+        recorder.out(LogLevel::Info, line.c_str());
+        lines.push_back("[INFO]" + line + "\n");
+    }
+
+    std::string dumped = dir_ + "/dump.txt";
+    int fd = open(dumped.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    ASSERT_TRUE(recorder.dump(fd));
+    close(fd);
+
+    //whole lines, the newest ones, in order
+    std::string text = content(dumped);
+    std::string expected;
+
+    for(auto line = lines.rbegin(); line != lines.rend() && expected.size() + line->size() <= text.size(); ++line) {
+        expected = *line + expected;
+    }
+    ASSERT_GT(text.size(), 2 * 1024u);
+    ASSERT_EQ(text, expected);
+}
+
+TEST_F(SinkTest, flight_recorder_survives_crash) {
+    std::string crash = dir_ + "/crash.txt";
+    pid_t pid = fork();
+
+    ASSERT_GE(pid, 0);
+    if(pid == 0) {
+        FlightRecorder recorder("sink_test_crash", 16 * 1024);
+
+        recorder.dumpOnCrash(crash);
+        recorder.out(LogLevel::Info, "before crash");
+        recorder.out(LogLevel::Fatal, "about to abort");
+        abort();
+    }
+
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT) << "the signal should still terminate the process";
+
+    //the crash dump has a timestamp before every line
+    std::string text = content(crash);
+    ASSERT_NE(text.find(" [INFO]before crash\n"), std::string::npos) << text;
+    ASSERT_NE(text.find(" [FATAL]about to abort\n"), std::string::npos) << text;
+
+    //the segment of the dead process is still there
+    std::string dumped = dir_ + "/segment.txt";
+    int fd = open(dumped.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    ASSERT_TRUE(FlightRecorder::dump("sink_test_crash", fd));
+    close(fd);
+    ASSERT_TRUE(FlightRecorder::remove("sink_test_crash"));
+    ASSERT_EQ(content(dumped), "[INFO]before crash\n[FATAL]about to abort\n");
+}
+
+TEST_F(SinkTest, find_text_matches_string_find) {
+    std::mt19937 random(7);
+    std::string text(300, ' ');
+
+    for(char &c : text) {
+        c = "abc"[random() % 3];
+    }
+    for(int i = 0; i < 2000; ++i) {
+        size_t begin = random() % text.size();
+        size_t len = random() % (text.size() - begin + 1);
+        std::string pattern(random() % 6 + 1, ' ');
+
+        for(char &c : pattern) {
+            c = "abc"[random() % 3];
+        }
+
+        const char *found = findText(text.data() + begin, len, pattern.data(), pattern.size());
+        size_t expected = text.substr(begin, len).find(pattern);
+
+        ASSERT_EQ(found ? static_cast<size_t>(found - text.data() - begin) : std::string::npos, expected)
+            << "pattern " << pattern << " in " << text.substr(begin, len);
+    }
+    ASSERT_EQ(findText(text.data(), text.size(), "", 0), text.data()) << "an empty pattern should match at once";
+}
+
+TEST_F(SinkTest, recent_log_queries) {
+    RecentLog recent(64 * 1024);
+
+    for(int i = 0; i < 100; ++i) {
+        recent.out(i % 10 == 0 ? LogLevel::Error : LogLevel::Info, ("packet " + std::to_string(i) + " len " + std::to_string(60 + i)).c_str());
+    }
+    recent.out(LogLevel::Warn, ("long " + std::string(1000, 'x') + " end").c_str());
+
+    RecentLogQuery query;
+    auto all = recent.query(query);
+    ASSERT_EQ(all.size(), 101u);
+    ASSERT_EQ(all[0].text, "packet 0 len 60");
+    ASSERT_EQ(all[100].text, "long " + std::string(1000, 'x') + " end") << "a long message should take several slots";
+    ASSERT_TRUE(std::is_sorted(all.begin(), all.end(), [](const RecentLogEntry &a, const RecentLogEntry &b) { return a.timestamp < b.timestamp; }));
+
+    query.level = LogLevel::Error;
+    auto errors = recent.query(query);
+    ASSERT_EQ(errors.size(), 10u);
+    ASSERT_EQ(errors[1].text, "packet 10 len 70");
+
+    query = RecentLogQuery();
+    query.text = "len 15";
+    auto found = recent.query(query);
+    ASSERT_EQ(found.size(), 10u) << "len 150 to 159";
+    ASSERT_EQ(found[0].text, "packet 90 len 150");
+
+    query.text.clear();
+    query.regex = "^packet [0-9]*7 len";
+    query.limit = 3;
+    found = recent.query(query);
+    ASSERT_EQ(found.size(), 3u) << "the newest ones should be kept";
+    ASSERT_EQ(found[2].text, "packet 97 len 157");
+
+    query = RecentLogQuery();
+    query.from = all[50].timestamp;
+    query.to = all[50].timestamp + 1;
+    found = recent.query(query);
+    ASSERT_FALSE(found.empty());
+    for(auto &entry : found) {
+        ASSERT_EQ(entry.timestamp, all[50].timestamp);
+    }
+}
+
+TEST_F(SinkTest, recent_log_query_while_logging) {
+    RecentLog recent(16 * 1024);
+    std::atomic<bool> running {true};
+    std::vector<std::thread> writers;
+
+    //a message repeats its thread number, a torn copy would mix them
+    for(int t = 0; t < 4; ++t) {
+        writers.emplace_back([&, t] {
+            std::string message(100 + t * 200, 'a' + t);
+
+            while(running.load(std::memory_order_relaxed)) {
+                recent.out(LogLevel::Info, message.c_str(), message.size());
+            }
+        });
+    }
+
+    size_t queried = 0;
+    for(int i = 0; i < 200 || queried == 0; ++i) {
+        for(auto &entry : recent.query(RecentLogQuery())) {
+            ASSERT_FALSE(entry.text.empty());
+            ASSERT_EQ(entry.text, std::string(100 + (entry.text[0] - 'a') * 200, entry.text[0])) << "a message should be copied whole";
+            ++queried;
+        }
+    }
+    running.store(false);
+    for(auto &writer : writers) {
+        writer.join();
+    }
+}
+
+TEST_F(SinkTest, shm_collector_merges_processes) {
+    const int processes = 3;
+    const int count = 200;
+    std::vector<pid_t> children;
+
+    for(int p = 0; p < processes; ++p) {
+        pid_t pid = fork();
+
+        ASSERT_GE(pid, 0);
+        if(pid == 0) {
+            ShmLogger logger("sink_test_shm");
+
+            for(int i = 0; i < count; ++i) {
+                logger.out(LogLevel::Info, ("message " + std::to_string(i)).c_str());
+            }
+            _exit(logger.dropped() == 0 ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    for(pid_t pid : children) {
+        int status;
+
+        ASSERT_EQ(waitpid(pid, &status, 0), pid);
+        ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << "nothing should be dropped";
+    }
+
+    //the rings of the exited processes are still there
+    ShmCollector collector("sink_test_shm");
+    std::vector<ShmRecord> records;
+    std::vector<std::string> texts;
+
+    ASSERT_EQ(collector.scan(), static_cast<size_t>(processes));
+    ASSERT_EQ(collector.poll([&](const ShmRecord &record) {
+        records.push_back(record);
+        texts.emplace_back(record.text, record.length);
+    }, true), static_cast<size_t>(processes * count));
+
+    ASSERT_TRUE(std::is_sorted(records.begin(), records.end(), [](const ShmRecord &a, const ShmRecord &b) {
+        return a.timestamp < b.timestamp;
+    })) << "messages should be merged by timestamp";
+
+    for(pid_t pid : children) {
+        int next = 0;
+
+        for(size_t i = 0; i < records.size(); ++i) {
+            if(records[i].pid == pid) {
+                ASSERT_EQ(texts[i], "message " + std::to_string(next++));
+            }
+        }
+        ASSERT_EQ(next, count);
+    }
+
+    ASSERT_EQ(collector.poll([](const ShmRecord&) {}), 0u);
+    ASSERT_EQ(collector.scan(), 0u) << "the read rings of closed loggers should be removed";
+}
+
+TEST_F(SinkTest, shm_logger_keeps_timestamp_order) {
+    std::unique_ptr<ShmLogger> logger(new ShmLogger("sink_test_order"));
+    ShmCollector collector("sink_test_order");
+    std::vector<ShmRecord> records;
+    std::vector<std::string> texts;
+
+    //a caller which took its time before another one got the lock
+    logger->out(LogLevel::Info, 2000, "second", 6);
+    logger->out(LogLevel::Info, 1000, "first", 5);
+    logger->out(LogLevel::Info, 3000, "third", 5);
+    logger.reset();
+
+    ASSERT_EQ(collector.scan(), 1u);
+    ASSERT_EQ(collector.poll([&](const ShmRecord &record) {
+        records.push_back(record);
+        texts.emplace_back(record.text, record.length);
+    }, true), 3u);
+
+    ASSERT_EQ(texts, std::vector<std::string>({"second", "first", "third"})) << "the ring should keep its order";
+    ASSERT_EQ(records[0].timestamp, 2000);
+    ASSERT_EQ(records[1].timestamp, 2000) << "a timestamp should not go back within a ring";
+    ASSERT_EQ(records[2].timestamp, 3000);
+    ASSERT_EQ(collector.scan(), 0u);
+}
+
+TEST_F(SinkTest, shm_logger_drops_when_full) {
+    std::unique_ptr<ShmLogger> logger(new ShmLogger("sink_test_full", 1024));
+    ShmCollector collector("sink_test_full", std::chrono::seconds(10));
+    std::vector<std::string> texts;
+    auto write = [&](const ShmRecord &record) {
+        ASSERT_EQ(record.pid, getpid());
+        texts.emplace_back(record.text, record.length);
+    };
+
+    ASSERT_TRUE(logger->isOpen());
+    for(int i = 0; i < 100; ++i) {
+        logger->out(LogLevel::Info, (std::to_string(i) + " " + std::string(40, 'x')).c_str());
+    }
+    ASSERT_GT(logger->dropped(), 0u) << "the process should not wait for the collector";
+
+    ASSERT_EQ(collector.scan(), 1u);
+    ASSERT_EQ(collector.poll(write), 1u) << "messages younger than the delay should wait";
+    ASSERT_EQ(texts[0], "dropped " + std::to_string(logger->dropped()) + " messages");
+
+    size_t kept = collector.poll(write, true);
+    ASSERT_EQ(kept + logger->dropped(), 100u);
+    ASSERT_EQ(texts[1].substr(0, 2), "0 ");
+
+    //the ring has room again, and its records wrap around the end
+    for(int i = 100; i < 200; ++i) {
+        logger->out(LogLevel::Info, (std::to_string(i) + " " + std::string(40, 'x')).c_str());
+        collector.poll(write, true);
+    }
+    ASSERT_EQ(texts.back(), "199 " + std::string(40, 'x'));
+    ASSERT_EQ(texts.size(), 1 + kept + 100);
+
+    logger.reset();
+    collector.poll(write, true);
+    ASSERT_EQ(collector.scan(), 0u) << "a closed ring should be removed once it is read";
+}
+
+} //namespace util
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#include <cstdio>
+#include <unistd.h>
+
+#include "flight_recorder.hpp"
+
+/**
+ * Print the lines kept by util::FlightRecorder in a shared memory segment,
+ * e.g. the one left by a crashed process.
+ *
+ * usage : flight_reader [-t] [-r] name
+ *   -t  print "seconds.microseconds " since epoch before every line
+ *   -r  remove the segment after printing it
+ */
+int main(int argc, char **argv) {
+    bool timestamps = false;
+    bool remove = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "tr")) != -1) {
+        switch(opt) {
+            case 't':
+                timestamps = true;
+                break;
+            case 'r':
+                remove = true;
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-t] [-r] name\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(optind != argc - 1) {
+        fprintf(stderr, "usage : %s [-t] [-r] name\n", argv[0]);
+        return 1;
+    }
+
+    if(!util::FlightRecorder::dump(argv[optind], STDOUT_FILENO, timestamps)) {
+        fprintf(stderr, "%s is not a flight recorder segment\n", argv[optind]);
+        return 2;
+    }
+    if(remove) {
+        util::FlightRecorder::remove(argv[optind]);
+    }
+
+    return 0;
+}
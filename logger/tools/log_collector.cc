@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+
+#include "shm_logger.hpp"
+#include "fd_logger.hpp"
+
+/**
+ * Collect the messages which the processes of a channel write with util::ShmLogger,
+ * and write them to one output in timestamp order as "seconds.microseconds pid [LEVEL]message".
+ * It runs until SIGINT or SIGTERM, then writes the messages left in the rings.
+ *
+ * usage : log_collector [-o file] [-i interval] [-d delay] channel
+ *   -o  append to the file instead of writing to stdout
+ *   -i  milliseconds between polls of the rings, 10 by default
+ *   -d  milliseconds a message waits for older messages of other processes, 50 by default
+ */
+namespace {
+
+volatile std::sig_atomic_t running = 1;
+
+void stop(int) {
+    running = 0;
+}
+
+void usage(const char *name) {
+    fprintf(stderr, "usage : %s [-o file] [-i interval] [-d delay] channel\n", name);
+}
+
+} //namespace
+
+int main(int argc, char **argv) {
+    const char *output = nullptr;
+    int interval = 10;
+    int delay = 50;
+    int opt;
+
+    while((opt = getopt(argc, argv, "o:i:d:")) != -1) {
+        switch(opt) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'i':
+                interval = std::atoi(optarg);
+                break;
+            case 'd':
+                delay = std::atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if(optind != argc - 1 || interval <= 0 || delay < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<util::FdLogger> out(output ? new util::FdLogger(std::string(output)) : new util::FdLogger(STDOUT_FILENO));
+
+    if(!out->isOpen()) {
+        return 2;
+    }
+
+    util::ShmCollector collector(argv[optind], std::chrono::milliseconds(delay));
+    char line[64 + 64 * 1024];
+
+    auto write = [&](const util::ShmRecord &record) {
+        const util::LogLevelTag &tag = util::LOG_LEVEL_TAGS[static_cast<int>(record.level)];
+        int len = snprintf(line, sizeof(line), "%ld.%06ld %d %s", static_cast<long>(record.timestamp / 1000000000),
+                           static_cast<long>(record.timestamp % 1000000000 / 1000), record.pid, tag.str);
+        size_t textLen = std::min(record.length, sizeof(line) - len);
+
+        std::memcpy(line + len, record.text, textLen);
+        out->writeLine(record.level, line, len + textLen);
+    };
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    auto scanned = std::chrono::steady_clock::time_point();
+
+    while(running) {
+        //new processes are looked for once a second
+        auto now = std::chrono::steady_clock::now();
+        if(now - scanned >= std::chrono::seconds(1)) {
+            collector.scan();
+            scanned = now;
+        }
+
+        collector.poll(write);
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+    }
+
+    collector.scan();
+    collector.poll(write, true);
+    out->flush();
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+#include "binary_logger.hpp"
+
+/**
+ * Print a file written by util::BinaryLogger as text.
+ *
+ * usage : log_decode [-j threads] [-t] file
+ *   -j  number of threads decoding the file, 0 for one per CPU (default 1)
+ *   -t  print the local time of every line
+ */
+int main(int argc, char **argv) {
+    unsigned threads = 1;
+    bool timestamps = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "j:t")) != -1) {
+        switch(opt) {
+            case 'j':
+                threads = std::atoi(optarg);
+                if(threads == 0) {
+                    threads = std::thread::hardware_concurrency();
+                }
+                break;
+            case 't':
+                timestamps = true;
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-j threads] [-t] file\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(optind != argc - 1) {
+        fprintf(stderr, "usage : %s [-j threads] [-t] file\n", argv[0]);
+        return 1;
+    }
+
+    util::BinaryLogReader reader(argv[optind]);
+
+    if(!reader.isOpen()) {
+        return 1;
+    }
+    if(!reader.decode(stdout, threads, timestamps)) {
+        fprintf(stderr, "%s is broken, the lines before the broken part were printed\n", argv[optind]);
+        return 2;
+    }
+
+    return 0;
+}
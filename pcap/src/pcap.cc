@@ -24,6 +24,11 @@
 
 namespace util {
 
+namespace {
+//LOG_DEBUG and LOG_VERBOSE of this module are compiled out, they would cost on the packet path
+constexpr LogLevel logModuleLevel = LogLevel::Info;
+}
+
 Pcap::Pcap(uint8_t size) : handle_(nullptr),
                            dump_t_(nullptr),
                            blocked_(false),
@@ -241,20 +246,21 @@ void Pcap::pcapHandler_(u_char *user, const struct pcap_pkthdr *header, const u_
 
     //limit queue size
     if(self->queue_.size() >= self->qsize) {
+        LOG_EVERY_T(Warn, std::chrono::seconds(1), "Packet queue is full(%u), drop packet", self->qsize);
         return;
     }
 
     //copy pcap_header, bytes
     struct pcap_pkthdr *pcap_hdr = (struct pcap_pkthdr *)malloc(sizeof(struct pcap_pkthdr));
     if(pcap_hdr == nullptr) {
-        LOG_WARN("Cannot allocate memory for copying packet");
+        LOG_RATE_LIMITED(Warn, 1, 10, "Cannot allocate memory for copying packet");
         return;
     }
     std::memcpy(pcap_hdr, header, sizeof(struct pcap_pkthdr));
 
     uint8_t *data = (uint8_t*)malloc(sizeof(uint8_t) * header->caplen);
     if(data == nullptr) {
-        LOG_WARN("Cannot allocate memory for copying packet");
+        LOG_RATE_LIMITED(Warn, 1, 10, "Cannot allocate memory for copying packet");
         if(pcap_hdr) {
             free(pcap_hdr);
         }
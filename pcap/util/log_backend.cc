@@ -0,0 +1,380 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+
+#include "log_backend.hpp"
+
+namespace util {
+
+constexpr std::chrono::milliseconds AsyncBackend::IDLE_TIMEOUT;
+
+namespace {
+std::atomic<uint64_t> backendIds {0};
+}
+
+struct AsyncBackend::Staging {
+    explicit Staging(size_t capacity) : ring(capacity), retired(false) {}
+
+    RingBuffer<LogRecord> ring;
+    std::atomic<bool> retired; //the thread won't push any more
+};
+
+struct AsyncBackend::LocalStaging {
+    ~LocalStaging() {
+        if(staging) {
+            staging->retired.store(true, std::memory_order_release);
+        }
+    }
+
+    uint64_t owner = 0; //id of the backend the ring is registered at
+    std::shared_ptr<Staging> staging;
+};
+
+AsyncBackend::AsyncBackend(size_t capacity, AsyncStaging staging, Consumer consumer, Flusher flusher, Dropper dropper,
+                           LogClock clock)
+    : id_(++backendIds),
+      staging_(staging),
+      ring_(staging == AsyncStaging::Shared ? new RingBuffer<LogRecord>(capacity) : nullptr),
+      capacity_(ring_ ? ring_->capacity() : capacity),
+      consumer_(consumer),
+      flusher_(flusher),
+      dropper_(dropper),
+      clock_(clock),
+      policy_(Backpressure::Block),
+      dropLevel_(LogLevel::Error),
+      running_(true),
+      sleeping_(false),
+      stopped_(false),
+      callers_(0),
+      consumed_(0),
+      discarded_(0),
+      sequence_(0),
+      stagingChanged_(false),
+      hasDropped_(false),
+      nextSequence_(0),
+      taken_(new LogRecord) {
+    thread_ = std::thread(&AsyncBackend::run_, this);
+}
+
+AsyncBackend::~AsyncBackend() {
+    stop();
+}
+
+void AsyncBackend::flush() {
+    size_t target;
+    {
+        Caller_ caller(*this);
+        if(!caller.admitted) {
+            return;
+        }
+        target = produced_();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    wakeup_.notify_one();
+    drained_.wait(lock, [&] {
+        return consumed_.load(std::memory_order_acquire) + discarded_.load(std::memory_order_acquire) >= target ||
+               stopped_.load(std::memory_order_acquire);
+    });
+}
+
+void AsyncBackend::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!running_.exchange(false)) {
+            return;
+        }
+        wakeup_.notify_one();
+    }
+
+    if(thread_.joinable()) {
+        thread_.join();
+    }
+
+    //the thread outlived every admitted caller, later ones are turned away, so nobody reads the rings any more.
+    //A stopped backend may stay reachable by a late caller, only its husk is kept
+    ring_.reset();
+    {
+        std::lock_guard<std::mutex> lock(stagingMutex_);
+        stagings_.clear();
+    }
+    merging_.clear();
+    taken_.reset();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_.store(true, std::memory_order_release);
+    drained_.notify_all();
+}
+
+RingBuffer<LogRecord>& AsyncBackend::localRing_() {
+    static thread_local LocalStaging local;
+
+    if(local.owner != id_) {
+        std::shared_ptr<Staging> staging = std::make_shared<Staging>(capacity_);
+        {
+            std::lock_guard<std::mutex> lock(stagingMutex_);
+            stagings_.push_back(staging);
+            stagingChanged_.store(true, std::memory_order_release);
+        }
+
+        //the ring of a previous backend is released by that backend once it is drained
+        if(local.staging) {
+            local.staging->retired.store(true, std::memory_order_release);
+        }
+        local.owner = id_;
+        local.staging = std::move(staging);
+    }
+    return local.staging->ring;
+}
+
+bool AsyncBackend::dropOldest_(RingBuffer<LogRecord> &ring) noexcept {
+    LogLevel level;
+    uint64_t sequence;
+
+    if(!ring.pop([&](LogRecord &record) { level = record.level; sequence = record.sequence; })) {
+        return false;
+    }
+
+    //the merge waits for every sequence number, so tell it this one won't come
+    if(!ring_) {
+        std::lock_guard<std::mutex> lock(droppedMutex_);
+        dropped_.insert(sequence);
+        hasDropped_.store(true, std::memory_order_release);
+    }
+    discarded_.fetch_add(1, std::memory_order_release);
+    drop_(level);
+
+    return true;
+}
+
+void AsyncBackend::drop_(LogLevel level) noexcept {
+    if(dropper_) {
+        dropper_(level);
+    }
+}
+
+bool AsyncBackend::skipDropped_() {
+    if(!hasDropped_.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(droppedMutex_);
+    auto it = dropped_.find(nextSequence_);
+
+    if(it == dropped_.end()) {
+        return false;
+    }
+    dropped_.erase(it);
+    hasDropped_.store(!dropped_.empty(), std::memory_order_release);
+    ++nextSequence_;
+
+    return true;
+}
+
+size_t AsyncBackend::queued() {
+    Caller_ caller(*this);
+    if(!caller.admitted) {
+        return 0;
+    }
+    if(ring_) {
+        return ring_->size();
+    }
+
+    std::lock_guard<std::mutex> lock(stagingMutex_);
+    size_t count = 0;
+
+    for(const auto &staging : stagings_) {
+        count += staging->ring.size();
+    }
+    return count;
+}
+
+size_t AsyncBackend::produced_() const noexcept {
+    return ring_ ? ring_->enqueued() : sequence_.load(std::memory_order_acquire);
+}
+
+bool AsyncBackend::empty_() const noexcept {
+    if(ring_) {
+        return ring_->empty();
+    }
+    if(stagingChanged_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    for(const auto &staging : merging_) {
+        if(!staging->ring.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AsyncBackend::refresh_() {
+    if(stagingChanged_.exchange(false, std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(stagingMutex_);
+        merging_ = stagings_;
+    }
+}
+
+void AsyncBackend::prune_() {
+    bool retired = false;
+
+    for(const auto &staging : merging_) {
+        if(staging->retired.load(std::memory_order_acquire) && staging->ring.empty()) {
+            retired = true;
+            break;
+        }
+    }
+
+    if(retired) {
+        std::lock_guard<std::mutex> lock(stagingMutex_);
+        auto drained = [](const std::shared_ptr<Staging> &staging) {
+            return staging->retired.load(std::memory_order_acquire) && staging->ring.empty();
+        };
+        stagings_.erase(std::remove_if(stagings_.begin(), stagings_.end(), drained), stagings_.end());
+        merging_ = stagings_;
+    }
+}
+
+template<typename Pop>
+bool AsyncBackend::take_(Pop &&pop) {
+    if(policy_.load(std::memory_order_relaxed) != Backpressure::DropOldest) {
+        return pop([&](LogRecord &record) { consume_(record); });
+    }
+
+    //the slot of the record being consumed is the next one producers fill, so release it first,
+    //otherwise dropping the queued records never makes room while a sink is slow
+    bool taken = pop([&](LogRecord &record) { copyLogRecord(*taken_, record); });
+
+    if(taken) {
+        consume_(*taken_);
+    }
+    return taken;
+}
+
+void AsyncBackend::consume_(LogRecord &record) {
+    if(clock_ == LogClock::Tsc) {
+        //callers only read the counter, the conversion is done here once per record
+        record.timestamp = TscClock::toSystemNanoseconds(static_cast<uint64_t>(record.timestamp));
+    }
+    consumer_(record);
+}
+
+size_t AsyncBackend::drain_() {
+    size_t count = 0;
+
+    while(count < BATCH_SIZE && take_([&](auto &&consume) { return ring_->pop(consume); })) {
+        ++count;
+    }
+    return count;
+}
+
+size_t AsyncBackend::merge_() {
+    size_t count = 0;
+    size_t retries = 0;
+
+    refresh_();
+
+    while(count < BATCH_SIZE) {
+        Staging *next = nullptr;
+        uint64_t sequence = UINT64_MAX;
+        size_t position = 0;
+
+        for(const auto &staging : merging_) {
+            size_t front;
+            uint64_t key;
+            if(staging->ring.front(front, key) && key < sequence) {
+                sequence = key;
+                next = staging.get();
+                position = front;
+            }
+        }
+
+        if(!next) {
+            if(skipDropped_()) {
+                continue;
+            }
+            if(count == 0) {
+                prune_();
+            }
+            break;
+        }
+
+        //a producer has taken nextSequence_ but not published it yet, or its ring is not merged yet
+        if(sequence != nextSequence_) {
+            //or it has been dropped
+            if(skipDropped_()) {
+                continue;
+            }
+            if(++retries > GAP_RETRIES) {
+                break;
+            }
+            std::this_thread::yield();
+            refresh_();
+            continue;
+        }
+
+        //the producer has dropped it meanwhile, the merge skips its sequence number next time
+        if(!take_([&](auto &&consume) { return next->ring.pop(position, consume); })) {
+            continue;
+        }
+        ++nextSequence_;
+        ++count;
+    }
+    return count;
+}
+
+void AsyncBackend::run_() {
+    size_t pending = 0;
+
+    for(;;) {
+        size_t count = ring_ ? drain_() : merge_();
+        pending += count;
+
+        //keep draining while the ring is busy, but flush the sinks at least once per ring capacity
+        if(count == BATCH_SIZE && pending < capacity()) {
+            continue;
+        }
+
+        if(pending > 0) {
+            if(flusher_) {
+                flusher_();
+            }
+            consumed_.fetch_add(pending, std::memory_order_release);
+            pending = 0;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            drained_.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        //a caller admitted before stop() may still be pushing, its record is drained before the thread exits
+        if(!running_.load(std::memory_order_relaxed) && callers_.load(std::memory_order_seq_cst) == 0 && empty_()) {
+            break;
+        }
+
+        //producers only notify while sleeping_ is set, the timeout covers a missed wakeup
+        sleeping_.store(true, std::memory_order_relaxed);
+        if(empty_() && (running_.load(std::memory_order_relaxed) || callers_.load(std::memory_order_relaxed) > 0)) {
+            wakeup_.wait_for(lock, IDLE_TIMEOUT);
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+} //namespace util
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_BACKEND_HPP__
+#define LOG_BACKEND_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <set>
+
+#include "log_record.hpp"
+#include "ring_buffer.hpp"
+#include "tsc_clock.hpp"
+
+namespace util {
+
+/**
+ * Where callers of the asynchronous mode stage their records.
+ */
+enum class AsyncStaging {
+    Shared,     //one ring for all threads, records are written in the order their slots were claimed
+    PerThread   //one ring per thread, the backend merges them by sequence number
+};
+
+/**
+ * What a caller of the asynchronous mode does when its ring is full.
+ * Fatal records are never dropped, their callers always wait.
+ */
+enum class Backpressure {
+    Block,      //wait until the backend frees a slot
+    DropNewest, //drop the record of the caller
+    DropOldest, //drop the oldest record of the ring to make room, the backend copies records out of the ring
+    DropBelow   //drop the record of the caller below the given level (at most Error), wait for the others
+};
+
+/**
+ * Clock of the timestamps taken by callers of the asynchronous mode.
+ */
+enum class LogClock {
+    System, //std::chrono::system_clock
+    Tsc     //TscClock ticks, converted to system time by the backend before the record reaches the sinks
+};
+
+/**
+ * Background flusher of the asynchronous logging mode.
+ *
+ * Callers format their message straight into a slot of a bounded ring and
+ * return, a dedicated thread drains the ring in batches and hands every record
+ * to the consumer (the sinks registered at Logger).
+ *
+ * With AsyncStaging::PerThread every thread gets its own ring on first use, so
+ * producers only share the sequence counter. The backend always takes the
+ * record with the next sequence number, which keeps the order of each thread
+ * and gives one global order across threads.
+ */
+class AsyncBackend final {
+public:
+    using Consumer = std::function<void (const LogRecord &record)>;
+    using Flusher = std::function<void ()>;
+    using Dropper = std::function<void (LogLevel level)>;
+
+    /**
+     * @brief Start the flusher thread
+     * @param capacity number of records a ring can hold, rounded up to a power of two
+     * @param staging one shared ring, or one ring of `capacity` records per thread
+     * @param consumer callback invoked on the flusher thread for every record
+     * @param flusher callback invoked on the flusher thread at the end of every batch
+     * @param dropper callback invoked on the thread of a caller for every record dropped by the backpressure policy
+     * @param clock clock of the record timestamps
+     */
+    AsyncBackend(size_t capacity, AsyncStaging staging, Consumer consumer, Flusher flusher, Dropper dropper = nullptr,
+                 LogClock clock = LogClock::System);
+    ~AsyncBackend();
+
+    AsyncBackend(const AsyncBackend&) = delete;
+    AsyncBackend& operator = (const AsyncBackend&) = delete;
+
+    /**
+     * @brief Enqueue a record. While the ring is full, the backpressure policy decides whether
+     *        the caller waits (yielding) or a record is dropped. A Fatal record is drained before returning.
+     * @param level level of the record
+     * @param fill callable invoked as fill(LogRecord&) on the claimed slot
+     * @return return false if the backend has been stopped, otherwise true, also if the record was dropped
+     */
+    template<typename F>
+    bool push(LogLevel level, F&& fill) noexcept {
+        bool queued;
+        {
+            //a caller which still holds a stopped backend is turned away before it claims a slot
+            Caller_ caller(*this);
+            queued = caller.admitted && push_(level, fill);
+        }
+
+        if(queued && level == LogLevel::Fatal) {
+            flush();
+        } else if(queued && sleeping_.load(std::memory_order_relaxed)) {
+            wakeup_.notify_one();
+        }
+        return queued;
+    }
+
+    /**
+     * @brief Select what callers do while their ring is full
+     * @param policy the backpressure policy
+     * @param level records below this level are dropped by Backpressure::DropBelow, Error and Fatal are always kept
+     */
+    void setBackpressure(Backpressure policy, LogLevel level = LogLevel::Error) noexcept {
+        dropLevel_.store(std::min(level, LogLevel::Error), std::memory_order_relaxed);
+        policy_.store(policy, std::memory_order_relaxed);
+    }
+
+    Backpressure backpressure() const noexcept {
+        return policy_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of records waiting in the rings
+     */
+    size_t queued();
+
+    /**
+     * @brief Block until every record enqueued before this call has been consumed
+     */
+    void flush();
+
+    /**
+     * @brief Drain the remaining records, join the flusher thread and free the rings
+     */
+    void stop();
+
+    size_t capacity() const noexcept {
+        return capacity_;
+    }
+
+    AsyncStaging staging() const noexcept {
+        return staging_;
+    }
+
+private:
+    struct Staging;
+    struct LocalStaging;
+
+    //a caller inside a method which reads the rings: the flusher thread keeps running and the rings
+    //stay allocated until it leaves, a caller arriving after stop() is not admitted
+    class Caller_ final {
+    public:
+        explicit Caller_(AsyncBackend &backend) noexcept : callers_(backend.callers_) {
+            callers_.fetch_add(1, std::memory_order_seq_cst);
+            admitted = backend.running_.load(std::memory_order_seq_cst);
+        }
+
+        ~Caller_() {
+            callers_.fetch_sub(1, std::memory_order_release);
+        }
+
+        bool admitted;
+
+    private:
+        std::atomic<size_t> &callers_;
+    };
+
+    template<typename F>
+    bool push_(LogLevel level, F &fill) noexcept {
+        RingBuffer<LogRecord> &ring = ring_ ? *ring_ : localRing_();
+
+        auto stamp = [&](LogRecord &record, size_t ticket) {
+            //the sequence is taken after the slot is claimed, so the backend never waits for a full ring
+            record.sequence = ring_ ? ticket : sequence_.fetch_add(1, std::memory_order_relaxed);
+            if(clock_ == LogClock::Tsc) {
+                record.timestamp = static_cast<int64_t>(TscClock::ticks());
+            } else {
+                record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::system_clock::now().time_since_epoch()).count();
+            }
+            fill(record);
+
+            //the merge of per-thread rings reads the sequence from the slot, not from the record
+            return record.sequence;
+        };
+
+        while(!ring.push(stamp)) {
+            if(!running_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            wakeup_.notify_one();
+
+            if(level != LogLevel::Fatal) {
+                Backpressure policy = policy_.load(std::memory_order_relaxed);
+
+                if(policy == Backpressure::DropNewest ||
+                   (policy == Backpressure::DropBelow && level < dropLevel_.load(std::memory_order_relaxed))) {
+                    drop_(level);
+                    return true;
+                }
+                if(policy == Backpressure::DropOldest && dropOldest_(ring)) {
+                    continue;
+                }
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    RingBuffer<LogRecord>& localRing_();
+    bool dropOldest_(RingBuffer<LogRecord> &ring) noexcept;
+    void drop_(LogLevel level) noexcept;
+    bool skipDropped_();
+    template<typename Pop>
+    bool take_(Pop &&pop);
+    void consume_(LogRecord &record);
+    void run_();
+    size_t drain_();
+    size_t merge_();
+    void refresh_();
+    void prune_();
+    bool empty_() const noexcept;
+    size_t produced_() const noexcept;
+
+    static constexpr size_t BATCH_SIZE = 64;
+    static constexpr size_t GAP_RETRIES = 64;
+    static constexpr std::chrono::milliseconds IDLE_TIMEOUT {10};
+
+    const uint64_t id_;
+    const AsyncStaging staging_;
+    std::unique_ptr<RingBuffer<LogRecord>> ring_; //AsyncStaging::Shared only, freed by stop()
+    const size_t capacity_;
+    Consumer consumer_;
+    Flusher flusher_;
+    Dropper dropper_;
+    const LogClock clock_;
+    std::atomic<Backpressure> policy_;
+    std::atomic<LogLevel> dropLevel_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable drained_;
+    std::atomic<bool> running_;
+    std::atomic<bool> sleeping_;
+    std::atomic<bool> stopped_;
+    std::atomic<size_t> callers_;
+    std::atomic<size_t> consumed_;
+    std::atomic<size_t> discarded_; //records taken from a ring by Backpressure::DropOldest
+    alignas(64) std::atomic<uint64_t> sequence_;
+
+    //rings of AsyncStaging::PerThread, registered by their threads on first use
+    std::mutex stagingMutex_;
+    std::vector<std::shared_ptr<Staging>> stagings_;
+    std::atomic<bool> stagingChanged_;
+
+    //sequence numbers of AsyncStaging::PerThread dropped by Backpressure::DropOldest, skipped by the merge
+    std::mutex droppedMutex_;
+    std::set<uint64_t> dropped_;
+    std::atomic<bool> hasDropped_;
+
+    //owned by the flusher thread
+    std::vector<std::shared_ptr<Staging>> merging_;
+    uint64_t nextSequence_;
+    std::unique_ptr<LogRecord> taken_; //copy of the record consumed under Backpressure::DropOldest
+
+    std::thread thread_;
+};
+
+} //namespace util
+
+#endif //LOG_BACKEND_HPP__
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_CAPTURE_HPP__
+#define LOG_CAPTURE_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <algorithm>
+#include <initializer_list>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+#include "log_record.hpp"
+#include "log_format.hpp"
+
+namespace util {
+
+/**
+ * Binary encoding of one LOG_* argument inside LogRecord::payload.
+ *
+ * Trivially copyable values are copied as they are. Strings are copied with
+ * a 16-bit length prefix and a terminating null, so that the decoder can hand
+ * a pointer into the payload to the formatter.
+ */
+template<typename T, typename Enable = void>
+struct ArgCodec {
+    static_assert(std::is_trivially_copyable<T>::value, "LOG_* arguments must be trivially copyable or strings");
+
+    using Decoded = T;
+
+    static size_t size(const T&) noexcept {
+        return sizeof(T);
+    }
+
+    static char* encode(char *dst, const T &value) noexcept {
+        std::memcpy(dst, &value, sizeof(T));
+        return dst + sizeof(T);
+    }
+
+    static T decode(const char *&src) noexcept {
+        T value;
+        std::memcpy(&value, src, sizeof(T));
+        src += sizeof(T);
+        return value;
+    }
+};
+
+struct StringCodec {
+    using Decoded = const char*;
+
+    static size_t size(const char *str, size_t len) noexcept {
+        return sizeof(uint16_t) + std::min<size_t>(len, UINT16_MAX) + 1;
+    }
+
+    static char* encode(char *dst, const char *str, size_t len) noexcept {
+        uint16_t n = static_cast<uint16_t>(std::min<size_t>(len, UINT16_MAX));
+
+        std::memcpy(dst, &n, sizeof(n));
+        std::memcpy(dst + sizeof(n), str, n);
+        dst[sizeof(n) + n] = '\0';
+        return dst + sizeof(n) + n + 1;
+    }
+
+    static const char* decode(const char *&src) noexcept {
+        uint16_t n;
+        std::memcpy(&n, src, sizeof(n));
+
+        const char *str = src + sizeof(n);
+        src += sizeof(n) + n + 1;
+        return str;
+    }
+};
+
+template<>
+struct ArgCodec<const char*> {
+    using Decoded = const char*;
+
+    static const char* str(const char *value) noexcept {
+        return value ? value : "(null)";
+    }
+
+    static size_t size(const char *value) noexcept {
+        return StringCodec::size(str(value), std::strlen(str(value)));
+    }
+
+    static char* encode(char *dst, const char *value) noexcept {
+        return StringCodec::encode(dst, str(value), std::strlen(str(value)));
+    }
+
+    static const char* decode(const char *&src) noexcept {
+        return StringCodec::decode(src);
+    }
+};
+
+template<>
+struct ArgCodec<std::string> {
+    using Decoded = const char*;
+
+    static size_t size(const std::string &value) noexcept {
+        return StringCodec::size(value.data(), value.size());
+    }
+
+    static char* encode(char *dst, const std::string &value) noexcept {
+        return StringCodec::encode(dst, value.data(), value.size());
+    }
+
+    static const char* decode(const char *&src) noexcept {
+        return StringCodec::decode(src);
+    }
+};
+
+/**
+ * Write "[file:line][function] " of the call site if it wants a prefix
+ */
+inline size_t formatPrefix(const LogSite &site, char *buf, size_t size) noexcept {
+    if(!site.prefix) {
+        return 0;
+    }
+
+    FormatWriter out(buf, size);
+    char line[16];
+    size_t len = std::to_chars(line, line + sizeof(line), site.line).ptr - line;
+
+    out.append('[');
+    out.append(site.file, std::strlen(site.file));
+    out.append(':');
+    out.append(line, len);
+    out.append("][", 2);
+    out.append(site.function, std::strlen(site.function));
+    out.append("] ", 2);
+
+    return out.finish();
+}
+
+/**
+ * snprintf which returns the number of bytes written without the null
+ */
+inline size_t formatArgs(char *buf, size_t size, const char *format, ...) noexcept {
+    va_list args;
+
+    va_start(args, format);
+    int len = std::vsnprintf(buf, size, format, args);
+    va_end(args);
+
+    return len < 0 ? 0 : std::min<size_t>(len, size - 1);
+}
+
+/**
+ * Type in which a LOG_* argument is captured, arrays and char* are captured as strings
+ */
+template<typename T>
+struct CaptureType {
+    using type = typename std::conditional<std::is_same<typename std::decay<T>::type, char*>::value,
+                                           const char*, typename std::decay<T>::type>::type;
+};
+
+/**
+ * Captures the arguments of a LOG_* call on the caller's thread and formats them later.
+ */
+template<typename... Args>
+struct LogCapture {
+    static size_t size(const Args&... args) noexcept {
+        size_t total = 0;
+        (void)std::initializer_list<int>{(total += ArgCodec<Args>::size(args), 0)...};
+        return total;
+    }
+
+    static size_t encode(char *dst, const Args&... args) noexcept {
+        char *end = dst;
+        (void)std::initializer_list<int>{(end = ArgCodec<Args>::encode(end, args), 0)...};
+        return end - dst;
+    }
+
+    /**
+     * LogRecord::Formatter of records captured with Args, whose format is a Format
+     */
+    template<typename Format>
+    static size_t format(const LogRecord &record, char *buf, size_t size) noexcept {
+        const char *src = record.payload;
+        (void)src;
+        //braced initialization decodes the arguments from left to right
+        std::tuple<typename ArgCodec<Args>::Decoded...> values {ArgCodec<Args>::decode(src)...};
+
+        size_t len = formatPrefix(*record.site, buf, size);
+
+        std::apply([&](const typename ArgCodec<Args>::Decoded&... value) {
+            len += static_cast<const Format*>(record.format)->format(buf + len, size - len, value...);
+        }, values);
+
+        return len;
+    }
+};
+
+/**
+ * Map a LOG_* argument to what printf-style formatting expects
+ */
+template<typename T>
+inline const T& printfArg(const T &value) noexcept {
+    return value;
+}
+
+inline const char* printfArg(const std::string &value) noexcept {
+    return value.c_str();
+}
+
+} //namespace util
+
+#endif //LOG_CAPTURE_HPP__
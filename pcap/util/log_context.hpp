@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef LOG_CONTEXT_HPP__
+#define LOG_CONTEXT_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+
+#include "log_format.hpp"
+#include "log_kv.hpp"
+
+namespace util {
+
+/**
+ * Key-value pairs which precede every message logged by a thread while the LogContext lives, e.g.
+ *   LogContext context("iface", name, "session", id);
+ * prints "[iface=eth0 session=7] [pcap.cc:120][pcapHandler_] ..." until it is destroyed.
+ * Nested contexts add their pairs to the ones of the outer contexts.
+ *
+ * The pairs are rendered into a prefix of the thread when a context is entered and left,
+ * a message copies the prefix instead of formatting them again.
+ */
+class LogContext final {
+public:
+    static constexpr size_t MAX_SIZE = 256;     //of the prefix with null, pairs which don't fit are cut
+
+    template<typename... Args>
+    explicit LogContext(const Args&... args) noexcept : previous_(prefix_().len) {
+        static_assert(sizeof...(Args) > 0 && sizeof...(Args) % 2 == 0, "LogContext takes pairs of key and value");
+
+        push_(std::forward_as_tuple(args...), std::make_index_sequence<sizeof...(Args) / 2>());
+    }
+
+    ~LogContext() noexcept {
+        Prefix &prefix = prefix_();
+
+        //the outer pairs are intact, only their closing "] " was overwritten
+        if(previous_ > 0) {
+            prefix.text[previous_ - 2] = ']';
+            prefix.text[previous_ - 1] = ' ';
+        }
+        prefix.text[previous_] = '\0';
+        prefix.len = previous_;
+    }
+
+    LogContext(const LogContext&) = delete;
+    LogContext& operator = (const LogContext&) = delete;
+
+    /**
+     * @brief Prefix of the calling thread, "[key=value ...] " or "" without a context
+     */
+    static const char* current(size_t &len) noexcept {
+        Prefix &prefix = prefix_();
+
+        len = prefix.len;
+        return prefix.text;
+    }
+
+    /**
+     * @brief Copy the prefix of the calling thread to buf, cut to size - 1 bytes
+     * @return return the length copied
+     */
+    static size_t write(char *buf, size_t size) noexcept {
+        Prefix &prefix = prefix_();
+        size_t len = std::min(prefix.len, size > 0 ? size - 1 : 0);
+
+        std::memcpy(buf, prefix.text, len);
+        return len;
+    }
+
+private:
+    struct Prefix {
+        char text[MAX_SIZE] = {};
+        size_t len = 0;
+    };
+
+    static Prefix& prefix_() noexcept {
+        static thread_local Prefix prefix;
+
+        return prefix;
+    }
+
+    template<typename Tuple, size_t... I>
+    void push_(const Tuple &args, std::index_sequence<I...>) noexcept {
+        static_assert((std::is_convertible<typename std::tuple_element<2 * I, Tuple>::type, const char*>::value && ...),
+                      "keys of LogContext must be strings");
+
+        Prefix &prefix = prefix_();
+        //the pairs replace the closing "] " of the outer context, room is left for a new one
+        size_t start = previous_ > 0 ? previous_ - 2 : 0;
+        FormatWriter out(prefix.text + start, MAX_SIZE - 2 - start);
+
+        out.append(previous_ > 0 ? ' ' : '[');
+        (void)std::initializer_list<int>{(writePair_(out, I == 0, value_(std::get<2 * I>(args)), value_(std::get<2 * I + 1>(args))), 0)...};
+
+        size_t len = start + out.finish();
+
+        prefix.text[len] = ']';
+        prefix.text[len + 1] = ' ';
+        prefix.text[len + 2] = '\0';
+        prefix.len = len + 2;
+    }
+
+    //string literals are taken as const char*
+    template<typename T>
+    static LogValue value_(const T &value) noexcept {
+        return logValue(static_cast<const typename CaptureType<T>::type&>(value));
+    }
+
+    static void writePair_(FormatWriter &out, bool first, const LogValue &key, const LogValue &value) noexcept {
+        if(!first) {
+            out.append(' ');
+        }
+        out.append(key.s, key.len);
+        out.append('=');
+        writeLogfmtValue(out, value);
+    }
+
+    size_t previous_;
+};
+
+} //namespace util
+
+#endif //LOG_CONTEXT_HPP__
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef LOG_HEXDUMP_HPP__
+#define LOG_HEXDUMP_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif //__SSE2__
+
+namespace util {
+
+/**
+ * Canonical hex and ASCII dump of binary data, 16 bytes per line like `hexdump -C`:
+ * "00000010  45 00 00 3c 1c 46 40 00  40 06 b1 e6 ac 10 0a 63  |E..<.F@.@......c|"
+ *
+ * A line is a copy of a template with the digits stored into it. With SSE2 the 32 digits and
+ * the ASCII column of a line are computed in a few vector instructions, no byte is formatted on its own.
+ */
+class HexDump {
+public:
+    static constexpr size_t BYTES_PER_LINE = 16;
+    static constexpr size_t LINE_SIZE = 78;     //of a full line, without the newline
+
+    /**
+     * @brief Length of the dump of `len` bytes, lines are separated by '\n' and the last one has none
+     */
+    static constexpr size_t length(size_t len) noexcept {
+        return len == 0 ? 0 : len / BYTES_PER_LINE * (LINE_SIZE + 1) +
+                              (len % BYTES_PER_LINE == 0 ? 0 : ASCII + len % BYTES_PER_LINE + 2) - 1;
+    }
+
+    /**
+     * @brief Write the dump of `len` bytes terminated with null, the lines which don't fit in `size` are left out
+     * @return return length(len), the length of the whole dump like snprintf
+     */
+    static size_t write(const void *data, size_t len, char *buf, size_t size) noexcept {
+        const uint8_t *src = static_cast<const uint8_t*>(data);
+        size_t written = 0;
+
+        for(size_t offset = 0; offset < len; offset += BYTES_PER_LINE) {
+            size_t count = std::min(len - offset, BYTES_PER_LINE);
+            size_t lineLen = count == BYTES_PER_LINE ? LINE_SIZE : ASCII + count + 1;
+
+            if(written + (offset > 0) + lineLen + 1 > size) {
+                break;
+            }
+            if(offset > 0) {
+                buf[written++] = '\n';
+            }
+            writeLine(src + offset, count, offset, buf + written);
+            written += lineLen;
+        }
+
+        if(size > 0) {
+            buf[written] = '\0';
+        }
+        return length(len);
+    }
+
+    /**
+     * @brief Write the line of `count` (1 to 16) bytes at `offset`, which takes 62 + count bytes, LINE_SIZE for a full line
+     */
+    static void writeLine(const uint8_t *src, size_t count, size_t offset, char *dst) noexcept {
+        static constexpr char TEMPLATE[] = "00000000                                                    |                |";
+        static constexpr char DIGITS[] = "0123456789abcdef";
+
+        std::memcpy(dst, TEMPLATE, ASCII);
+        for(int i = 7; i >= 0; --i, offset >>= 4) {
+            dst[i] = DIGITS[offset & 0xf];
+        }
+
+#ifdef __SSE2__
+        alignas(16) uint8_t bytes[BYTES_PER_LINE] = {};
+        alignas(16) char hex[2 * BYTES_PER_LINE];
+        alignas(16) char ascii[BYTES_PER_LINE];
+
+        //the last line is copied, so nothing past the data is read
+        __m128i v = count == BYTES_PER_LINE ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(src))
+                                            : (std::memcpy(bytes, src, count), _mm_load_si128(reinterpret_cast<const __m128i*>(bytes)));
+        const __m128i nibble = _mm_set1_epi8(0x0f);
+        __m128i high = hexDigits_(_mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        __m128i low = hexDigits_(_mm_and_si128(v, nibble));
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(hex), _mm_unpacklo_epi8(high, low));
+        _mm_store_si128(reinterpret_cast<__m128i*>(hex + 16), _mm_unpackhi_epi8(high, low));
+
+        //bytes from 0x20 to 0x7e are printed, bytes from 0x80 are negative for the signed compare
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(ascii),
+                        _mm_or_si128(_mm_and_si128(printable, v), _mm_andnot_si128(printable, _mm_set1_epi8('.'))));
+
+        for(size_t i = 0; i < count; ++i) {
+            std::memcpy(dst + hexColumn_(i), hex + 2 * i, 2);
+        }
+        std::memcpy(dst + ASCII, ascii, count);
+#else
+        for(size_t i = 0; i < count; ++i) {
+            dst[hexColumn_(i)] = DIGITS[src[i] >> 4];
+            dst[hexColumn_(i) + 1] = DIGITS[src[i] & 0xf];
+            dst[ASCII + i] = src[i] >= 0x20 && src[i] < 0x7f ? src[i] : '.';
+        }
+#endif //__SSE2__
+
+        dst[ASCII + count] = '|';
+    }
+
+private:
+    static constexpr size_t ASCII = 61;          //column of the ASCII text, after "|"
+
+    static constexpr size_t hexColumn_(size_t i) noexcept {
+        return 10 + 3 * i + (i >= 8 ? 1 : 0);
+    }
+
+#ifdef __SSE2__
+    static __m128i hexDigits_(__m128i nibbles) noexcept {
+        __m128i letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+
+        return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), _mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+    }
+#endif //__SSE2__
+};
+
+} //namespace util
+
+#endif //LOG_HEXDUMP_HPP__
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_KV_HPP__
+#define LOG_KV_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <charconv>
+#include <algorithm>
+#include <type_traits>
+
+#include "log_record.hpp"
+#include "log_format.hpp"
+#include "log_capture.hpp"
+
+namespace util {
+
+/**
+ * One value of a LOG_*_KV call, taken from the argument at the call site
+ * or decoded from the payload of a record
+ */
+struct LogValue {
+    char kind; //ArgType::kind
+    union {
+        int64_t i;
+        uint64_t u;
+        double f;
+        const void *p;
+        const char *s;
+    };
+    size_t len; //length of a string
+};
+
+template<typename T>
+LogValue logValue(const T &value) noexcept {
+    using U = typename std::decay<T>::type;
+    LogValue v;
+
+    v.kind = argType<U>().kind;
+    v.len = 0;
+
+    if constexpr(std::is_same<U, const char*>::value || std::is_same<U, char*>::value) {
+        v.s = value ? value : "(null)";
+        v.len = std::strlen(v.s);
+    } else if constexpr(std::is_same<U, std::string>::value) {
+        v.s = value.data();
+        v.len = value.size();
+    } else if constexpr(std::is_enum<U>::value) {
+        return logValue(static_cast<typename std::underlying_type<U>::type>(value));
+    } else if constexpr(std::is_integral<U>::value && std::is_signed<U>::value) {
+        v.i = value;
+    } else if constexpr(std::is_integral<U>::value) {
+        v.u = value;
+    } else if constexpr(std::is_floating_point<U>::value) {
+        v.f = static_cast<double>(value);
+    } else if constexpr(IsDuration<U>::value) {
+        return logValue(value.count());
+    } else if constexpr(std::is_same<U, std::thread::id>::value) {
+        std::thread::native_handle_type handle;
+        std::memcpy(&handle, &value, sizeof(handle));
+        return logValue(handle);
+    } else {
+        v.p = static_cast<const void*>(value);
+    }
+    return v;
+}
+
+/**
+ * @brief Decode one argument of type `type` from a record payload and advance src
+ */
+inline LogValue readLogValue(const ArgType &type, const char *&src) noexcept {
+    LogValue v;
+
+    v.kind = type.kind;
+    v.len = 0;
+
+    switch(type.kind) {
+        case 's': {
+            uint16_t len;
+            std::memcpy(&len, src, sizeof(len));
+            v.len = len;
+            v.s = StringCodec::decode(src);
+            return v;
+        }
+        case 'i':
+            switch(type.size) {
+                case 1: { int8_t value; std::memcpy(&value, src, 1); v.i = value; break; }
+                case 2: { int16_t value; std::memcpy(&value, src, 2); v.i = value; break; }
+                case 4: { int32_t value; std::memcpy(&value, src, 4); v.i = value; break; }
+                default: std::memcpy(&v.i, src, 8); break;
+            }
+            break;
+        case 'u':
+            switch(type.size) {
+                case 1: { uint8_t value; std::memcpy(&value, src, 1); v.u = value; break; }
+                case 2: { uint16_t value; std::memcpy(&value, src, 2); v.u = value; break; }
+                case 4: { uint32_t value; std::memcpy(&value, src, 4); v.u = value; break; }
+                default: std::memcpy(&v.u, src, 8); break;
+            }
+            break;
+        case 'f':
+            switch(type.size) {
+                case 4: { float value; std::memcpy(&value, src, 4); v.f = value; break; }
+                case 8: std::memcpy(&v.f, src, 8); break;
+                default: { long double value; std::memcpy(&value, src, sizeof(value)); v.f = static_cast<double>(value); break; }
+            }
+            break;
+        default:
+            v.p = nullptr;
+            std::memcpy(&v.p, src, std::min<size_t>(type.size, sizeof(v.p)));
+            break;
+    }
+
+    src += type.size;
+    return v;
+}
+
+/**
+ * @brief Call visit(key, value) for each argument of a LOG_*_KV record, in order
+ * @return return false if the record was not logged with LOG_*_KV
+ */
+template<typename F>
+bool forEachLogValue(const LogRecord &record, F &&visit) {
+    if(!record.formatter || !record.format->keys()) {
+        return false;
+    }
+
+    const FormatString &format = *record.format;
+    const char *src = record.payload;
+
+    for(size_t i = 0; i < format.arguments(); ++i) {
+        visit(format.keys()[i], readLogValue(format.types()[i], src));
+    }
+    return true;
+}
+
+/**
+ * @brief Write a number or a pointer in its shortest form, strings are not written
+ */
+inline void writeLogNumber(FormatWriter &out, const LogValue &value) noexcept {
+    char digits[32];
+    std::to_chars_result result {digits, std::errc()};
+
+    switch(value.kind) {
+        case 'i': result = std::to_chars(digits, digits + sizeof(digits), value.i); break;
+        case 'u': result = std::to_chars(digits, digits + sizeof(digits), value.u); break;
+        case 'f': result = std::to_chars(digits, digits + sizeof(digits), value.f); break;
+        case 'p':
+            if(!value.p) {
+                out.append("(nil)", 5);
+                return;
+            }
+            out.append("0x", 2);
+            result = std::to_chars(digits, digits + sizeof(digits), reinterpret_cast<uintptr_t>(value.p), 16);
+            break;
+        default: return;
+    }
+    out.append(digits, result.ec == std::errc() ? result.ptr - digits : 0);
+}
+
+/**
+ * @brief Write a string in double quotes, escaping quotes, backslashes and control characters as JSON does
+ */
+inline void writeQuoted(FormatWriter &out, const char *str, size_t len) noexcept {
+    const char *end = str + len;
+
+    out.append('"');
+    for(const char *run = str; run < end; ) {
+        const char *c = run;
+
+        while(c < end && *c != '"' && *c != '\\' && static_cast<unsigned char>(*c) >= ' ') {
+            ++c;
+        }
+        out.append(run, c - run);
+        if(c == end) {
+            break;
+        }
+
+        switch(*c) {
+            case '"': out.append("\\\"", 2); break;
+            case '\\': out.append("\\\\", 2); break;
+            case '\n': out.append("\\n", 2); break;
+            case '\r': out.append("\\r", 2); break;
+            case '\t': out.append("\\t", 2); break;
+            default: {
+                char escaped[] = {'\\', 'u', '0', '0', "0123456789abcdef"[(*c >> 4) & 0xf], "0123456789abcdef"[*c & 0xf]};
+                out.append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+        run = c + 1;
+    }
+    out.append('"');
+}
+
+/**
+ * @brief Write a value as logfmt does, strings are quoted if they are empty
+ *        or have spaces, '=', '"' or control characters
+ */
+inline void writeLogfmtValue(FormatWriter &out, const LogValue &value) noexcept {
+    if(value.kind != 's') {
+        writeLogNumber(out, value);
+        return;
+    }
+
+    const char *end = value.s + value.len;
+    bool quote = value.len == 0;
+
+    for(const char *c = value.s; c < end && !quote; ++c) {
+        quote = static_cast<unsigned char>(*c) <= ' ' || *c == '=' || *c == '"' || *c == 0x7f;
+    }
+
+    if(quote) {
+        writeQuoted(out, value.s, value.len);
+    } else {
+        out.append(value.s, value.len);
+    }
+}
+
+/**
+ * Format of a LOG_*_KV call: the name of an event and the names of its arguments.
+ * As text a call is printed as "event key=value key=value", values in logfmt form.
+ *
+ * Logger::outKv builds one KvFormat per call site on the first call,
+ * it must not be copied since the base class points to its keys.
+ */
+template<typename... Args>
+class KvFormat final : public FormatString {
+public:
+    using Arguments = std::tuple<Args...>;
+
+    static constexpr ArgType TYPES[] = {argType<Args>()..., {'\0', 0}};
+
+    template<typename... Keys>
+    explicit KvFormat(const char *event, const Keys&... keys) : FormatString(event, TYPES, sizeof...(Args), keys_),
+                                                                 keys_{keys...} {
+        static_assert(sizeof...(Keys) == sizeof...(Args), "every value needs a key");
+    }
+
+    KvFormat(const KvFormat&) = delete;
+    KvFormat& operator = (const KvFormat&) = delete;
+
+    /**
+     * @brief Format values into buf, values must be the Args (or their captured form)
+     * @return return the length written without null
+     */
+    template<typename... Values>
+    size_t format(char *buf, size_t size, const Values&... values) const noexcept {
+        static_assert(sizeof...(Values) == sizeof...(Args), "argument count does not match the format");
+
+        FormatWriter out(buf, size);
+        size_t i = 0;
+
+        out.append(str_, std::strlen(str_));
+        (void)i;
+        (void)std::initializer_list<int>{(writeField_(out, keys_[i++], logValue(values)), 0)...};
+
+        return out.finish();
+    }
+
+private:
+    static void writeField_(FormatWriter &out, const char *key, const LogValue &value) noexcept {
+        out.append(' ');
+        out.append(key, std::strlen(key));
+        out.append('=');
+        writeLogfmtValue(out, value);
+    }
+
+    const char *keys_[sizeof...(Args) == 0 ? 1 : sizeof...(Args)];
+};
+
+} //namespace util
+
+#endif //LOG_KV_HPP__
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "log_metrics.hpp"
+
+namespace util {
+
+namespace {
+std::atomic<uint64_t> registryIds {0};
+
+void addShard(MetricsShard &to, const MetricsShard &from) noexcept {
+    for(size_t i = 0; i < LOG_LEVELS; ++i) {
+        MetricsShard::add(to.messages[i], from.messages[i].load(std::memory_order_relaxed));
+        MetricsShard::add(to.bytes[i], from.bytes[i].load(std::memory_order_relaxed));
+        MetricsShard::add(to.dropped[i], from.dropped[i].load(std::memory_order_relaxed));
+    }
+    MetricsShard::add(to.truncated, from.truncated.load(std::memory_order_relaxed));
+}
+}
+
+constexpr size_t LatencyHistogram::BUCKETS;
+
+uint64_t SinkLatency::percentile(double fraction) const noexcept {
+    uint64_t target = static_cast<uint64_t>(fraction * count);
+    uint64_t seen = 0;
+
+    if(count == 0) {
+        return 0;
+    }
+
+    for(size_t i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+        seen += buckets[i];
+        if(seen > 0 && seen >= target) {
+            return uint64_t(1) << i;
+        }
+    }
+    return uint64_t(1) << (LatencyHistogram::BUCKETS - 1);
+}
+
+struct LogMetricsRegistry::LocalShard {
+    ~LocalShard() {
+        if(shard) {
+            shard->retired.store(true, std::memory_order_release);
+        }
+    }
+
+    uint64_t owner = 0; //id of the registry the shard is registered at
+    std::shared_ptr<MetricsShard> shard;
+};
+
+LogMetricsRegistry::LogMetricsRegistry() : id_(++registryIds) {}
+
+MetricsShard& LogMetricsRegistry::local() {
+    static thread_local LocalShard local;
+
+    if(local.owner != id_) {
+        std::shared_ptr<MetricsShard> shard = std::make_shared<MetricsShard>();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shards_.push_back(shard);
+        }
+
+        //the shard of a previous registry is folded by that registry, if it still exists
+        if(local.shard) {
+            local.shard->retired.store(true, std::memory_order_release);
+        }
+        local.owner = id_;
+        local.shard = std::move(shard);
+    }
+    return *local.shard;
+}
+
+void LogMetricsRegistry::collect(LogMetrics &metrics) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MetricsShard sum;
+
+    //fold the shards of exited threads, so the list only grows with the live threads
+    auto exited = [this](const std::shared_ptr<MetricsShard> &shard) {
+        if(!shard->retired.load(std::memory_order_acquire)) {
+            return false;
+        }
+        addShard(exited_, *shard);
+        return true;
+    };
+    shards_.erase(std::remove_if(shards_.begin(), shards_.end(), exited), shards_.end());
+
+    addShard(sum, exited_);
+    for(const auto &shard : shards_) {
+        addShard(sum, *shard);
+    }
+
+    for(size_t i = 0; i < LOG_LEVELS; ++i) {
+        metrics.messages[i] = sum.messages[i].load(std::memory_order_relaxed);
+        metrics.bytes[i] = sum.bytes[i].load(std::memory_order_relaxed);
+        metrics.dropped[i] = sum.dropped[i].load(std::memory_order_relaxed);
+    }
+    metrics.truncated = sum.truncated.load(std::memory_order_relaxed);
+}
+
+} //namespace util
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef LOG_LIMITER_HPP__
+#define LOG_LIMITER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <time.h>
+
+namespace util {
+
+/**
+ * Rate limiters of the LOG_EVERY_N, LOG_FIRST_N, LOG_EVERY_T and LOG_RATE_LIMITED call sites.
+ *
+ * Every call site owns one limiter with static storage. They are lock-free, constant
+ * initialized, and the time based ones read the coarse monotonic clock, so a suppressed
+ * call costs a few atomic operations. They report in `suppressed` how many calls were
+ * suppressed since the previous report, which the call site prints as a summary.
+ * A limiter only runs when its call site does, so the summary is lazy: calls suppressed
+ * after the last report of a storm are reported by the next call, if one ever comes.
+ */
+class LogEveryN final {
+public:
+    constexpr LogEveryN() noexcept : count_(0) {}
+
+    /**
+     * @brief Allow the 1st, (n+1)th, (2n+1)th... call, every call if n is 0
+     */
+    bool allow(uint64_t n, uint64_t &suppressed) noexcept {
+        uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+
+        n = std::max<uint64_t>(n, 1);
+        if(count % n != 0) {
+            return false;
+        }
+
+        //the n - 1 calls before this one were suppressed
+        suppressed = count > 0 ? n - 1 : 0;
+        return true;
+    }
+
+private:
+    std::atomic<uint64_t> count_;
+};
+
+class LogFirstN final {
+public:
+    constexpr LogFirstN() noexcept : count_(0) {}
+
+    /**
+     * @brief Allow the first n calls. The calls after them are reported when their number
+     *        reaches n, 2n, 4n..., so the summaries of a log storm stay few.
+     */
+    bool allow(uint64_t n, uint64_t &suppressed) noexcept {
+        uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+
+        if(count < n) {
+            return true;
+        }
+
+        uint64_t past = count - n + 1;
+        uint64_t step = std::max<uint64_t>(n, 1);
+        uint64_t steps = past / step;
+
+        if(past % step == 0 && (steps & (steps - 1)) == 0) {
+            //the previous report was at past / 2
+            suppressed = steps == 1 ? past : past / 2;
+        }
+        return false;
+    }
+
+private:
+    std::atomic<uint64_t> count_;
+};
+
+/**
+ * @brief Monotonic time in nanoseconds with the resolution of the scheduler tick, which is cheaper than steady_clock
+ */
+inline int64_t coarseNow() noexcept {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+class LogEveryT final {
+public:
+    constexpr LogEveryT() noexcept : next_(0), suppressed_(0) {}
+
+    /**
+     * @brief Allow one call per period
+     */
+    template<typename Rep, typename Period>
+    bool allow(std::chrono::duration<Rep, Period> period, uint64_t &suppressed) noexcept {
+        int64_t now = coarseNow();
+        int64_t next = next_.load(std::memory_order_relaxed);
+
+        if(now < next ||
+           !next_.compare_exchange_strong(next, now + std::chrono::duration_cast<std::chrono::nanoseconds>(period).count(),
+                                          std::memory_order_relaxed)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    std::atomic<int64_t> next_;
+    std::atomic<uint64_t> suppressed_;
+};
+
+/**
+ * Token bucket, implemented as the generic cell rate algorithm: one atomic holds the time
+ * at which the bucket is full again, so a call takes one compare-and-swap.
+ */
+class LogTokenBucket final {
+public:
+    constexpr LogTokenBucket() noexcept : full_(0), suppressed_(0) {}
+
+    /**
+     * @brief Allow `rate` calls per second on average, and up to `burst` calls at once.
+     *        A rate of 0 or less never refills the bucket, only the first `burst` calls are allowed.
+     */
+    bool allow(double rate, uint32_t burst, uint64_t &suppressed) noexcept {
+        int64_t now = coarseNow();
+        int64_t calls = std::max<uint32_t>(burst, 1);
+        //the interval is bounded, so neither it nor the time of a full bucket overflows
+        int64_t limit = INT64_MAX / 4 / calls;
+        int64_t interval = rate > 1e9 / limit ? static_cast<int64_t>(1e9 / rate) : limit;
+        int64_t full = full_.load(std::memory_order_relaxed);
+
+        for(;;) {
+            int64_t next = std::max(full, now) + interval;
+
+            if(next - now > interval * calls) {
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if(full_.compare_exchange_weak(full, next, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    std::atomic<int64_t> full_;
+    std::atomic<uint64_t> suppressed_;
+};
+
+} //namespace util
+
+#endif //LOG_LIMITER_HPP__
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef LOG_METRICS_HPP__
+#define LOG_METRICS_HPP__
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "log_record.hpp"
+
+namespace util {
+
+class ILogger;
+
+/**
+ * Write latencies of one logger in power-of-two buckets, any thread may record
+ */
+class LatencyHistogram final {
+public:
+    static constexpr size_t BUCKETS = 32; //bucket i counts latencies below 2^i ns and from 2^(i-1) ns, the last one the rest
+
+    void record(uint64_t ns) noexcept {
+        size_t bucket = ns == 0 ? 0 : std::min<size_t>(64 - __builtin_clzll(ns), BUCKETS - 1);
+
+        buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    uint64_t bucket(size_t i) const noexcept {
+        return buckets_[i].load(std::memory_order_relaxed);
+    }
+
+    uint64_t total() const noexcept {
+        return total_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[BUCKETS] {};
+    std::atomic<uint64_t> total_ {0};
+};
+
+/**
+ * Write latencies of one logger at the time of a snapshot
+ */
+struct SinkLatency {
+    const ILogger *logger;
+    uint64_t count;                             //writes
+    uint64_t totalNs;                           //time spent in the writes
+    uint64_t buckets[LatencyHistogram::BUCKETS];
+
+    /**
+     * @brief Upper bound of the latency of `fraction` of the writes, e.g. 0.99
+     * @return return nanoseconds, a power of two
+     */
+    uint64_t percentile(double fraction) const noexcept;
+
+    uint64_t meanNs() const noexcept {
+        return count > 0 ? totalNs / count : 0;
+    }
+};
+
+/**
+ * Snapshot of what the logger has done since the program started
+ */
+struct LogMetrics {
+    uint64_t messages[LOG_LEVELS];  //written to the loggers
+    uint64_t bytes[LOG_LEVELS];     //length of the messages written, records only taken by RecordLoggers count their payload
+    uint64_t dropped[LOG_LEVELS];   //dropped by the backpressure policy of asynchronous mode
+    uint64_t truncated;             //messages cut at LineBuffer::MAX_SIZE
+    size_t queued;                  //messages waiting in asynchronous mode and in the queues of the workers
+    std::vector<SinkLatency> sinks; //in the order the loggers were registered
+};
+
+/**
+ * Counters of one thread. Only that thread writes them, so an update is a plain load and store.
+ */
+struct MetricsShard {
+    std::atomic<uint64_t> messages[LOG_LEVELS] {};
+    std::atomic<uint64_t> bytes[LOG_LEVELS] {};
+    std::atomic<uint64_t> dropped[LOG_LEVELS] {};
+    std::atomic<uint64_t> truncated {0};
+    std::atomic<bool> retired {false}; //the thread has exited
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t n) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * Per-thread shards of the counters of a Logger, summed up by collect()
+ */
+class LogMetricsRegistry final {
+public:
+    LogMetricsRegistry();
+
+    LogMetricsRegistry(const LogMetricsRegistry&) = delete;
+    LogMetricsRegistry& operator = (const LogMetricsRegistry&) = delete;
+
+    /**
+     * @brief Shard of the calling thread, registered on first use
+     */
+    MetricsShard& local();
+
+    /**
+     * @brief Sum up the counters of every thread into `metrics`
+     */
+    void collect(LogMetrics &metrics);
+
+private:
+    struct LocalShard;
+
+    const uint64_t id_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<MetricsShard>> shards_;
+    MetricsShard exited_; //counters of the threads which have exited
+};
+
+} //namespace util
+
+#endif //LOG_METRICS_HPP__
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <cstring>
+#include <ctime>
+#include <charconv>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "log_pattern.hpp"
+#include "log_format.hpp"
+
+namespace util {
+
+namespace {
+/**
+ * Thread id of the calling thread as text, gettid runs once per thread
+ */
+struct ThreadName {
+    char str[16];
+    size_t len;
+};
+
+const ThreadName& threadName() noexcept {
+    thread_local ThreadName name = [] {
+        ThreadName n;
+        n.len = std::to_chars(n.str, n.str + sizeof(n.str), static_cast<long>(syscall(SYS_gettid))).ptr - n.str;
+        return n;
+    }();
+
+    return name;
+}
+
+/**
+ * Write the first `digits` digits of the nanoseconds of a second
+ */
+void writeFraction(FormatWriter &out, int64_t nanos, size_t digits) noexcept {
+    char str[9];
+
+    for(int i = 8; i >= 0; --i, nanos /= 10) {
+        str[i] = static_cast<char>('0' + nanos % 10);
+    }
+    out.append(str, digits);
+}
+}
+
+LogPattern::LogPattern(const std::string &pattern) : pattern_(pattern),
+                                                     second_(INT64_MIN),
+                                                     pid_(std::to_string(getpid())) {
+    const char *p = pattern_.c_str();
+    const char *text = p;
+
+    while(*p) {
+        if(*p != '%' || p[1] == '\0') {
+            ++p;
+            continue;
+        }
+
+        addText_(text, p - text);
+        char conversion = p[1];
+        p += 2;
+        text = p;
+
+        switch(conversion) {
+            case 'Y': case 'm': case 'd': case 'H': case 'M': case 'S': {
+                char format[] = {'%', conversion, '\0'};
+                addTime_(format);
+                break;
+            }
+            case 'T': addTime_("%H:%M:%S"); break;
+            case 'D': addTime_("%Y-%m-%d"); break;
+            case 'e': ops_.push_back({Field::Millis, {}, {}}); break;
+            case 'u': ops_.push_back({Field::Micros, {}, {}}); break;
+            case 'N': ops_.push_back({Field::Nanos, {}, {}}); break;
+            case 'l': ops_.push_back({Field::Level, {}, {}}); break;
+            case 't': ops_.push_back({Field::Thread, {}, {}}); break;
+            case 'P': ops_.push_back({Field::Pid, {}, {}}); break;
+            case 'v': ops_.push_back({Field::Message, {}, {}}); break;
+            case '%': addText_("%", 1); break;
+            default: addText_(p - 2, 2); break;
+        }
+    }
+    addText_(text, p - text);
+}
+
+size_t LogPattern::format(LogLevel level, int64_t timestamp, const char *str, size_t len, char *buf, size_t size) noexcept {
+    int64_t second = timestamp / 1000000000;
+    int64_t nanos = timestamp % 1000000000;
+
+    if(nanos < 0) {
+        --second;
+        nanos += 1000000000;
+    }
+    if(second != second_) {
+        refresh_(second);
+    }
+
+    FormatWriter out(buf, size);
+
+    for(const Op &op : ops_) {
+        switch(op.field) {
+            case Field::Text:
+            case Field::Time:
+                out.append(op.text.data(), op.text.size());
+                break;
+            case Field::Millis:
+                writeFraction(out, nanos, 3);
+                break;
+            case Field::Micros:
+                writeFraction(out, nanos, 6);
+                break;
+            case Field::Nanos:
+                writeFraction(out, nanos, 9);
+                break;
+            case Field::Level: {
+                //the tag without its brackets
+                const LogLevelTag &tag = LOG_LEVEL_TAGS[static_cast<int>(level)];
+                out.append(tag.str + 1, tag.len - 2);
+                break;
+            }
+            case Field::Thread: {
+                const ThreadName &name = threadName();
+                out.append(name.str, name.len);
+                break;
+            }
+            case Field::Pid:
+                out.append(pid_.data(), pid_.size());
+                break;
+            case Field::Message:
+                out.append(str, len);
+                break;
+        }
+    }
+
+    return out.finish();
+}
+
+void LogPattern::addText_(const char *str, size_t len) {
+    if(len == 0) {
+        return;
+    }
+
+    if(!ops_.empty() && ops_.back().field == Field::Time) {
+        //text after the time is rendered with it, once per second
+        for(size_t i = 0; i < len; ++i) {
+            ops_.back().format.append(str[i] == '%' ? 2 : 1, str[i]);
+        }
+    } else if(!ops_.empty() && ops_.back().field == Field::Text) {
+        ops_.back().text.append(str, len);
+    } else {
+        ops_.push_back({Field::Text, {}, std::string(str, len)});
+    }
+}
+
+void LogPattern::addTime_(const char *format) {
+    if(!ops_.empty() && ops_.back().field == Field::Time) {
+        ops_.back().format += format;
+        return;
+    }
+
+    ops_.push_back({Field::Time, format, {}});
+    ops_.back().text.reserve(TIME_SIZE);
+}
+
+void LogPattern::refresh_(int64_t second) noexcept {
+    time_t t = static_cast<time_t>(second);
+    struct tm tm;
+    char text[TIME_SIZE];
+
+    localtime_r(&t, &tm);
+
+    for(Op &op : ops_) {
+        if(op.field == Field::Time) {
+            //reserved at construction, assign doesn't allocate
+            op.text.assign(text, strftime(text, sizeof(text), op.format.c_str(), &tm));
+        }
+    }
+    second_ = second;
+}
+
+} //namespace util
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef RCU_HPP__
+#define RCU_HPP__
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+
+namespace util {
+
+/**
+ * Pointer to an immutable T which readers use without locks and writers replace by copy-on-write.
+ *
+ * A reader marks its own slot while it holds the pointer: the sequence of the slot is odd
+ * during the read, and only the reading thread writes it, so a read takes no lock and
+ * touches no shared reference count. A writer publishes a modified copy and frees the
+ * previous T once every slot which was odd at the publication has moved on (a grace period).
+ *
+ * Every thread keeps the slot of one RcuPointer<T>, so there should be one live instance per T.
+ */
+template<typename T>
+class RcuPointer final {
+private:
+    struct Slot {
+        alignas(64) std::atomic<uint64_t> sequence {0}; //odd while the thread reads
+        std::atomic<bool> retired {false};               //the thread has exited
+    };
+
+    struct LocalSlot {
+        ~LocalSlot() {
+            if(slot) {
+                slot->retired.store(true, std::memory_order_release);
+            }
+        }
+
+        uint64_t owner = 0; //id of the RcuPointer the slot is registered at
+        std::shared_ptr<Slot> slot;
+        unsigned depth = 0; //nested reads of the thread
+    };
+
+public:
+    /**
+     * Read-side critical section, the pointer stays valid until it is destroyed
+     */
+    class Reader final {
+    public:
+        Reader(const Reader&) = delete;
+        Reader& operator = (const Reader&) = delete;
+
+        ~Reader() {
+            if(--local_.depth == 0) {
+                Slot &slot = *local_.slot;
+                slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            }
+        }
+
+        const T* get() const noexcept {
+            return value_;
+        }
+
+        const T* operator -> () const noexcept {
+            return value_;
+        }
+
+        const T& operator * () const noexcept {
+            return *value_;
+        }
+
+    private:
+        friend class RcuPointer;
+
+        Reader(LocalSlot &local, const std::atomic<T*> &current) noexcept : local_(local) {
+            if(local_.depth++ == 0) {
+                Slot &slot = *local_.slot;
+                //the store is ordered before the load of the pointer, which the writer relies on
+                slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+            }
+            value_ = current.load(std::memory_order_seq_cst);
+        }
+
+        LocalSlot &local_;
+        const T *value_;
+    };
+
+    explicit RcuPointer(T *initial) : id_(++ids_), current_(initial) {}
+
+    ~RcuPointer() {
+        delete current_.load(std::memory_order_relaxed);
+    }
+
+    RcuPointer(const RcuPointer&) = delete;
+    RcuPointer& operator = (const RcuPointer&) = delete;
+
+    /**
+     * @brief Enter a read-side critical section, it may be nested
+     */
+    Reader read() {
+        return Reader(local_(), current_);
+    }
+
+    /**
+     * @brief Publish a copy of the current T changed by `modify`, and free the previous T after a grace period.
+     *        Writers are serialized. Called within a read of the same thread, the previous T is freed by a later update.
+     * @param modify callable invoked as modify(T&) on the copy
+     */
+    template<typename F>
+    void update(F&& modify) {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        std::unique_ptr<T> next(new T(*current_.load(std::memory_order_relaxed)));
+
+        modify(*next);
+        retired_.emplace_back(current_.exchange(next.release(), std::memory_order_seq_cst));
+
+        if(local_().depth == 0) {
+            synchronize_();
+            retired_.clear();
+        }
+    }
+
+private:
+    LocalSlot& local_() {
+        static thread_local LocalSlot local;
+
+        if(local.owner != id_) {
+            std::shared_ptr<Slot> slot = std::make_shared<Slot>();
+            {
+                std::lock_guard<std::mutex> lock(slotsMutex_);
+                slots_.push_back(slot);
+            }
+
+            if(local.slot) {
+                local.slot->retired.store(true, std::memory_order_release);
+            }
+            local.owner = id_;
+            local.slot = std::move(slot);
+            local.depth = 0;
+        }
+        return local;
+    }
+
+    //wait until every read which may hold a retired T has ended
+    void synchronize_() {
+        std::vector<std::pair<std::shared_ptr<Slot>, uint64_t>> reading;
+        {
+            std::lock_guard<std::mutex> lock(slotsMutex_);
+            auto exited = [](const std::shared_ptr<Slot> &slot) {
+                return slot->retired.load(std::memory_order_acquire) && (slot->sequence.load(std::memory_order_acquire) & 1) == 0;
+            };
+            slots_.erase(std::remove_if(slots_.begin(), slots_.end(), exited), slots_.end());
+
+            for(const auto &slot : slots_) {
+                uint64_t sequence = slot->sequence.load(std::memory_order_seq_cst);
+                if(sequence & 1) {
+                    reading.emplace_back(slot, sequence);
+                }
+            }
+        }
+
+        for(const auto &read : reading) {
+            while(read.first->sequence.load(std::memory_order_acquire) == read.second) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    static inline std::atomic<uint64_t> ids_ {0};
+
+    const uint64_t id_;
+    std::atomic<T*> current_;
+    std::mutex writeMutex_;
+    std::vector<std::unique_ptr<T>> retired_; //replaced while the writer itself was reading
+    std::mutex slotsMutex_;
+    std::vector<std::shared_ptr<Slot>> slots_;
+};
+
+} //namespace util
+
+#endif //RCU_HPP__
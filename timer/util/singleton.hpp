@@ -19,27 +19,40 @@
 #define SINGLETON_HPP__
 
 #include <mutex>
+#include <atomic>
 
 namespace util {
 
+/**
+ * Lazily created instance of T shared by the whole program.
+ *
+ * getInstance() is on the path of every LOG_* call, so once the instance exists it is
+ * a single acquire load. Only the first call, and the first call after destroyInstance(),
+ * takes the mutex to create the instance.
+ */
 template<typename T>
 class Singleton {
 public:
     static T& getInstance() noexcept {
-        std::lock_guard<std::mutex> lock(s_mutex);
-
-        T *instance = s_instance;
+        T *instance = s_instance.load(std::memory_order_acquire);
         if(instance == nullptr) {
-            instance = new T();
-            s_instance = instance;
+            instance = create_();
         }
-        return *s_instance;
+        return *instance;
     }
 
     static bool hasInstance() noexcept {
+        return s_instance.load(std::memory_order_acquire) != nullptr;
+    }
+
+    /**
+     * @brief Delete the instance, a later getInstance() creates a new one.
+     *        Use it to control shutdown ordering, no other thread may use the instance at this time.
+     */
+    static void destroyInstance() noexcept {
         std::lock_guard<std::mutex> lock(s_mutex);
 
-        return s_instance != nullptr;
+        delete s_instance.exchange(nullptr, std::memory_order_acq_rel);
     }
 
 protected:
@@ -49,13 +62,26 @@ protected:
 private:
     Singleton(const Singleton&) = delete;
     Singleton& operator = (const Singleton&) = delete;
+
+    //unlike std::call_once the mutex lets destroyInstance() reset the instance
+    static T* create_() noexcept {
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        T *instance = s_instance.load(std::memory_order_relaxed);
+        if(instance == nullptr) {
+            instance = new T();
+            s_instance.store(instance, std::memory_order_release);
+        }
+        return instance;
+    }
+
     static std::mutex s_mutex;
-    static T* s_instance;
+    static std::atomic<T*> s_instance;
 };
 
-template<typename T> T* Singleton<T>::s_instance = nullptr;
+template<typename T> std::atomic<T*> Singleton<T>::s_instance {nullptr};
 template<typename T> std::mutex Singleton<T>::s_mutex;
 
 } //namespace util
 
-#endif //SINGLETON_HPP__
\ No newline at end of file
+#endif //SINGLETON_HPP__
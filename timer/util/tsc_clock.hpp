@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2020  Younggon Kim<dev.ygkim@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TSC_CLOCK_HPP__
+#define TSC_CLOCK_HPP__
+
+#include <cstdint>
+#include <ctime>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
+namespace util {
+
+/**
+ * Clock which reads the invariant time stamp counter of the CPU, about 10ns per read
+ * instead of a clock_gettime() call.
+ *
+ * ticks() only reads the counter, the conversion to nanoseconds is left to the consumer.
+ * The rate of the counter is measured against CLOCK_MONOTONIC on the first conversion
+ * for 2ms, and measured again over the last interval when a conversion finds the
+ * calibration older than a second.
+ * Without an invariant TSC the ticks are CLOCK_MONOTONIC nanoseconds.
+ *
+ * TscClock::now() follows CLOCK_MONOTONIC like std::chrono::steady_clock.
+ */
+class TscClock {
+public:
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<TscClock>;
+
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept {
+        return time_point(duration(toNanoseconds(ticks())));
+    }
+
+    /**
+     * @brief Read the counter
+     */
+    static uint64_t ticks() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        if(invariant_()) {
+            return __rdtsc();
+        }
+#endif
+        return monotonic_();
+    }
+
+    /**
+     * @brief CLOCK_MONOTONIC nanoseconds at which the counter read `ticks`
+     */
+    static int64_t toNanoseconds(uint64_t ticks) noexcept {
+        Calibration calibration = load_(ticks);
+
+        return calibration.nanos + static_cast<int64_t>(static_cast<int64_t>(ticks - calibration.ticks) * calibration.nanosPerTick);
+    }
+
+    /**
+     * @brief Nanoseconds since epoch (CLOCK_REALTIME) at which the counter read `ticks`
+     */
+    static int64_t toSystemNanoseconds(uint64_t ticks) noexcept {
+        Calibration calibration = load_(ticks);
+
+        return calibration.nanos + calibration.offset +
+               static_cast<int64_t>(static_cast<int64_t>(ticks - calibration.ticks) * calibration.nanosPerTick);
+    }
+
+    /**
+     * @brief Whether ticks() reads an invariant TSC
+     */
+    static bool isInvariant() noexcept {
+        return invariant_();
+    }
+
+    /**
+     * @brief Measured rate of the counter
+     */
+    static double ticksPerNanosecond() noexcept {
+        return 1.0 / load_(0).nanosPerTick;
+    }
+
+    /**
+     * @brief Measure the rate of the counter again, from the previous calibration to now
+     */
+    static void calibrate() noexcept {
+        std::call_once(initialized_, init_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        calibrate_();
+    }
+
+private:
+    struct Calibration {
+        uint64_t ticks;         //counter at the calibration
+        int64_t nanos;          //CLOCK_MONOTONIC at the calibration
+        int64_t offset;         //CLOCK_REALTIME - CLOCK_MONOTONIC
+        double nanosPerTick;
+    };
+
+    static constexpr int64_t INITIAL_NANOS = 2000000;       //first measurement of the rate
+    static constexpr int64_t RECALIBRATE_NANOS = 1000000000;
+
+    static int64_t read_(clockid_t clock) noexcept {
+        struct timespec ts;
+
+        clock_gettime(clock, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    static int64_t monotonic_() noexcept {
+        return read_(CLOCK_MONOTONIC);
+    }
+
+    static bool invariant_() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        //CPUID.80000007H:EDX[8], the counter runs at a constant rate in all power states
+        static const bool invariant = [] {
+            unsigned eax, ebx, ecx, edx;
+            return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+        }();
+
+        return invariant;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Read the counter and CLOCK_MONOTONIC at the same moment,
+     *        the read between the two closest clock reads of a few tries wins
+     */
+    static void sample_(Calibration &calibration) noexcept {
+        int64_t best = INT64_MAX;
+
+        for(int i = 0; i < 5; ++i) {
+            int64_t before = monotonic_();
+            uint64_t ticks = TscClock::ticks();
+            int64_t after = monotonic_();
+
+            if(after - before < best) {
+                best = after - before;
+                calibration.ticks = ticks;
+                calibration.nanos = before + (after - before) / 2;
+            }
+        }
+        calibration.offset = read_(CLOCK_REALTIME) - monotonic_();
+    }
+
+    static void init_() noexcept {
+        Calibration calibration;
+
+        sample_(calibration);
+        calibration.nanosPerTick = 1.0;
+        if(invariant_()) {
+            while(monotonic_() - calibration.nanos < INITIAL_NANOS) {
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        store_(calibration);
+        calibrate_();
+    }
+
+    static void calibrate_() noexcept {
+        Calibration previous = read_();
+        Calibration calibration;
+
+        sample_(calibration);
+        calibration.nanosPerTick = invariant_() && calibration.ticks != previous.ticks ?
+                                   static_cast<double>(calibration.nanos - previous.nanos) / (calibration.ticks - previous.ticks) : 1.0;
+        store_(calibration);
+    }
+
+    /**
+     * @brief Current calibration, calibrated again if it is older than a second at `ticks`
+     */
+    static Calibration load_(uint64_t ticks) noexcept {
+        std::call_once(initialized_, init_);
+
+        Calibration calibration = read_();
+
+        if(static_cast<int64_t>(ticks - calibration.ticks) * calibration.nanosPerTick > RECALIBRATE_NANOS && mutex_.try_lock()) {
+            calibrate_();
+            mutex_.unlock();
+            calibration = read_();
+        }
+        return calibration;
+    }
+
+    //seqlock, written under mutex_
+    static Calibration read_() noexcept {
+        Calibration calibration;
+        uint32_t sequence;
+
+        do {
+            sequence = sequence_.load(std::memory_order_acquire);
+            calibration.ticks = ticks_.load(std::memory_order_relaxed);
+            calibration.nanos = nanos_.load(std::memory_order_relaxed);
+            calibration.offset = offset_.load(std::memory_order_relaxed);
+            calibration.nanosPerTick = nanosPerTick_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while((sequence & 1) || sequence != sequence_.load(std::memory_order_relaxed));
+
+        return calibration;
+    }
+
+    static void store_(const Calibration &calibration) noexcept {
+        sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        ticks_.store(calibration.ticks, std::memory_order_relaxed);
+        nanos_.store(calibration.nanos, std::memory_order_relaxed);
+        offset_.store(calibration.offset, std::memory_order_relaxed);
+        nanosPerTick_.store(calibration.nanosPerTick, std::memory_order_relaxed);
+        sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    static inline std::once_flag initialized_;
+    static inline std::mutex mutex_;
+    static inline std::atomic<uint32_t> sequence_ {0};
+    static inline std::atomic<uint64_t> ticks_ {0};
+    static inline std::atomic<int64_t> nanos_ {0};
+    static inline std::atomic<int64_t> offset_ {0};
+    static inline std::atomic<double> nanosPerTick_ {1.0};
+};
+
+} //namespace util
+
+#endif //TSC_CLOCK_HPP__